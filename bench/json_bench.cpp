@@ -2,6 +2,10 @@
 #include "benchmark/benchmark.h"
 #include "haisu/json.h"
 #include "haisu/json_model.h"
+#include "haisu/json_ondemand.h"
+#include "haisu/json_projector.h"
+#include "haisu/json_tape.h"
+#include "haisu/json_writer.h"
 #include "gason.h"
 #include "js0n/js0n.h"
 #include "js0n/js0n.c"
@@ -17,6 +21,35 @@ std::string empty_json = "{}";
 std::string deep_json = "{\"a\":{\"b\":{\"c\":{\"d\":{\"e\":{\"f\":{\"j\":{\"h\":{\"i\":{\"j\":{\"k\":{\"l\":{\"m\":{\"n\":{\"o\":{\"p\":{\"q\":{\"r\":\"s\"}}}}}}}}}}}}}}}}}}";
 std::string array_of_arrays = "[[\"a\"], [\"b\"], [\"c\"], [\"d\"],[\"e\"],[\"f\"],[\"g\"],[\"h\"]]";
 std::string array_of_objects = "[{\"a\":\"b\"},{\"c\":\"d\"},{\"e\":\"f\"},{\"g\":\"h\"},{\"i\":\"j\"},{\"k\":\"l\"},{\"m\":\"n\"}]";
+std::string long_strings = "{\"" + std::string(200, 'k') + "\" : \"" + std::string(1000, 'v') + "\", \"k\" : \"" + std::string(500, 'v') + "\\\"\"}";
+std::string pretty_json = "{\n    \"a\" : {\n        \"b\" : [\n            \"c\",\n            \"d\"\n        ]\n    },\n    \"e\" : \"f\"\n}";
+std::string numbers = "[[1, -2, 3.5, 4e10], [123456789, -0.000125, 6.02214076e23, 42], [3.141592653589793, 2.718281828459045, -1E+5, 0]]";
+std::string sparse_json = std::string("{\"payload\" : ") + TEST_JSON + ", \"user\" : {\"id\" : 7}, \"events\" : [{\"ts\" : 1.5}, {\"ts\" : 2.5}]}";
+std::string users_json = [] {
+    std::string ret = "{\"users\" : [";
+    for (int i = 0; i < 10000; ++i)
+    {
+        const auto n = std::to_string(i);
+        ret += (i ? ", " : "") + std::string("{\"id\" : ") + n + ", \"name\" : \"user" + n + "\", \"profile\" : {\"scores\" : [1, 2, " + n + "]}}";
+    }
+    return ret + "]}";
+}();
+std::string wide_json = [] {
+    std::string ret = "{";
+    for (int i = 0; i < 300; ++i)
+    {
+        ret += (i ? ", \"feature_" : "\"feature_") + std::to_string(i) + "\" : {\"weight\" : 1}";
+    }
+    return ret + "}";
+}();
+std::string huge_json = [] {
+    std::string ret = "[";
+    for (int i = 0; i < 1000; ++i)
+    {
+        ret += (i ? ",\n" : "") + std::string(TEST_JSON);
+    }
+    return ret + "]";
+}();
 std::string literals = "[true, false, true, null, null, true, false, null, true, false, null, true, false, null]";
 
 class gason_parser
@@ -81,6 +114,126 @@ struct json_parser : haisu::json::parser<json_parser>
     int depth{};
 };
 
+// same as json_parser, but the input is checked against RFC 8259
+struct json_validating_parser : haisu::json::parser<json_validating_parser, 63, haisu::json::validating>
+{
+    template <typename Literal>
+    void on_value(Literal&&)
+    {
+        ++literals;
+    }
+
+    template <typename Literal>
+    void on_array(Literal&&)
+    {
+        ++literals;
+    }
+
+    template <typename Literal>
+    void on_key(Literal&&)
+    {
+        ++literals;
+    }
+
+    void on_error(haisu::json::error)
+    {
+        ++errors;
+    }
+
+    int literals{};
+    int errors{};
+};
+
+static constexpr char id_key[] = "id";
+static constexpr char name_key[] = "name";
+static constexpr char score_key[] = "score";
+static constexpr char tags_key[] = "tags";
+
+// dispatches a handful of keys by comparing the strings
+struct json_key_compare_parser : haisu::json::parser<json_key_compare_parser>
+{
+    void on_key(haisu::json::string_literal lit)
+    {
+        if (lit.view == id_key) ++ids;
+        else if (lit.view == name_key) ++names;
+        else if (lit.view == score_key) ++scores;
+        else if (lit.view == tags_key) ++tags;
+    }
+
+    int ids{}, names{}, scores{}, tags{};
+};
+
+// same keys dispatched by the parser through a keyset
+struct json_keyset_parser
+    : haisu::json::parser<json_keyset_parser, 63, haisu::json::keyset<id_key, name_key, score_key, tags_key>>
+{
+    void on_key(haisu::json::known_key<id_key>) { ++ids; }
+    void on_key(haisu::json::known_key<name_key>) { ++names; }
+    void on_key(haisu::json::known_key<score_key>) { ++scores; }
+    void on_key(haisu::json::known_key<tags_key>) { ++tags; }
+
+    int ids{}, names{}, scores{}, tags{};
+};
+
+// same as json_parser, but the depth is not limited
+struct json_dynamic_depth_parser : haisu::json::parser<json_dynamic_depth_parser, 63, haisu::json::dynamic_depth>
+{
+    template <typename Literal>
+    void on_value(Literal&&)
+    {
+        ++literals;
+    }
+
+    template <typename Literal>
+    void on_array(Literal&&)
+    {
+        ++literals;
+    }
+
+    template <typename Literal>
+    void on_key(Literal&&)
+    {
+        ++literals;
+    }
+
+    int literals{};
+};
+
+// the parser converts the numbers itself
+struct json_number_parser : haisu::json::parser<json_number_parser>
+{
+    void on_array(int64_t val)
+    {
+        sum += val;
+    }
+
+    void on_array(double val)
+    {
+        sum += val;
+    }
+
+    double sum{};
+};
+
+static constexpr char user_id[] = "$.user.id";
+static constexpr char event_ts[] = "$.events[*].ts";
+
+// looks at a couple of values, skips the rest
+struct json_projector : haisu::json::projector<json_projector, user_id, event_ts>
+{
+    void on_match(haisu::json::path<user_id>, int64_t val)
+    {
+        sum += val;
+    }
+
+    void on_match(haisu::json::path<event_ts>, double val)
+    {
+        sum += val;
+    }
+
+    double sum{};
+};
+
 struct js0n_parser
 {
     void parse(const char* str)
@@ -112,6 +265,160 @@ static void bench_haisu(benchmark::State& state, std::string json)
     }
 }
 
+static void bench_haisu_validating(benchmark::State& state, std::string json)
+{
+    json_validating_parser parser;
+    std::string j = json;
+    while (state.KeepRunning())
+    {
+        parser.parse(j.c_str());
+    }
+}
+
+static void bench_haisu_dynamic_depth(benchmark::State& state, std::string json)
+{
+    json_dynamic_depth_parser parser;
+    std::string j = json;
+    while (state.KeepRunning())
+    {
+        parser.parse(j.c_str());
+    }
+}
+
+template <typename Parser>
+static void bench_haisu_keys(benchmark::State& state, std::string json)
+{
+    Parser parser;
+    std::string j = json;
+    while (state.KeepRunning())
+    {
+        parser.parse(j.c_str());
+    }
+    benchmark::DoNotOptimize(parser.ids);
+}
+
+static void bench_haisu_key_compare(benchmark::State& state, std::string json)
+{
+    bench_haisu_keys<json_key_compare_parser>(state, json);
+}
+
+static void bench_haisu_keyset(benchmark::State& state, std::string json)
+{
+    bench_haisu_keys<json_keyset_parser>(state, json);
+}
+
+static void bench_haisu_model(benchmark::State& state, std::string json)
+{
+    std::string j = json;
+    while (state.KeepRunning())
+    {
+        haisu::json::model model;
+        model.parse(j.c_str());
+        benchmark::DoNotOptimize(model.root().empty());
+    }
+}
+
+static void bench_haisu_tape(benchmark::State& state, std::string json)
+{
+    haisu::json::tape tape;
+    std::string j = json;
+    while (state.KeepRunning())
+    {
+        tape.parse(j.c_str());
+        benchmark::DoNotOptimize(tape.size());
+    }
+}
+
+// the tape built on all the hardware threads
+static void bench_haisu_tape_parallel(benchmark::State& state, std::string json)
+{
+    haisu::json::tape tape;
+    while (state.KeepRunning())
+    {
+        tape.parse_parallel(json);
+        benchmark::DoNotOptimize(tape.size());
+    }
+}
+
+// parses and writes the json back without the whitespace
+static void bench_haisu_minify(benchmark::State& state, std::string json)
+{
+    std::string out(json.size(), 0);
+    while (state.KeepRunning())
+    {
+        haisu::json::buffer_output buf{&out[0], out.size()};
+        haisu::json::reformat(json, buf);
+        benchmark::DoNotOptimize(buf.size());
+    }
+}
+
+// looks up the keys of a wide object parsed once
+static void bench_haisu_model_lookup(benchmark::State& state, std::string json)
+{
+    haisu::json::model model;
+    model.parse(json.c_str());
+    const std::string keys[] = {"feature_0", "feature_150", "feature_299", "feature_300"};
+    size_t i = 0;
+    while (state.KeepRunning())
+    {
+        benchmark::DoNotOptimize(model.has_key(keys[i++ % 4].c_str()));
+    }
+}
+
+// random access to a document parsed once
+static void bench_haisu_tape_lookup(benchmark::State& state, std::string json)
+{
+    haisu::json::tape tape;
+    tape.parse(json);
+    const auto users = tape.child("users");
+    const auto count = users.count_array();
+    size_t i = 0;
+    while (state.KeepRunning())
+    {
+        benchmark::DoNotOptimize(users[i].child("profile").child("scores")[2].as_int64());
+        i = (i + 7919) % count;
+    }
+}
+
+static void bench_haisu_numbers(benchmark::State& state, std::string json)
+{
+    json_number_parser parser;
+    std::string j = json;
+    while (state.KeepRunning())
+    {
+        parser.parse(j.c_str());
+    }
+    benchmark::DoNotOptimize(parser.sum);
+}
+
+static void bench_haisu_projector(benchmark::State& state, std::string json)
+{
+    json_projector parser;
+    std::string j = json;
+    while (state.KeepRunning())
+    {
+        parser.parse(j.c_str());
+    }
+    benchmark::DoNotOptimize(parser.sum);
+}
+
+static void bench_haisu_ondemand(benchmark::State& state, std::string json)
+{
+    double sum{};
+    std::string j = json;
+    while (state.KeepRunning())
+    {
+        haisu::json::ondemand_cursor doc{j};
+        sum += doc.find_field("user").find_field("id").get_int64();
+        auto events = doc.find_field("events");
+        for (auto e = events.next_item(); !e.empty(); e = events.next_item())
+        {
+            sum += e.find_field("ts").get_double();
+        }
+    }
+    benchmark::DoNotOptimize(sum);
+}
+
 static void bench_js0n(benchmark::State& state, std::string json)
 {
     js0n_parser parser;
@@ -193,12 +500,46 @@ BENCHMARK_CAPTURE(bench_haisu, haisu_array_of_objects, array_of_objects);
 BENCHMARK_CAPTURE(bench_js0n, js0n_array_of_objects, array_of_objects);
 BENCHMARK_CAPTURE(bench_simdjson, simdjson_array_of_objects, array_of_objects);
 
+BENCHMARK_CAPTURE(bench_gason, gason_numbers, numbers);
+BENCHMARK_CAPTURE(bench_haisu, haisu_numbers, numbers);
+BENCHMARK_CAPTURE(bench_haisu_numbers, haisu_typed_numbers, numbers);
+BENCHMARK_CAPTURE(bench_js0n, js0n_numbers, numbers);
+BENCHMARK_CAPTURE(bench_simdjson, simdjson_numbers, numbers);
+
 BENCHMARK_CAPTURE(bench_gason, gason_literals, literals);
 BENCHMARK_CAPTURE(bench_haisu, haisu_literals, literals);
 BENCHMARK_CAPTURE(bench_js0n, js0n_literals, literals);
 BENCHMARK_CAPTURE(bench_simdjson, simdjson_literals, literals);
 
+BENCHMARK_CAPTURE(bench_gason, gason_long_strings, long_strings);
+BENCHMARK_CAPTURE(bench_haisu, haisu_long_strings, long_strings);
+BENCHMARK_CAPTURE(bench_js0n, js0n_long_strings, long_strings);
+BENCHMARK_CAPTURE(bench_simdjson, simdjson_long_strings, long_strings);
+
+BENCHMARK_CAPTURE(bench_gason, gason_pretty_json, pretty_json);
+BENCHMARK_CAPTURE(bench_haisu, haisu_pretty_json, pretty_json);
+BENCHMARK_CAPTURE(bench_js0n, js0n_pretty_json, pretty_json);
+BENCHMARK_CAPTURE(bench_simdjson, simdjson_pretty_json, pretty_json);
+
+BENCHMARK_CAPTURE(bench_haisu, haisu_sparse_json, sparse_json);
+BENCHMARK_CAPTURE(bench_haisu_projector, haisu_projector_sparse_json, sparse_json);
+BENCHMARK_CAPTURE(bench_haisu_ondemand, haisu_ondemand_sparse_json, sparse_json);
+BENCHMARK_CAPTURE(bench_simdjson, simdjson_sparse_json, sparse_json);
+
 BENCHMARK_CAPTURE(bench_gason, gason_large_file, TEST_JSON);
 BENCHMARK_CAPTURE(bench_js0n, js0n_large_file, TEST_JSON);
 BENCHMARK_CAPTURE(bench_simdjson, simdjson_large_file, TEST_JSON);
 BENCHMARK_CAPTURE(bench_haisu, haisu_large_file, TEST_JSON);
+BENCHMARK_CAPTURE(bench_haisu_validating, haisu_validating_large_file, TEST_JSON);
+BENCHMARK_CAPTURE(bench_haisu_dynamic_depth, haisu_dynamic_depth_large_file, TEST_JSON);
+BENCHMARK_CAPTURE(bench_haisu_dynamic_depth, haisu_dynamic_depth_deep_json, deep_json);
+BENCHMARK_CAPTURE(bench_haisu_key_compare, haisu_key_compare_large_file, TEST_JSON);
+BENCHMARK_CAPTURE(bench_haisu_keyset, haisu_keyset_large_file, TEST_JSON);
+BENCHMARK_CAPTURE(bench_haisu_model, haisu_model_large_file, TEST_JSON);
+BENCHMARK_CAPTURE(bench_haisu_tape, haisu_tape_large_file, TEST_JSON);
+BENCHMARK_CAPTURE(bench_haisu_tape, haisu_tape_huge_file, huge_json);
+BENCHMARK_CAPTURE(bench_haisu_tape_parallel, haisu_tape_parallel_huge_file, huge_json);
+BENCHMARK_CAPTURE(bench_haisu_minify, haisu_minify_large_file, TEST_JSON);
+BENCHMARK_CAPTURE(bench_haisu_minify, haisu_minify_pretty_json, pretty_json);
+BENCHMARK_CAPTURE(bench_haisu_tape_lookup, haisu_tape_lookup, users_json);
+BENCHMARK_CAPTURE(bench_haisu_model_lookup, haisu_model_lookup, wide_json);
@@ -2,6 +2,9 @@
 #include "haisu/zset.h"
 #include <set>
 #include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
 
 
 template <typename T>
@@ -17,6 +20,14 @@ public:
         std::sort(vec.begin(), vec.end());
     }
 
+    template <typename It>
+    sorted_vec(It first, It last)
+        : vec(first, last)
+    {
+        std::sort(vec.begin(), vec.end());
+        vec.erase(std::unique(vec.begin(), vec.end()), vec.end());
+    }
+
     size_t count(const T& needle) const
     {
         return std::binary_search(vec.begin(), vec.end(), needle) ? 1 : 0;
@@ -33,7 +44,7 @@ static void bench_zset_failed_lookup_small_dataset(benchmark::State& state)
     while (state.KeepRunning())
     {
         for (int i = 0; i < 1000; ++i)
-            volatile auto a = z.count("abracadabra");
+            benchmark::DoNotOptimize(z.count("abracadabra"));
     }
 }
 
@@ -45,7 +56,7 @@ static void bench_set_failed_lookup_small_dataset(benchmark::State& state)
     while (state.KeepRunning())
     {
         for (int i = 0; i < 1000; ++i)
-            volatile auto a = z.count(needle);
+            benchmark::DoNotOptimize(z.count(needle));
     }
 }
 
@@ -57,7 +68,7 @@ static void bench_sorted_vec_failed_lookup_small_dataset(benchmark::State& state
     while (state.KeepRunning())
     {
         for (int i = 0; i < 1000; ++i)
-            volatile auto a = z.count(needle);
+            benchmark::DoNotOptimize(z.count(needle));
     }
 }
 
@@ -80,7 +91,7 @@ static void bench_zset_failed_lookup_large_dataset(benchmark::State& state)
     while (state.KeepRunning())
     {
         for (int i = 0; i < 1000; ++i)
-            volatile auto a = z.count("abracadabra");
+            benchmark::DoNotOptimize(z.count("abracadabra"));
     }
 }
 
@@ -105,15 +116,100 @@ static void bench_set_failed_lookup_large_dataset(benchmark::State& state)
     while (state.KeepRunning())
     {
         for (int i = 0; i < 1000; ++i)
-            volatile auto a  = z.count(needle);
+            benchmark::DoNotOptimize(z.count(needle));
+    }
+}
+
+
+// url-like keys sharing long prefixes, so that the comparisons go past the first 8 characters
+static const std::vector<std::string>& huge_dataset()
+{
+    static const std::vector<std::string> keys = []{
+        std::vector<std::string> ret;
+        std::mt19937 gen(42);
+        const char* hosts[] = {"http://example.com/", "https://cdn.example.org/static/", "http://a.io/", "ftp://files.example.net/pub/"};
+        for (int i = 0; i < 1000000; ++i)
+        {
+            ret.push_back(hosts[gen() % 4] + std::to_string(gen()) + "/" + std::to_string(i));
+        }
+        return ret;
+    }();
+    return keys;
+}
+
+// every other needle is in the set, the rest are not
+static const std::vector<std::string>& huge_dataset_needles()
+{
+    static const std::vector<std::string> needles = []{
+        std::vector<std::string> ret;
+        std::mt19937 gen(7);
+        auto& keys = huge_dataset();
+        for (int i = 0; i < 1000; ++i)
+        {
+            auto& key = keys[gen() % keys.size()];
+            ret.push_back(i % 2 ? key : key + "x");
+        }
+        return ret;
+    }();
+    return needles;
+}
+
+template <typename Set>
+static void lookup_huge_dataset(benchmark::State& state, const Set& z)
+{
+    auto& needles = huge_dataset_needles();
+    while (state.KeepRunning())
+    {
+        for (auto& needle : needles)
+            benchmark::DoNotOptimize(z.count(needle.c_str()));
+    }
+}
+
+static void bench_zset_lookup_huge_dataset(benchmark::State& state) 
+{
+    auto& keys = huge_dataset();
+    haisu::zset z(keys.begin(), keys.end());
+    lookup_huge_dataset(state, z);
+}
+
+static void bench_frozen_zset_lookup_huge_dataset(benchmark::State& state) 
+{
+    auto& keys = huge_dataset();
+    haisu::zset z(keys.begin(), keys.end());
+    z.freeze();
+    lookup_huge_dataset(state, z);
+}
+
+static void bench_set_lookup_huge_dataset(benchmark::State& state) 
+{
+    auto& keys = huge_dataset();
+    std::set<std::string> z(keys.begin(), keys.end());
+    auto& needles = huge_dataset_needles();
+    while (state.KeepRunning())
+    {
+        for (auto& needle : needles)
+            benchmark::DoNotOptimize(z.count(needle));
     }
 }
 
+static void bench_sorted_vec_lookup_huge_dataset(benchmark::State& state) 
+{
+    auto& keys = huge_dataset();
+    sorted_vec<std::string> z(keys.begin(), keys.end());
+    auto& needles = huge_dataset_needles();
+    while (state.KeepRunning())
+    {
+        for (auto& needle : needles)
+            benchmark::DoNotOptimize(z.count(needle));
+    }
+}
 
 BENCHMARK(bench_zset_failed_lookup_small_dataset);
 BENCHMARK(bench_set_failed_lookup_small_dataset);
 BENCHMARK(bench_zset_failed_lookup_large_dataset);
 BENCHMARK(bench_set_failed_lookup_large_dataset);
 BENCHMARK(bench_sorted_vec_failed_lookup_small_dataset);
-
-BENCHMARK_MAIN();
+BENCHMARK(bench_zset_lookup_huge_dataset);
+BENCHMARK(bench_frozen_zset_lookup_huge_dataset);
+BENCHMARK(bench_set_lookup_huge_dataset);
+BENCHMARK(bench_sorted_vec_lookup_huge_dataset);
@@ -28,6 +28,8 @@ For more information, please refer to <http://unlicense.org/>
 #pragma once
 
 #include <limits>
+#include <string>
+#include <string_view>
 #include <vector>
 #include <cstring>
 
@@ -113,6 +115,22 @@ size_t binary_search(const Container& container, Key key, Cmp cmp = Cmp())
     return npos;
 }
 
+// the smallest string greater than every string starting with the prefix, empty if there is no such string
+// (the prefix is empty or made of 0xff characters only)
+inline std::string prefix_successor(std::string_view prefix)
+{
+    std::string ret(prefix);
+    while (!ret.empty() && static_cast<unsigned char>(ret.back()) == 0xff)
+    {
+        ret.pop_back();
+    }
+
+    if (!ret.empty())
+    {
+        ret.back() = static_cast<char>(static_cast<unsigned char>(ret.back()) + 1);
+    }
+    return ret;
+}
 
 inline const void* memrmem(const void* haystack, size_t haystackLen, const void* needle, size_t needleLen)
 {
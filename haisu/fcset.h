@@ -0,0 +1,432 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org/>
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <initializer_list>
+#include <iterator>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "algo.h"
+#include "zbuf.h"
+
+namespace haisu
+{
+
+// the read-only sorted set of strings, front-coded in blocks the way leveldb does it: a string is stored as the length
+// of the prefix it shares with the previous one, the length of the rest and the rest itself; every restart_interval-th
+// string is stored in full, the table of their offsets makes the binary search; the lookups are O(log n) plus a scan
+// of one block, the strings are decoded into the iterator, they are not null-terminated in the set
+class fcset
+{
+public:
+    typedef const char* key_type;
+    typedef const char* value_type;
+    typedef std::size_t size_type;
+    typedef int off_t;
+
+    static constexpr size_t restart_interval = 16;
+
+    class iterator
+    {
+    public:
+        typedef fcset::value_type value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const value_type* pointer;
+        typedef value_type reference;
+        typedef std::forward_iterator_tag iterator_category;
+
+        iterator() = default;
+
+        // valid until the iterator moves
+        value_type operator *() const
+        {
+            return key.c_str();
+        }
+
+        std::string_view view() const noexcept
+        {
+            return key;
+        }
+
+        bool operator ==(const iterator& other) const noexcept
+        {
+            return s == other.s && pos == other.pos;
+        }
+
+        bool operator !=(const iterator& other) const noexcept
+        {
+            return !(*this == other);
+        }
+
+        iterator& operator ++()
+        {
+            if (++pos < s->_size)
+            {
+                next = s->decode(next, key);
+            }
+            return *this;
+        }
+
+        iterator operator ++(int)
+        {
+            iterator prev(*this);
+            ++(*this);
+            return prev;
+        }
+
+    private:
+        // positions the iterator at the restart point of the block
+        iterator(const fcset& set, size_t block) : s(&set), pos(block * restart_interval)
+        {
+            if (pos < set._size)
+            {
+                next = set.decode(set.restart(block), key);
+            }
+            else
+            {
+                pos = set._size;
+            }
+        }
+
+        const fcset* s = nullptr;
+        size_t pos = 0;
+        size_t next = 0;
+        std::string key;
+
+        friend fcset;
+    };
+
+    typedef iterator const_iterator;
+
+    fcset() = default;
+
+    fcset(std::initializer_list<key_type> ll)
+    {
+        assign(ll.begin(), ll.end());
+    }
+
+    template <typename It>
+    fcset(It first, It last)
+    {
+        assign(first, last);
+    }
+
+    // the strings (anything convertible to std::string_view) are sorted and deduplicated, then encoded in a single pass
+    template <typename It>
+    void assign(It first, It last)
+    {
+        auto keys = collect(first, last);
+        std::sort(keys.begin(), keys.end());
+        assign_unique(keys);
+    }
+
+    // same as assign(), but the strings are known to be sorted already, the adjacent duplicates are dropped;
+    // a zset is sorted, so this is the way to compact one
+    template <typename It>
+    void assign_sorted(It first, It last)
+    {
+        auto keys = collect(first, last);
+        assert(std::is_sorted(keys.begin(), keys.end()));
+        assign_unique(keys);
+    }
+
+    bool empty() const noexcept
+    {
+        return 0 == _size;
+    }
+
+    size_t size() const noexcept
+    {
+        return _size;
+    }
+
+    // the bytes taken by the encoded strings and the restart table
+    size_t capacity() const noexcept
+    {
+        return _data.capacity() + _restarts.capacity();
+    }
+
+    void clear() noexcept
+    {
+        _data.clear();
+        _restarts.clear();
+        _size = 0;
+    }
+
+    size_t count(key_type key) const
+    {
+        return find(key) == end() ? 0 : 1;
+    }
+
+    const_iterator find(key_type key) const
+    {
+        auto found = lower_bound(key);
+        return found != end() && found.view() == key ? found : end();
+    }
+
+    const_iterator lower_bound(key_type key) const
+    {
+        return bound<false>(key);
+    }
+
+    const_iterator upper_bound(key_type key) const
+    {
+        return bound<true>(key);
+    }
+
+    std::pair<const_iterator, const_iterator> equal_range(key_type key) const
+    {
+        auto lower = lower_bound(key);
+        auto upper = lower;
+        if (upper != end() && upper.view() == key)
+        {
+            ++upper;
+        }
+        return {lower, upper};
+    }
+
+    // the strings starting with the prefix, an empty prefix makes the whole set
+    std::pair<const_iterator, const_iterator> prefix_range(key_type prefix) const
+    {
+        const auto last = algo::prefix_successor(prefix);
+        return {lower_bound(prefix), last.empty() ? end() : lower_bound(last.c_str())};
+    }
+
+    bool starts_with(key_type prefix) const
+    {
+        const auto found = lower_bound(prefix);
+        return found != end() && found.view().substr(0, strlen(prefix)) == prefix;
+    }
+
+    const_iterator begin() const
+    {
+        return iterator(*this, 0);
+    }
+
+    const_iterator end() const noexcept
+    {
+        iterator ret;
+        ret.s = this;
+        ret.pos = _size;
+        return ret;
+    }
+
+    const_iterator cbegin() const
+    {
+        return begin();
+    }
+
+    const_iterator cend() const noexcept
+    {
+        return end();
+    }
+
+private:
+    template <typename It>
+    static std::vector<std::string_view> collect(It first, It last)
+    {
+        std::vector<std::string_view> ret;
+        if constexpr (std::is_base_of<std::forward_iterator_tag, typename std::iterator_traits<It>::iterator_category>{})
+        {
+            ret.reserve(std::distance(first, last));
+        }
+
+        for (; first != last; ++first)
+        {
+            ret.emplace_back(*first);
+        }
+        return ret;
+    }
+
+    // the keys are sorted, the duplicates are next to each other
+    void assign_unique(std::vector<std::string_view>& keys)
+    {
+        keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+        // the first pass sizes the buffers, the second one writes them
+        size_t total = 0;
+        for (size_t i = 0; i < keys.size(); ++i)
+        {
+            const size_t shared = shared_at(keys, i);
+            const size_t rest = keys[i].size() - shared;
+            total += varint_size(shared) + varint_size(rest) + rest;
+        }
+        assert(total <= size_t(std::numeric_limits<off_t>::max()));
+
+        clear();
+        _data.reserve(total);
+        _restarts.reserve((keys.size() + restart_interval - 1) / restart_interval * sizeof(off_t));
+
+        for (size_t i = 0; i < keys.size(); ++i)
+        {
+            if (i % restart_interval == 0)
+            {
+                _restarts.append(static_cast<off_t>(_data.size()));
+            }
+
+            const auto key = keys[i];
+            const size_t shared = shared_at(keys, i);
+            write_varint(shared);
+            write_varint(key.size() - shared);
+            _data.append(key.data() + shared, key.size() - shared);
+        }
+
+        _size = keys.size();
+    }
+
+    // the length of the prefix the string shares with the previous one, nothing is shared at the restart points
+    static size_t shared_at(const std::vector<std::string_view>& keys, size_t i) noexcept
+    {
+        if (i % restart_interval == 0)
+        {
+            return 0;
+        }
+
+        const auto prev = keys[i - 1];
+        const auto key = keys[i];
+        const size_t len = std::min(prev.size(), key.size());
+        size_t shared = 0;
+        while (shared < len && prev[shared] == key[shared])
+        {
+            ++shared;
+        }
+        return shared;
+    }
+
+    static size_t varint_size(size_t value) noexcept
+    {
+        size_t ret = 1;
+        for (; value >= 0x80; value >>= 7)
+        {
+            ++ret;
+        }
+        return ret;
+    }
+
+    // little-endian base 128, 7 bits a byte, the high bit tells there is more
+    void write_varint(size_t value)
+    {
+        while (value >= 0x80)
+        {
+            _data.append(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        _data.append(static_cast<uint8_t>(value));
+    }
+
+    size_t read_varint(size_t& offset) const noexcept
+    {
+        size_t ret = 0;
+        for (int shift = 0;; shift += 7)
+        {
+            const auto byte = static_cast<uint8_t>(*_data.ptr(offset++));
+            ret |= size_t(byte & 0x7f) << shift;
+            if (byte < 0x80)
+            {
+                return ret;
+            }
+        }
+    }
+
+    // the string at the offset goes into the key, which holds the previous one; returns the offset of the next string
+    size_t decode(size_t offset, std::string& key) const
+    {
+        const size_t shared = read_varint(offset);
+        const size_t rest = read_varint(offset);
+        key.resize(shared);
+        key.append(_data.ptr(offset), rest);
+        return offset + rest;
+    }
+
+    size_t restart(size_t block) const noexcept
+    {
+        return _restarts.at<off_t>(block);
+    }
+
+    size_t blocks() const noexcept
+    {
+        return _restarts.size() / sizeof(off_t);
+    }
+
+    // the string a block starts with is stored in full
+    std::string_view restart_key(size_t block) const noexcept
+    {
+        size_t offset = restart(block);
+        read_varint(offset);
+        const size_t len = read_varint(offset);
+        return std::string_view(_data.ptr(offset), len);
+    }
+
+    // the binary search picks the block, the scan goes through it (the first string of the next block at most)
+    template <bool Upper>
+    const_iterator bound(key_type key) const
+    {
+        const std::string_view needle(key);
+
+        // the first block starting with a string greater than the key (not less than if not Upper)
+        size_t head = 0;
+        size_t count = blocks();
+        while (count > 0)
+        {
+            const size_t step = count / 2;
+            const int cmp = restart_key(head + step).compare(needle);
+            if (Upper ? cmp <= 0 : cmp < 0)
+            {
+                head += step + 1;
+                count -= step + 1;
+            }
+            else
+            {
+                count = step;
+            }
+        }
+
+        if (head == 0)
+        {
+            return begin();
+        }
+
+        iterator it(*this, head - 1);
+        while (it != end() && (Upper ? it.view() <= needle : it.view() < needle))
+        {
+            ++it;
+        }
+        return it;
+    }
+
+    zbuf _data;
+    zbuf _restarts;
+    size_t _size = 0;
+};
+
+}
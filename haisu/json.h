@@ -27,563 +27,2786 @@ For more information, please refer to <http://unlicense.org/>
 
 // clang-format off
 #pragma once
+#include <algorithm>
+#include <cassert>
 #include <cstring>
+#include <cstdint>
+#include <string>
 #include <string_view>
 #include <array>
+#include <type_traits>
+#include <tuple>
+#include <utility>
+#include <vector>
 
 #include "haisu/meta.h"
 #include "haisu/mono_stack.h"
 
-// TODO:
-// full validation on demand
-
-namespace haisu
-{
-namespace json
-{
+// the vectorized scanner is picked at compile time: AVX2 if the compiler targets it, otherwise SSE2 (any x86-64),
+// otherwise plain byte loops; define HAISU_JSON_NO_SIMD to force the scalar code
+#if !defined(HAISU_JSON_NO_SIMD) && (defined(__AVX2__) || defined(__SSE2__))
+#include <immintrin.h>
+#define HAISU_JSON_SIMD 1
+#else
+#define HAISU_JSON_SIMD 0
+#endif
 
-template <typename Expr, typename Var>
-constexpr auto is_valid_expression_impl(int) -> decltype(std::declval<Expr>()(std::declval<Var>()), bool())
-{
-    return true;
-}
+// the scanner reads whole aligned blocks, which may extend past the end of the input (but never past the page),
+// address sanitizer does not like it
+#ifndef HAISU_NO_SANITIZE_ADDRESS
+#if defined(__GNUC__) || defined(__clang__)
+#define HAISU_NO_SANITIZE_ADDRESS __attribute__((no_sanitize_address))
+#else
+#define HAISU_NO_SANITIZE_ADDRESS
+#endif
+#endif
 
-template <typename Expr, typename Var>
-constexpr bool is_valid_expression_impl(long)
-{
-    return false;
-}
+#include "haisu/json_number.h"
 
-template <typename Var, typename Expr>
-constexpr bool is_valid_expression(Expr&&, Var&&)
+namespace haisu
 {
-    return is_valid_expression_impl<Expr, Var>(0);
-}
-
-template <typename Var, typename Expr>
-constexpr bool is_valid_expression(Expr&&)
+namespace json
 {
-    return is_valid_expression_impl<Expr, Var>(0);
-}
-
-static_assert(is_valid_expression([](auto&& o) -> decltype(o.size()) {}, std::array<int, 10>()), "");
-static_assert(!is_valid_expression([](auto&& o) -> decltype(o.clear()) {}, std::array<int, 10>()), "");
 
-inline bool is_blank(char ch)
+namespace simd
 {
-    return ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n';
-}
 
-inline bool is_separator(char ch)
-{
-    return is_blank(ch) || ch == '}' || ch == ']' || ch == ',';
-}
+enum { block_size = 64, page_size = 4096 };
 
-inline const char* skip_blanks(const char* str)
+inline const char* align_down(const char* ptr) noexcept
 {
-    while (is_blank(*str)) ++str;
-    return str;
+    return reinterpret_cast<const char*>(reinterpret_cast<uintptr_t>(ptr) & ~uintptr_t(block_size - 1));
 }
 
-inline const char* skip_to(char ch, const char* str)
+inline int first_bit(uint64_t mask) noexcept
 {
-    while (*str && *str != ch) ++str;
-    return str;
+    return __builtin_ctzll(mask);
 }
 
-template <char ch>
-const char* skip_to(const char* str)
+// the characters block::in tells apart, one bit each
+enum char_class : uint8_t
 {
-    while (*str && *str != ch) ++str;
-    return str;
-}
+    class_bracket = 1, // {}[]
+    class_comma = 2,
+    class_colon = 4,
+    class_space = 8,
+    class_control_blank = 16, // \t\n\r
+    class_newline = 32,
+    class_quote = 64,
+    class_backslash = 128
+};
 
-template <char ch>
-const char* skip_past(const char* str)
+// a 64-byte aligned block of input, gives away bitmasks of characters, one bit per byte
+// an aligned block never crosses a page boundary, so it is fine to load it even if the input ends in the middle
+class block
 {
-    auto ret = skip_to<ch>(str);
-    return ret + (*ret ? 1 : 0);
-}
-
+public:
+    HAISU_NO_SANITIZE_ADDRESS explicit block(const char* ptr) noexcept
+    {
+        assert(ptr == align_down(ptr));
+#if HAISU_JSON_SIMD && defined(__AVX2__)
+        v_[0] = _mm256_load_si256(reinterpret_cast<const __m256i*>(ptr));
+        v_[1] = _mm256_load_si256(reinterpret_cast<const __m256i*>(ptr + 32));
+#elif HAISU_JSON_SIMD
+        // spelled out, a loop may be turned into memcpy, which address sanitizer intercepts
+        v_[0] = _mm_load_si128(reinterpret_cast<const __m128i*>(ptr));
+        v_[1] = _mm_load_si128(reinterpret_cast<const __m128i*>(ptr + 16));
+        v_[2] = _mm_load_si128(reinterpret_cast<const __m128i*>(ptr + 32));
+        v_[3] = _mm_load_si128(reinterpret_cast<const __m128i*>(ptr + 48));
+#else
+        // the builtin is expanded inline into plain loads, the memcpy of the library would be intercepted by
+        // address sanitizer, same as the SSE2 loads above
+        __builtin_memcpy(v_, ptr, block_size);
+#endif
+    }
 
-inline bool preceded_by_even_number_of_backslashes(const char* str)
-{
-    int ret = 1;
-    while (*str-- == '\\')
+    // bit N is set if the byte N is one of Chars
+    template <char... Chars>
+    uint64_t eq() const noexcept
     {
-        ret ^= 1;
+#if HAISU_JSON_SIMD && defined(__AVX2__)
+        const uint64_t lo = static_cast<uint32_t>(_mm256_movemask_epi8(any_of<Chars...>(v_[0])));
+        const uint64_t hi = static_cast<uint32_t>(_mm256_movemask_epi8(any_of<Chars...>(v_[1])));
+        return lo | (hi << 32);
+#elif HAISU_JSON_SIMD
+        uint64_t ret = 0;
+        for (int i = 0; i < 4; ++i)
+        {
+            ret |= uint64_t(static_cast<uint16_t>(_mm_movemask_epi8(any_of<Chars...>(v_[i])))) << (i * 16);
+        }
+        return ret;
+#else
+        uint64_t ret = 0;
+        for (int i = 0; i < block_size; ++i)
+        {
+            ret |= uint64_t(((v_[i] == Chars) || ...)) << i;
+        }
+        return ret;
+#endif
     }
-    
-    return ret;
-}
 
-template <char Quote>
-inline const char* skip_to_end_of_string(const char* str)
-{
-    while (true)
+    // bit N is set if the byte N is in any of the Classes (see char_class)
+    template <uint8_t Classes>
+    uint64_t in() const noexcept
+    {
+#if HAISU_JSON_SIMD && defined(__AVX2__)
+        // a byte is looked up by both of its nibbles, a class is the one both lookups agree on
+        const auto lo_table = _mm256_setr_epi8(
+            8, 0, 64, 0, 0, 0, 0, 0, 0, 16, 52, 1, 130, 17, 0, 0,
+            8, 0, 64, 0, 0, 0, 0, 0, 0, 16, 52, 1, 130, 17, 0, 0);
+        const auto hi_table = _mm256_setr_epi8(
+            48, 0, 74, 4, 0, char(129), 0, 1, 0, 0, 0, 0, 0, 0, 0, 0,
+            48, 0, 74, 4, 0, char(129), 0, 1, 0, 0, 0, 0, 0, 0, 0, 0);
+        const auto nibble = _mm256_set1_epi8(0x0f);
+        uint64_t ret = 0;
+        for (int i = 0; i < 2; ++i)
+        {
+            const auto lo = _mm256_shuffle_epi8(lo_table, _mm256_and_si256(v_[i], nibble));
+            const auto hi = _mm256_shuffle_epi8(hi_table, _mm256_and_si256(_mm256_srli_epi16(v_[i], 4), nibble));
+            const auto both = _mm256_and_si256(lo, hi);
+            int bits;
+            if constexpr ((Classes & (Classes - 1)) == 0) // a single class, its bit is moved up to the sign bit
+            {
+                bits = _mm256_movemask_epi8(_mm256_slli_epi16(both, __builtin_clz(Classes) - 24));
+            }
+            else
+            {
+                const auto classes = _mm256_set1_epi8(static_cast<char>(Classes));
+                bits = ~_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_and_si256(both, classes), _mm256_setzero_si256()));
+            }
+            ret |= uint64_t(static_cast<uint32_t>(bits)) << (i * 32);
+        }
+        return ret;
+#else
+        return ((Classes & class_bracket) ? eq<'{', '}', '[', ']'>() : 0)
+            | ((Classes & class_comma) ? eq<','>() : 0)
+            | ((Classes & class_colon) ? eq<':'>() : 0)
+            | ((Classes & class_space) ? eq<' '>() : 0)
+            | ((Classes & class_control_blank) ? eq<'\t', '\n', '\r'>() : 0)
+            | ((Classes & class_newline) ? eq<'\n'>() : 0)
+            | ((Classes & class_quote) ? eq<'"'>() : 0)
+            | ((Classes & class_backslash) ? eq<'\\'>() : 0);
+#endif
+    }
+
+    // bit N is set if the byte N is below C, the comparison is signed, so the non-ASCII bytes are all below
+    template <char C>
+    uint64_t below() const noexcept
     {
-        str = skip_to<Quote>(str);
-        if (*str && str[-1] == '\\' && preceded_by_even_number_of_backslashes(str - 2))
+#if HAISU_JSON_SIMD && defined(__AVX2__)
+        const auto bound = _mm256_set1_epi8(C);
+        const uint64_t lo = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpgt_epi8(bound, v_[0])));
+        const uint64_t hi = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpgt_epi8(bound, v_[1])));
+        return lo | (hi << 32);
+#elif HAISU_JSON_SIMD
+        uint64_t ret = 0;
+        for (int i = 0; i < 4; ++i)
         {
-            ++str;    
-            continue;
+            ret |= uint64_t(static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmplt_epi8(v_[i], _mm_set1_epi8(C))))) << (i * 16);
         }
-        break;
+        return ret;
+#else
+        uint64_t ret = 0;
+        for (int i = 0; i < block_size; ++i)
+        {
+            ret |= uint64_t(static_cast<signed char>(v_[i]) < C) << i;
+        }
+        return ret;
+#endif
     }
-    return str;
-}
 
-template <typename T>
-class dquote
-{
-public:
-    enum {trigger = '"'};
+    // the bytes a validating string scan stops at: quotes, backslashes, control characters (the null-terminator
+    // as well) and anything non-ASCII
+    uint64_t string_stops() const noexcept
+    {
+        return below<0x20>() | eq<'"', '\\'>();
+    }
 
-    void parse(const char*& str)
+    // the bytes a json writer has to escape: quotes, backslashes and control characters, non-ASCII goes as is
+    uint64_t escapes() const noexcept
     {
+        return (below<0x20>() & ~below<0>()) | eq<'"', '\\'>();
     }
 
 private:
-};
-
-template <typename T>
-class quote
-{
-public:
-    enum {trigger = '\''};
+#if HAISU_JSON_SIMD && defined(__AVX2__)
+    template <char... Chars>
+    static __m256i any_of(__m256i v) noexcept
+    {
+        auto ret = _mm256_setzero_si256();
+        ((ret = _mm256_or_si256(ret, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(Chars)))), ...);
+        return ret;
+    }
 
-    void parse(const char*& str)
+    __m256i v_[2];
+#elif HAISU_JSON_SIMD
+    template <char... Chars>
+    static __m128i any_of(__m128i v) noexcept
     {
+        auto ret = _mm_setzero_si128();
+        ((ret = _mm_or_si128(ret, _mm_cmpeq_epi8(v, _mm_set1_epi8(Chars)))), ...);
+        return ret;
     }
 
-private:
+    __m128i v_[4];
+#else
+    char v_[block_size];
+#endif
 };
 
+// bit N is set if there is an odd number of set bits in [0, N]
+inline uint64_t prefix_xor(uint64_t mask) noexcept
+{
+#if HAISU_JSON_SIMD && defined(__PCLMUL__)
+    const auto all_ones = _mm_set1_epi8(static_cast<char>(0xff));
+    return static_cast<uint64_t>(_mm_cvtsi128_si64(_mm_clmulepi64_si128(_mm_set_epi64x(0, mask), all_ones, 0)));
+#else
+    mask ^= mask << 1;
+    mask ^= mask << 2;
+    mask ^= mask << 4;
+    mask ^= mask << 8;
+    mask ^= mask << 16;
+    mask ^= mask << 32;
+    return mask;
+#endif
+}
 
-template <typename T, int N>
-class static_stack
+// follows strings through a sequence of consecutive blocks
+class string_scanner
 {
 public:
-    using size_type = meta::memory_requirement_t<N>;
-    const T& top() const noexcept
-    {
-        assert(cur_ < N);
-        return stack_[cur_];
-    }
-
-    T& top() noexcept
-    {
-        assert(cur_ < N);
-        return stack_[cur_];
-    }
+    string_scanner() = default;
 
-    template <T val>
-    void push() noexcept 
+    // picks up in the middle of the input: the first byte is escaped, the first byte is inside of a string
+    string_scanner(bool escaped, bool in_string) noexcept
+        : escaped_carry_(escaped)
+        , string_carry_(in_string ? ~uint64_t{} : 0)
     {
-        assert(!full());
-
-        stack_[--cur_] = val;
     }
 
-    void push(T t) noexcept
+    // returns the mask of characters escaped by a backslash
+    uint64_t escaped(uint64_t backslash) noexcept
     {
-        assert(!full());
+        // a backslash run starting on an even bit escapes the odd bit right after it, and vice versa
+        constexpr uint64_t even_bits = 0x5555555555555555;
 
-        stack_[--cur_] = t;
-    }
-
-    void pop() noexcept
-    {
-        assert(cur_ < N);
-        ++cur_;
-    }
+        backslash &= ~escaped_carry_;
+        const uint64_t follows_escape = backslash << 1 | escaped_carry_;
+        const uint64_t odd_starts = backslash & ~even_bits & ~follows_escape;
 
-    bool empty() const noexcept
-    {
-        return cur_ == N;
-    }
+        uint64_t even_starts;
+        escaped_carry_ = __builtin_add_overflow(odd_starts, backslash, &even_starts);
 
-    bool full() const noexcept
-    {
-        return cur_ == 0;
+        return (even_bits ^ (even_starts << 1)) & follows_escape;
     }
 
-    size_type size() const noexcept
+    // returns the mask of bytes inside of strings, the opening quote is inside, the closing one is not
+    uint64_t strings(uint64_t quote, uint64_t backslash) noexcept
     {
-        return N - cur_;
+        return strings(quote & ~escaped(backslash));
     }
 
-    void clear() noexcept
+    // same, the escaped quotes are already taken out
+    uint64_t strings(uint64_t quote) noexcept
     {
-        cur_ = N;
+        const auto ret = prefix_xor(quote) ^ string_carry_;
+        string_carry_ = uint64_t(int64_t(ret) >> 63);
+        return ret;
     }
 
-    static size_type capacity() noexcept
+    bool in_string() const noexcept
     {
-        return N;
+        return string_carry_;
     }
 
 private:
-    T stack_[N];
-    size_type cur_ = N;
+    uint64_t escaped_carry_ = 0;
+    uint64_t string_carry_ = 0;
 };
 
-template <int N>
-using boolstack = mono::stack<bool, N>;
-
-template <int N>
-class bitstack
+// the contents of a container start at str, depth is the number of the containers open, returns either the bracket
+// closing the last of them, or the first single quote outside of a double-quoted string (the caller takes it from
+// there, depth is up to date then), or the end of input; a whole block is taken at once unless it may close the container
+template <bool Bounded>
+HAISU_NO_SANITIZE_ADDRESS const char* skip_brackets(const char* str, const char* end, int& depth) noexcept
 {
-    enum { storage_size = N % 64 ? N / 64 + 1 : N / 64 }; 
-public:
-    bool empty() const
+    if (Bounded && str >= end)
     {
-        return pos_ < 0;
+        return end;
     }
 
-    template <bool Flag>
-    void push()
+    auto ptr = align_down(str);
+    auto valid = ~uint64_t{} << (str - ptr);
+    string_scanner scanner;
+    while (true)
     {
-        mask_ <<= 1;
-        if (!mask_)
+        const block b(ptr);
+        uint64_t last = 0; // the end of input is somewhere in the block
+        if constexpr (Bounded)
         {
-            mask_ = 1;
-            ++pos_;
-            bits_[pos_] = 0;
+            if (end - ptr <= block_size)
+            {
+                last = uint64_t{1} << (end - ptr - 1);
+                valid &= ~uint64_t{} >> (block_size - (end - ptr));
+            }
+        }
+        else if (const auto zero = b.eq<0>() & valid)
+        {
+            last = zero & (0 - zero);
+            valid &= last - 1;
         }
 
-        using tag = std::conditional_t<Flag, std::true_type, std::false_type>;
-        push_flag(tag());
-    }
+        const auto outside = ~scanner.strings(b.eq<'"'>() & valid, b.eq<'\\'>() & valid) & valid;
+        const auto squote = b.eq<'\''>() & outside;
+        auto opens = b.eq<'{', '['>() & outside;
+        auto closes = b.eq<'}', ']'>() & outside;
+        if (squote)
+        {
+            const auto before = (squote & (0 - squote)) - 1;
+            opens &= before;
+            closes &= before;
+        }
 
-    void push(bool flag)
-    {
-        if (flag)
+        if (__builtin_popcountll(closes) >= depth)
         {
-            push<true>();
+            for (auto events = opens | closes; events; events &= events - 1)
+            {
+                const auto bit = events & (0 - events);
+                if (opens & bit)
+                {
+                    ++depth;
+                }
+                else if (--depth == 0)
+                {
+                    return ptr + first_bit(bit);
+                }
+            }
         }
         else
         {
-            push<false>();
+            depth += __builtin_popcountll(opens) - __builtin_popcountll(closes);
+        }
+
+        if (squote)
+        {
+            return ptr + first_bit(squote);
+        }
+
+        if (last)
+        {
+            return Bounded ? end : ptr + first_bit(last);
         }
+
+        ptr += block_size;
+        valid = ~uint64_t{};
     }
+}
 
-    void pop()
+#if HAISU_JSON_SIMD
+// looks at 16 unaligned bytes, bit N is set if the byte N is one of Chars
+template <char... Chars>
+HAISU_NO_SANITIZE_ADDRESS uint32_t probe(const char* str) noexcept
+{
+    const auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str));
+    auto eq = _mm_setzero_si128();
+    ((eq = _mm_or_si128(eq, _mm_cmpeq_epi8(v, _mm_set1_epi8(Chars)))), ...);
+    return static_cast<uint32_t>(_mm_movemask_epi8(eq));
+}
+#endif
+
+// finds the first character which is one of Chars or a null-terminator
+template <char... Chars>
+HAISU_NO_SANITIZE_ADDRESS const char* find_first_of(const char* str) noexcept
+{
+#if HAISU_JSON_SIMD
+    // most of json strings are short, a single unaligned probe finds their ends
+    if ((reinterpret_cast<uintptr_t>(str) & (page_size - 1)) <= page_size - 16)
     {
-        assert(!empty());
-        mask_ >>= 1;
-        if (!mask_)
+        if (const auto mask = probe<Chars..., 0>(str))
         {
-            mask_ = 0x8000000000000000;
-            --pos_;
+            return str + first_bit(mask);
         }
+        str += 16;
     }
+#endif
 
-    bool top() const
+    auto ptr = align_down(str);
+    auto mask = block(ptr).eq<Chars..., 0>() & (~uint64_t{} << (str - ptr));
+    while (!mask)
     {
-        assert(!empty());
-        return bits_[pos_] & mask_;
+        ptr += block_size;
+        mask = block(ptr).eq<Chars..., 0>();
     }
+    return ptr + first_bit(mask);
+}
 
-    constexpr int capacity() const
+// finds the first character in [str, end) which is one of Chars, returns end if there is none
+template <char... Chars>
+HAISU_NO_SANITIZE_ADDRESS const char* find_first_of(const char* str, const char* end) noexcept
+{
+#if HAISU_JSON_SIMD
+    if (end - str >= 16)
     {
-        return N;
+        if (const auto mask = probe<Chars...>(str))
+        {
+            return str + first_bit(mask);
+        }
+        str += 16;
     }
+#endif
 
-private:
-    void push_flag(std::true_type)
+    if (str >= end)
     {
-        bits_[pos_] |= mask_; 
+        return end;
     }
 
-    void push_flag(std::false_type)
+    auto ptr = align_down(str);
+    auto mask = block(ptr).eq<Chars...>() & (~uint64_t{} << (str - ptr));
+    while (end - ptr > block_size)
     {
+        if (mask)
+        {
+            return ptr + first_bit(mask);
+        }
+        ptr += block_size;
+        mask = block(ptr).eq<Chars...>();
     }
 
-    uint64_t bits_[storage_size];
-    uint64_t mask_ = 0;
-    int pos_ = -1;
-};
+    mask &= ~uint64_t{} >> (block_size - (end - ptr));
+    return mask ? ptr + first_bit(mask) : end;
+}
 
-template <>
-class bitstack<63>
+// finds the first character which is none of Chars, the null-terminator stops the search as well
+template <char... Chars>
+HAISU_NO_SANITIZE_ADDRESS const char* find_first_not_of(const char* str) noexcept
 {
-public:
-    constexpr bool top() const
+    auto ptr = align_down(str);
+    auto mask = ~block(ptr).eq<Chars...>() & (~uint64_t{} << (str - ptr));
+    while (!mask)
     {
-        return bits_ & mask_;
+        ptr += block_size;
+        mask = ~block(ptr).eq<Chars...>();
+    }
+    return ptr + first_bit(mask);
+}
+
+// finds the first character in [str, end) which is none of Chars, returns end if there is none
+template <char... Chars>
+HAISU_NO_SANITIZE_ADDRESS const char* find_first_not_of(const char* str, const char* end) noexcept
+{
+    if (str >= end)
+    {
+        return end;
+    }
+
+    auto ptr = align_down(str);
+    auto mask = ~block(ptr).eq<Chars...>() & (~uint64_t{} << (str - ptr));
+    while (end - ptr > block_size)
+    {
+        if (mask)
+        {
+            return ptr + first_bit(mask);
+        }
+        ptr += block_size;
+        mask = ~block(ptr).eq<Chars...>();
     }
 
-    void pop()
+    mask &= ~uint64_t{} >> (block_size - (end - ptr));
+    return mask ? ptr + first_bit(mask) : end;
+}
+
+#if HAISU_JSON_SIMD
+// looks at 16 unaligned bytes, bit N is set if the byte N is a string stop (see block::string_stops)
+HAISU_NO_SANITIZE_ADDRESS inline uint32_t probe_string_stops(const char* str) noexcept
+{
+    const auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str));
+    const auto stops = _mm_or_si128(_mm_cmplt_epi8(v, _mm_set1_epi8(0x20)),
+        _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('"')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\\'))));
+    return static_cast<uint32_t>(_mm_movemask_epi8(stops));
+}
+#endif
+
+// finds the first string stop, the null-terminator is one of them
+HAISU_NO_SANITIZE_ADDRESS inline const char* find_string_stop(const char* str) noexcept
+{
+#if HAISU_JSON_SIMD
+    if ((reinterpret_cast<uintptr_t>(str) & (page_size - 1)) <= page_size - 16)
+    {
+        if (const auto mask = probe_string_stops(str))
+        {
+            return str + first_bit(mask);
+        }
+        str += 16;
+    }
+#endif
+
+    auto ptr = align_down(str);
+    auto mask = block(ptr).string_stops() & (~uint64_t{} << (str - ptr));
+    while (!mask)
+    {
+        ptr += block_size;
+        mask = block(ptr).string_stops();
+    }
+    return ptr + first_bit(mask);
+}
+
+// finds the first string stop in [str, end), returns end if there is none
+HAISU_NO_SANITIZE_ADDRESS inline const char* find_string_stop(const char* str, const char* end) noexcept
+{
+#if HAISU_JSON_SIMD
+    if (end - str >= 16)
+    {
+        if (const auto mask = probe_string_stops(str))
+        {
+            return str + first_bit(mask);
+        }
+        str += 16;
+    }
+#endif
+
+    if (str >= end)
+    {
+        return end;
+    }
+
+    auto ptr = align_down(str);
+    auto mask = block(ptr).string_stops() & (~uint64_t{} << (str - ptr));
+    while (end - ptr > block_size)
+    {
+        if (mask)
+        {
+            return ptr + first_bit(mask);
+        }
+        ptr += block_size;
+        mask = block(ptr).string_stops();
+    }
+
+    mask &= ~uint64_t{} >> (block_size - (end - ptr));
+    return mask ? ptr + first_bit(mask) : end;
+}
+
+#if HAISU_JSON_SIMD
+// looks at 16 unaligned bytes, bit N is set if the byte N needs escaping (see block::escapes)
+HAISU_NO_SANITIZE_ADDRESS inline uint32_t probe_escapes(const char* str) noexcept
+{
+    const auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str));
+    const auto control = _mm_andnot_si128(_mm_cmplt_epi8(v, _mm_setzero_si128()), _mm_cmplt_epi8(v, _mm_set1_epi8(0x20)));
+    const auto escapes = _mm_or_si128(control,
+        _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('"')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\\'))));
+    return static_cast<uint32_t>(_mm_movemask_epi8(escapes));
+}
+#endif
+
+// finds the first byte in [str, end) a json writer has to escape, returns end if there is none
+HAISU_NO_SANITIZE_ADDRESS inline const char* find_escape(const char* str, const char* end) noexcept
+{
+    if (str >= end)
+    {
+        return end;
+    }
+
+#if HAISU_JSON_SIMD
+    // most of the strings are short, one probe does (it may look past the end, but not past the page)
+    if (end - str >= 16 || (reinterpret_cast<uintptr_t>(str) & (page_size - 1)) <= page_size - 16)
+    {
+        const auto len = end - str;
+        const auto mask = probe_escapes(str) & (len >= 16 ? ~uint32_t{} : (uint32_t{1} << len) - 1);
+        if (mask || len <= 16)
+        {
+            return mask ? str + first_bit(mask) : end;
+        }
+        str += 16;
+    }
+#endif
+
+    auto ptr = align_down(str);
+    auto mask = block(ptr).escapes() & (~uint64_t{} << (str - ptr));
+    while (end - ptr > block_size)
+    {
+        if (mask)
+        {
+            return ptr + first_bit(mask);
+        }
+        ptr += block_size;
+        mask = block(ptr).escapes();
+    }
+
+    mask &= ~uint64_t{} >> (block_size - (end - ptr));
+    return mask ? ptr + first_bit(mask) : end;
+}
+
+} // namespace simd
+
+template <typename Expr, typename Var>
+constexpr auto is_valid_expression_impl(int) -> decltype(std::declval<Expr>()(std::declval<Var>()), bool())
+{
+    return true;
+}
+
+template <typename Expr, typename Var>
+constexpr bool is_valid_expression_impl(long)
+{
+    return false;
+}
+
+template <typename Var, typename Expr>
+constexpr bool is_valid_expression(Expr&&, Var&&)
+{
+    return is_valid_expression_impl<Expr, Var>(0);
+}
+
+template <typename Var, typename Expr>
+constexpr bool is_valid_expression(Expr&&)
+{
+    return is_valid_expression_impl<Expr, Var>(0);
+}
+
+static_assert(is_valid_expression([](auto&& o) -> decltype(o.size()) {}, std::array<int, 10>()), "");
+static_assert(!is_valid_expression([](auto&& o) -> decltype(o.clear()) {}, std::array<int, 10>()), "");
+
+inline bool is_blank(char ch)
+{
+    return ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n';
+}
+
+inline bool is_separator(char ch)
+{
+    return is_blank(ch) || ch == '}' || ch == ']' || ch == ',';
+}
+
+inline const char* skip_blanks(const char* str)
+{
+#if HAISU_JSON_SIMD
+    return simd::find_first_not_of<' ', '\t', '\r', '\n'>(str);
+#else
+    while (is_blank(*str)) ++str;
+    return str;
+#endif
+}
+
+inline const char* skip_blanks(const char* str, const char* end)
+{
+#if HAISU_JSON_SIMD
+    return simd::find_first_not_of<' ', '\t', '\r', '\n'>(str, end);
+#else
+    while (str < end && is_blank(*str)) ++str;
+    return str;
+#endif
+}
+
+inline const char* skip_to(char ch, const char* str)
+{
+    while (*str && *str != ch) ++str;
+    return str;
+}
+
+template <char ch>
+const char* skip_to(const char* str)
+{
+    while (*str && *str != ch) ++str;
+    return str;
+}
+
+template <char ch>
+const char* skip_past(const char* str)
+{
+    auto ret = skip_to<ch>(str);
+    return ret + (*ret ? 1 : 0);
+}
+
+
+inline bool preceded_by_even_number_of_backslashes(const char* str)
+{
+    int ret = 1;
+    while (*str-- == '\\')
+    {
+        ret ^= 1;
+    }
+    
+    return ret;
+}
+
+// returns either the closing quote or the null-terminator
+template <char Quote>
+inline const char* skip_to_end_of_string(const char* str)
+{
+#if HAISU_JSON_SIMD
+    // jump from one quote or backslash to another, a backslash always escapes the next character
+    while (true)
+    {
+        str = simd::find_first_of<Quote, '\\'>(str);
+        if (*str != '\\')
+        {
+            return str;
+        }
+
+        if (!str[1])
+        {
+            return str + 1;
+        }
+
+        str += 2;
+    }
+#else
+    while (true)
+    {
+        str = skip_to<Quote>(str);
+        if (*str && str[-1] == '\\' && preceded_by_even_number_of_backslashes(str - 2))
+        {
+            ++str;    
+            continue;
+        }
+        break;
+    }
+    return str;
+#endif
+}
+
+// returns either the closing quote or the end of input
+template <char Quote>
+inline const char* skip_to_end_of_string(const char* str, const char* end)
+{
+    while (true)
+    {
+#if HAISU_JSON_SIMD
+        str = simd::find_first_of<Quote, '\\'>(str, end);
+#else
+        while (str < end && *str != Quote && *str != '\\') ++str;
+#endif
+        if (str == end || *str != '\\')
+        {
+            return str;
+        }
+
+        if (end - str < 2)
+        {
+            return end;
+        }
+
+        str += 2;
+    }
+}
+
+// same as skip_to_end_of_string, also tells where the first backslash is (escape == end of string if there is none)
+template <char Quote>
+inline const char* find_string_end(const char* str, const char*& escape)
+{
+#if HAISU_JSON_SIMD
+    escape = simd::find_first_of<Quote, '\\'>(str);
+#else
+    escape = str;
+    while (*escape && *escape != Quote && *escape != '\\') ++escape;
+#endif
+    return *escape == '\\' ? skip_to_end_of_string<Quote>(escape) : escape;
+}
+
+template <char Quote>
+inline const char* find_string_end(const char* str, const char* end, const char*& escape)
+{
+#if HAISU_JSON_SIMD
+    escape = simd::find_first_of<Quote, '\\'>(str, end);
+#else
+    escape = str;
+    while (escape < end && *escape != Quote && *escape != '\\') ++escape;
+#endif
+    return escape != end && *escape == '\\' ? skip_to_end_of_string<Quote>(escape, end) : escape;
+}
+
+namespace simd
+{
+
+// what goes into the index besides the brackets, the quotes and the first bytes of scalars
+enum index_flags : unsigned
+{
+    index_punctuation = 1, // commas and colons after a blank or another one, the parser takes the ones right after a token
+    index_newlines = 2,
+    index_string_stops = 4 // the bytes a validating string scan stops at, see block::string_stops
+};
+
+// The positions the parser has to look at, found a batch of blocks at a time: brackets, quotes (the opening and the
+// closing ones), the first bytes of numbers and literals (whatever follows a blank, a structural character or a
+// quote), the null-terminator, and whatever Flags ask for (see index_flags).
+// The parser asks for the next token from right after the last one, which is never inside of a string, so a batch
+// may be indexed from any position with no state carried over: a jump of the parser past the batch (a string scanned
+// by itself, skip()) costs a fresh batch, nothing more. The single-quoted strings are not followed: the rest of the
+// block after a single quote is not indexed, every byte of it is a token, the same as if there was no index at all,
+// and the batch ends there.
+template <bool Bounded, unsigned Flags>
+class block_indexer
+{
+public:
+    enum { batch_size = 16 }; // blocks
+
+    explicit block_indexer(const char* end) noexcept
+        : end_(end)
+    {
+    }
+
+    // indexes the blocks starting at the one of str, returns how many; fresh: str is outside of a string, otherwise
+    // the blocks are picked up right where the last batch has ended, in the middle of a string
+    HAISU_NO_SANITIZE_ADDRESS int index(const char* str, bool fresh) noexcept
+    {
+        if (fresh)
+        {
+            scanner_ = string_scanner{};
+            separator_carry_ = 1;
+            blank_carry_ = 1;
+        }
+
+        first_ = align_down(str);
+        unindexed_ = nullptr;
+        more_ = false;
+        count_ = 0;
+        for (auto ptr = first_; ; ptr += block_size)
+        {
+            if (count_ == batch_size)
+            {
+                more_ = true;
+                break;
+            }
+
+            if constexpr (Bounded)
+            {
+                if (ptr >= end_)
+                {
+                    break;
+                }
+            }
+
+            const auto skipped = count_ ? 0 : str - ptr;
+            auto valid = ~uint64_t{} << skipped;
+            const block b(ptr);
+            uint64_t last = 0; // the null-terminator
+            if constexpr (Bounded)
+            {
+                if (end_ - ptr < block_size)
+                {
+                    valid &= ~uint64_t{} >> (block_size - (end_ - ptr));
+                }
+            }
+            else if (const auto zero = b.eq<0>() & valid)
+            {
+                last = zero & (0 - zero);
+                valid &= last - 1;
+            }
+
+            const auto backslash = b.in<class_backslash>() & valid;
+            const auto quote = b.in<class_quote>() & valid & ~scanner_.escaped(backslash);
+            const auto outside = ~scanner_.strings(quote) & valid;
+            const auto brackets = b.in<class_bracket>();
+            const auto separator = b.in<class_bracket | class_comma | class_colon | class_space | class_control_blank | class_quote>();
+            const auto follows_separator = separator << 1 | separator_carry_ << skipped;
+            auto mask = quote | ((brackets | (~separator & follows_separator)) & outside);
+            separator_carry_ = separator >> 63;
+            if constexpr ((Flags & index_punctuation) != 0)
+            {
+                const auto punctuation = b.in<class_comma | class_colon>();
+                const auto blank_or_punctuation = b.in<class_space | class_control_blank | class_comma | class_colon>();
+                mask |= punctuation & (blank_or_punctuation << 1 | blank_carry_ << skipped) & outside;
+                blank_carry_ = blank_or_punctuation >> 63;
+            }
+            if constexpr ((Flags & index_newlines) != 0)
+            {
+                mask |= b.in<class_newline>() & outside;
+            }
+            if constexpr ((Flags & index_string_stops) != 0)
+            {
+                stops_[count_] = (b.below<0x20>() | backslash) & ~outside & valid;
+            }
+
+            const auto squote = b.eq<'\''>() & outside;
+            if (squote)
+            {
+                const auto unindexed = ~uint64_t{} << first_bit(squote);
+                unindexed_ = ptr + first_bit(squote);
+                mask |= unindexed & valid;
+            }
+
+            masks_[count_++] = mask | last;
+            if (last || squote)
+            {
+                break;
+            }
+        }
+        return count_;
+    }
+
+    const char* first() const noexcept
+    {
+        return first_;
+    }
+
+    int count() const noexcept
+    {
+        return count_;
+    }
+
+    // the batch has ended because it is full, not at the end of input or at a single quote
+    bool more() const noexcept
+    {
+        return more_;
+    }
+
+    // the tokens of the block N of the batch
+    uint64_t mask(int n) const noexcept
+    {
+        return masks_[n];
+    }
+
+    // the string stops inside of the strings of the block N, if Flags ask for them
+    uint64_t stops(int n) const noexcept
+    {
+        return stops_[n];
+    }
+
+    // the single quote past which the last block is not indexed, nullptr if there is none
+    const char* unindexed() const noexcept
+    {
+        return unindexed_;
+    }
+
+    const char* end() const noexcept
+    {
+        return end_;
+    }
+
+private:
+    const char* end_;
+    const char* first_ = nullptr;
+    const char* unindexed_ = nullptr;
+    int count_ = 0;
+    bool more_ = false;
+    string_scanner scanner_;
+    uint64_t separator_carry_ = 1; // the byte before the one the batch is indexed from is a separator
+    uint64_t blank_carry_ = 1; // and a blank (or a comma, or a colon)
+    uint64_t masks_[batch_size];
+    uint64_t stops_[(Flags & index_string_stops) != 0 ? batch_size : 1];
+};
+
+// walks the tokens found by block_indexer, the tokens are taken in order, so the next one does not wait for the parser
+// to find out where the last one ends
+template <bool Bounded, unsigned Flags>
+class structural_index
+{
+public:
+    structural_index(block_indexer<Bounded, Flags>& indexer, const char* str) noexcept
+        : indexer_(indexer)
+    {
+        advance(str, true);
+    }
+
+    // the first token at str or after it, the ones the parser has jumped over are dropped; the end of input if there
+    // are no more tokens
+    const char* next(const char* str) noexcept
+    {
+        while (true)
+        {
+            while (mask_)
+            {
+                const auto token = pop();
+                if (token >= str)
+                {
+                    return token;
+                }
+            }
+
+            // the block of str, or the one after the last one, the batch goes on in the middle of a string then
+            const auto batch_end = indexer_.first() + indexer_.count() * block_size;
+            if (str < batch_end && block_ + 1 < indexer_.count())
+            {
+                load(std::max<int>(block_ + 1, int((str - indexer_.first()) / block_size)));
+            }
+            else if ((str < batch_end && !indexer_.more()) || !advance(std::max(str, batch_end), str >= batch_end))
+            {
+                return indexer_.end();
+            }
+        }
+    }
+
+    // the closing quote of the double-quoted string which contents start at str (the opening quote is the last token
+    // returned by next), the null-terminator or the end of input if the string is not closed
+    const char* string_end(const char* str) noexcept
+    {
+        if (indexer_.unindexed() && str - 1 >= indexer_.unindexed())
+        {
+            return Bounded ? skip_to_end_of_string<'"'>(str, indexer_.end()) : skip_to_end_of_string<'"'>(str);
+        }
+
+        while (!mask_) // the string goes on
+        {
+            if (block_ + 1 < indexer_.count())
+            {
+                load(block_ + 1);
+            }
+            else if (!indexer_.more() || !advance(block_ptr_ + block_size, false))
+            {
+                return indexer_.end();
+            }
+        }
+        return pop();
+    }
+
+    // the closing quote of the double-quoted string which contents start at str, if the string ends in the same block
+    // and there is no string stop in it (nothing to validate then), nullptr otherwise
+    const char* plain_string_end(const char* str) noexcept
+    {
+        if (!mask_ || (indexer_.unindexed() && str - 1 >= indexer_.unindexed()))
+        {
+            return nullptr;
+        }
+
+        const auto before_next = (mask_ & (0 - mask_)) - 1;
+        if (indexer_.stops(block_) & before_next & (~uint64_t{} << (str - 1 - block_ptr_)))
+        {
+            return nullptr;
+        }
+        return pop();
+    }
+
+    // the parser has found the end of the string by itself, the closing quote is not looked for then, but it is
+    // dropped if it is in the same block (next would drop it anyway)
+    void skip_string_end() noexcept
+    {
+        if (mask_)
+        {
+            pop();
+        }
+    }
+
+private:
+    const char* pop() noexcept
+    {
+        const auto token = block_ptr_ + first_bit(mask_);
+        mask_ &= mask_ - 1;
+        return token;
+    }
+
+    void load(int block) noexcept
+    {
+        block_ = block;
+        block_ptr_ = indexer_.first() + block * block_size;
+        mask_ = block < indexer_.count() ? indexer_.mask(block) : 0;
+    }
+
+    bool advance(const char* str, bool fresh) noexcept
+    {
+        if (!indexer_.index(str, fresh))
+        {
+            return false;
+        }
+        load(0);
+        return true;
+    }
+
+    block_indexer<Bounded, Flags>& indexer_;
+    const char* block_ptr_ = nullptr;
+    uint64_t mask_ = 0; // the tokens of the block not taken yet
+    int block_ = 0;
+};
+
+} // namespace simd
+
+// the contents of a container start at str, returns the matching closing bracket or the null-terminator,
+// nothing but the brackets and the quotes is looked at
+inline const char* skip_container(const char* str)
+{
+    int depth = 1;
+#if HAISU_JSON_SIMD
+    // most of the containers are small, the first few characters are cheaper to look at one by one
+    for (const auto limit = str + 16; str < limit; ++str)
+    {
+        switch (*str)
+        {
+            case 0:
+                return str;
+            case '"':
+                str = skip_to_end_of_string<'"'>(str + 1);
+                if (!*str)
+                {
+                    return str;
+                }
+                break;
+            case '\'':
+                str = skip_to_end_of_string<'\''>(str + 1);
+                if (!*str)
+                {
+                    return str;
+                }
+                break;
+            case '{':
+            case '[':
+                ++depth;
+                break;
+            case '}':
+            case ']':
+                if (--depth == 0)
+                {
+                    return str;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    while (true)
+    {
+        str = simd::skip_brackets<false>(str, nullptr, depth);
+        if (*str != '\'')
+        {
+            return str;
+        }
+
+        str = skip_to_end_of_string<'\''>(str + 1);
+        if (!*str)
+        {
+            return str;
+        }
+        ++str;
+    }
+#else
+    while (true)
+    {
+        while (*str && *str != '{' && *str != '}' && *str != '[' && *str != ']' && *str != '"' && *str != '\'') ++str;
+        switch (*str)
+        {
+            case 0:
+                return str;
+            case '"':
+                str = skip_to_end_of_string<'"'>(str + 1);
+                break;
+            case '\'':
+                str = skip_to_end_of_string<'\''>(str + 1);
+                break;
+            case '{':
+            case '[':
+                ++depth;
+                break;
+            default:
+                if (--depth == 0)
+                {
+                    return str;
+                }
+        }
+
+        if (*str)
+        {
+            ++str;
+        }
+    }
+#endif
+}
+
+// same as above, returns end if the container is not closed
+inline const char* skip_container(const char* str, const char* end)
+{
+    int depth = 1;
+#if HAISU_JSON_SIMD
+    for (const auto limit = end - str > 16 ? str + 16 : end; str < limit; ++str)
+    {
+        switch (*str)
+        {
+            case '"':
+                str = skip_to_end_of_string<'"'>(str + 1, end);
+                if (str == end)
+                {
+                    return end;
+                }
+                break;
+            case '\'':
+                str = skip_to_end_of_string<'\''>(str + 1, end);
+                if (str == end)
+                {
+                    return end;
+                }
+                break;
+            case '{':
+            case '[':
+                ++depth;
+                break;
+            case '}':
+            case ']':
+                if (--depth == 0)
+                {
+                    return str;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    while (true)
+    {
+        str = simd::skip_brackets<true>(str, end, depth);
+        if (str == end || *str != '\'')
+        {
+            return str;
+        }
+
+        str = skip_to_end_of_string<'\''>(str + 1, end);
+        if (str == end)
+        {
+            return end;
+        }
+        ++str;
+    }
+#else
+    while (true)
+    {
+        while (str < end && *str != '{' && *str != '}' && *str != '[' && *str != ']' && *str != '"' && *str != '\'') ++str;
+        if (str == end)
+        {
+            return end;
+        }
+
+        switch (*str)
+        {
+            case '"':
+                str = skip_to_end_of_string<'"'>(str + 1, end);
+                break;
+            case '\'':
+                str = skip_to_end_of_string<'\''>(str + 1, end);
+                break;
+            case '{':
+            case '[':
+                ++depth;
+                break;
+            default:
+                if (--depth == 0)
+                {
+                    return str;
+                }
+        }
+
+        if (str != end)
+        {
+            ++str;
+        }
+    }
+#endif
+}
+
+// numbers and literals are made of these
+inline bool is_scalar_char(char ch)
+{
+    return unsigned(ch - '0') < 10 || unsigned((ch | 0x20) - 'a') < 26 || ch == '.' || ch == '-' || ch == '+';
+}
+
+// the value of a key starts at str (the colon included), returns the position right after the value
+inline const char* skip_value(const char* str)
+{
+    // there is hardly more than a single blank around the colon
+    str += is_blank(*str);
+    str = is_blank(*str) ? skip_blanks(str) : str;
+    if (*str == ':')
+    {
+        str += 1 + is_blank(str[1]);
+        str = is_blank(*str) ? skip_blanks(str) : str;
+    }
+
+    switch (*str)
+    {
+        case '{':
+        case '[':
+            str = skip_container(str + 1);
+            break;
+        case '"':
+            str = skip_to_end_of_string<'"'>(str + 1);
+            break;
+        case '\'':
+            str = skip_to_end_of_string<'\''>(str + 1);
+            break;
+        default:
+            while (is_scalar_char(*str)) ++str;
+            return str;
+    }
+
+    return str + (*str ? 1 : 0);
+}
+
+inline const char* skip_value(const char* str, const char* end)
+{
+    str = str < end && is_blank(*str) ? skip_blanks(str, end) : str;
+    if (str < end && *str == ':')
+    {
+        ++str;
+        str = str < end && is_blank(*str) ? skip_blanks(str, end) : str;
+    }
+
+    if (str == end)
+    {
+        return end;
+    }
+
+    switch (*str)
+    {
+        case '{':
+        case '[':
+            str = skip_container(str + 1, end);
+            break;
+        case '"':
+            str = skip_to_end_of_string<'"'>(str + 1, end);
+            break;
+        case '\'':
+            str = skip_to_end_of_string<'\''>(str + 1, end);
+            break;
+        default:
+            while (str < end && is_scalar_char(*str)) ++str;
+            return str;
+    }
+
+    return str + (str != end ? 1 : 0);
+}
+
+inline int hex_digit(char ch)
+{
+    if (ch >= '0' && ch <= '9')
+    {
+        return ch - '0';
+    }
+
+    ch |= 0x20;
+    return ch >= 'a' && ch <= 'f' ? ch - 'a' + 10 : -1;
+}
+
+// four hex digits of \uXXXX, -1 if there is something else
+inline int32_t read_hex4(const char* str)
+{
+    int32_t ret = 0;
+    for (int i = 0; i < 4; ++i)
+    {
+        const auto digit = hex_digit(str[i]);
+        if (digit < 0)
+        {
+            return -1;
+        }
+        ret = (ret << 4) | digit;
+    }
+    return ret;
+}
+
+inline char* encode_utf8(uint32_t cp, char* out)
+{
+    if (cp < 0x80)
+    {
+        *out++ = char(cp);
+    }
+    else if (cp < 0x800)
+    {
+        *out++ = char(0xc0 | (cp >> 6));
+        *out++ = char(0x80 | (cp & 0x3f));
+    }
+    else if (cp < 0x10000)
+    {
+        *out++ = char(0xe0 | (cp >> 12));
+        *out++ = char(0x80 | ((cp >> 6) & 0x3f));
+        *out++ = char(0x80 | (cp & 0x3f));
+    }
+    else
+    {
+        *out++ = char(0xf0 | (cp >> 18));
+        *out++ = char(0x80 | ((cp >> 12) & 0x3f));
+        *out++ = char(0x80 | ((cp >> 6) & 0x3f));
+        *out++ = char(0x80 | (cp & 0x3f));
+    }
+    return out;
+}
+
+// decodes the escape sequence at begin (a backslash) into out, moves begin past it, returns the end of the output;
+// at most four bytes are written, see unescape
+inline char* unescape_one(const char*& begin, const char* end, char* out)
+{
+    if (end - begin < 2) // a backslash at the very end
+    {
+        *out++ = *begin++;
+        return out;
+    }
+
+    const char ch = begin[1];
+    begin += 2;
+    switch (ch)
+    {
+        case '"':
+        case '\\':
+        case '/':
+        case '\'':
+            *out++ = ch;
+            break;
+        case 'b':
+            *out++ = '\b';
+            break;
+        case 'f':
+            *out++ = '\f';
+            break;
+        case 'n':
+            *out++ = '\n';
+            break;
+        case 'r':
+            *out++ = '\r';
+            break;
+        case 't':
+            *out++ = '\t';
+            break;
+        case 'u':
+            {
+                auto cp = end - begin >= 4 ? read_hex4(begin) : -1;
+                if (cp < 0)
+                {
+                    *out++ = '\\';
+                    *out++ = 'u';
+                    break;
+                }
+
+                begin += 4;
+                if (cp >= 0xd800 && cp < 0xdc00) // a high surrogate, the low one must follow
+                {
+                    const auto low = end - begin >= 6 && begin[0] == '\\' && begin[1] == 'u' ? read_hex4(begin + 2) : -1;
+                    if (low >= 0xdc00 && low < 0xe000)
+                    {
+                        cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+                        begin += 6;
+                    }
+                    else
+                    {
+                        cp = 0xfffd;
+                    }
+                }
+                else if (cp >= 0xdc00 && cp < 0xe000)
+                {
+                    cp = 0xfffd;
+                }
+
+                out = encode_utf8(uint32_t(cp), out);
+            }
+            break;
+        default:
+            *out++ = '\\';
+            *out++ = ch;
+            break;
+    }
+    return out;
+}
+
+// decodes the escape sequences of [begin, end) into out, returns the end of the decoded string
+// the decoded string is never longer than the original one, so out may be equal to begin (in place decoding)
+// \uXXXX goes to UTF-8, a lone surrogate becomes U+FFFD, a malformed escape sequence is copied as is
+inline char* unescape(const char* begin, const char* end, char* out)
+{
+    while (true)
+    {
+#if HAISU_JSON_SIMD
+        const auto esc = simd::find_first_of<'\\'>(begin, end);
+#else
+        auto esc = begin;
+        while (esc < end && *esc != '\\') ++esc;
+#endif
+        if (out != begin)
+        {
+            std::memmove(out, begin, size_t(esc - begin));
+        }
+        out += esc - begin;
+        begin = esc;
+
+        if (begin == end)
+        {
+            return out;
+        }
+
+        out = unescape_one(begin, end, out);
+    }
+}
+
+// compares the text the escaped string [first, last) decodes into with the plain one, an escape sequence at a time,
+// nothing is allocated; escape is the first backslash of the string (or last)
+inline bool decoded_equals(const char* first, const char* last, const char* escape, std::string_view text) noexcept
+{
+    while (escape != last)
+    {
+        const auto run = size_t(escape - first);
+        if (text.compare(0, run, first, run) != 0)
+        {
+            return false;
+        }
+        text.remove_prefix(run);
+
+        char decoded[4];
+        first = escape;
+        const auto size = size_t(unescape_one(first, last, decoded) - decoded);
+        if (text.compare(0, size, decoded, size) != 0)
+        {
+            return false;
+        }
+        text.remove_prefix(size);
+
+        escape = first;
+        while (escape != last && *escape != '\\') ++escape;
+    }
+    return text == std::string_view(first, size_t(last - first));
+}
+
+// the length of a well-formed UTF-8 sequence starting at str, zero if it is ill-formed or cut by the end;
+// the ranges are those of the Unicode table 3-7: no overlong forms, no surrogates, nothing past U+10FFFF
+inline int utf8_sequence_length(const char* str, const char* end) noexcept
+{
+    const auto lead = uint8_t(str[0]);
+    const auto in = [str, end](int i, uint8_t lo, uint8_t hi) {
+        return end - str > i && uint8_t(str[i]) >= lo && uint8_t(str[i]) <= hi;
+    };
+
+    if (lead < 0x80)
+    {
+        return 1;
+    }
+    else if (lead < 0xc2)
+    {
+        return 0;
+    }
+    else if (lead < 0xe0)
+    {
+        return in(1, 0x80, 0xbf) ? 2 : 0;
+    }
+    else if (lead < 0xf0)
+    {
+        return in(1, lead == 0xe0 ? 0xa0 : 0x80, lead == 0xed ? 0x9f : 0xbf) && in(2, 0x80, 0xbf) ? 3 : 0;
+    }
+    else if (lead < 0xf5)
+    {
+        return in(1, lead == 0xf0 ? 0x90 : 0x80, lead == 0xf4 ? 0x8f : 0xbf) && in(2, 0x80, 0xbf) && in(3, 0x80, 0xbf) ? 4 : 0;
+    }
+    return 0;
+}
+
+// true if [str, end) may begin a well-formed sequence, the end cutting it short
+inline bool utf8_sequence_prefix(const char* str, const char* end) noexcept
+{
+    const auto lead = uint8_t(str[0]);
+    if (lead < 0xc2 || lead >= 0xf5)
+    {
+        return false;
+    }
+
+    const auto lo = lead == 0xe0 ? 0xa0 : lead == 0xf0 ? 0x90 : 0x80;
+    const auto hi = lead == 0xed ? 0x9f : lead == 0xf4 ? 0x8f : 0xbf;
+    for (auto i = 1; i < end - str; ++i)
+    {
+        const auto ch = uint8_t(str[i]);
+        if (i == 1 ? (ch < lo || ch > hi) : (ch < 0x80 || ch > 0xbf))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// the validating counterpart of find_string_end: follows a double-quoted string (the opening quote excluded) checking
+// it against RFC 8259 on the way, returns either the closing quote, or the first byte breaking the rules (a control
+// character, the backslash of a malformed escape sequence, the beginning of ill-formed UTF-8), or the end of input
+// (the null-terminator, if not bounded); an escape sequence or a UTF-8 one cut by the end is left for the next chunk;
+// escape is set to the first backslash, if there is one
+template <bool Bounded>
+inline const char* validate_string(const char* str, const char* end, const char*& escape) noexcept
+{
+    while (true)
+    {
+#if HAISU_JSON_SIMD
+        str = Bounded ? simd::find_string_stop(str, end) : simd::find_string_stop(str);
+#else
+        while ((!Bounded || str < end) && uint8_t(*str) >= 0x20 && uint8_t(*str) < 0x80 && *str != '"' && *str != '\\') ++str;
+#endif
+        if (Bounded && str == end)
+        {
+            return end;
+        }
+
+        const auto ch = uint8_t(*str);
+        if (ch == '"')
+        {
+            return str;
+        }
+        else if (ch == '\\')
+        {
+            if (Bounded && end - str < 2)
+            {
+                return end;
+            }
+
+            escape = escape ? escape : str;
+            switch (str[1])
+            {
+                case '"':
+                case '\\':
+                case '/':
+                case 'b':
+                case 'f':
+                case 'n':
+                case 'r':
+                case 't':
+                    str += 2;
+                    break;
+                case 'u':
+                    if (Bounded && end - str < 6)
+                    {
+                        return end;
+                    }
+                    else if (read_hex4(str + 2) < 0)
+                    {
+                        return str;
+                    }
+                    str += 6;
+                    break;
+                default:
+                    return str;
+            }
+        }
+        else if (ch < 0x80) // a control character
+        {
+            return str;
+        }
+        else
+        {
+            // non-ASCII characters tend to come in runs
+            do
+            {
+                const auto lead = uint8_t(*str);
+                if (Bounded && end - str < (lead >= 0xf0 ? 4 : lead >= 0xe0 ? 3 : 2))
+                {
+                    // cut by the end, unless the bytes before it break the sequence already (the closing quote does)
+                    return utf8_sequence_prefix(str, end) ? end : str;
+                }
+
+                const auto len = utf8_sequence_length(str, Bounded ? end : str + 4);
+                if (!len)
+                {
+                    return str;
+                }
+                str += len;
+            }
+            while ((!Bounded || str < end) && uint8_t(*str) >= 0x80);
+        }
+    }
+}
+
+template <typename T>
+class dquote
+{
+public:
+    enum {trigger = '"'};
+
+    void parse(const char*& str)
+    {
+    }
+
+private:
+};
+
+template <typename T>
+class quote
+{
+public:
+    enum {trigger = '\''};
+
+    void parse(const char*& str)
+    {
+    }
+
+private:
+};
+
+
+template <typename T, int N>
+class static_stack
+{
+public:
+    using size_type = meta::memory_requirement_t<N>;
+    const T& top() const noexcept
+    {
+        assert(cur_ < N);
+        return stack_[cur_];
+    }
+
+    T& top() noexcept
+    {
+        assert(cur_ < N);
+        return stack_[cur_];
+    }
+
+    template <T val>
+    void push() noexcept 
+    {
+        assert(!full());
+
+        stack_[--cur_] = val;
+    }
+
+    void push(T t) noexcept
+    {
+        assert(!full());
+
+        stack_[--cur_] = t;
+    }
+
+    void replace_top(T t) noexcept
+    {
+        top() = t;
+    }
+
+    void pop() noexcept
+    {
+        assert(cur_ < N);
+        ++cur_;
+    }
+
+    bool empty() const noexcept
+    {
+        return cur_ == N;
+    }
+
+    bool full() const noexcept
+    {
+        return cur_ == 0;
+    }
+
+    size_type size() const noexcept
+    {
+        return N - cur_;
+    }
+
+    void clear() noexcept
+    {
+        cur_ = N;
+    }
+
+    static size_type capacity() noexcept
+    {
+        return N;
+    }
+
+private:
+    T stack_[N];
+    size_type cur_ = N;
+};
+
+template <int N>
+using boolstack = mono::stack<bool, N>;
+
+template <int N>
+class bitstack
+{
+    enum { storage_size = N % 64 ? N / 64 + 1 : N / 64 }; 
+public:
+    bool empty() const
+    {
+        return pos_ < 0;
+    }
+
+    template <bool Flag>
+    void push()
+    {
+        mask_ <<= 1;
+        if (!mask_)
+        {
+            mask_ = 1;
+            ++pos_;
+            bits_[pos_] = 0;
+        }
+
+        using tag = std::conditional_t<Flag, std::true_type, std::false_type>;
+        push_flag(tag());
+    }
+
+    void push(bool flag)
+    {
+        if (flag)
+        {
+            push<true>();
+        }
+        else
+        {
+            push<false>();
+        }
+    }
+
+    void pop()
+    {
+        assert(!empty());
+        mask_ >>= 1;
+        if (!mask_)
+        {
+            mask_ = 0x8000000000000000;
+            --pos_;
+        }
+    }
+
+    bool top() const
+    {
+        assert(!empty());
+        return bits_[pos_] & mask_;
+    }
+
+    constexpr int capacity() const
+    {
+        return N;
+    }
+
+private:
+    void push_flag(std::true_type)
+    {
+        bits_[pos_] |= mask_; 
+    }
+
+    void push_flag(std::false_type)
+    {
+    }
+
+    uint64_t bits_[storage_size];
+    uint64_t mask_ = 0;
+    int pos_ = -1;
+};
+
+template <>
+class bitstack<63>
+{
+public:
+    constexpr bool top() const
+    {
+        return bits_ & mask_;
+    }
+
+    void pop()
+    {
+        mask_ >>= 1;
+    }
+
+    template <bool Flag>
+    void push()
+    {
+        mask_ <<= 1;
+        using tag = std::conditional_t<Flag, std::true_type, std::false_type>;
+        push_flag(tag());
+    }
+
+    void push(bool flag) {
+        if (flag) {
+            push<true>();
+        } else {
+            push<false>();
+        }
+    }
+
+    constexpr int capacity() const
+    {
+        return 63;
+    }
+
+    bool empty() const {
+        return mask_ == 1;
+    }
+
+private:
+    void push_flag(std::true_type)
+    {
+        bits_ |= mask_;
+    }
+
+    void push_flag(std::false_type)
+    {
+        bits_ &= ~mask_;
+    }
+
+    uint64_t bits_ = 0;
+    uint64_t mask_ = 1;
+};
+
+template <int N>
+class nibblestack
+{
+public:
+    using size_type = meta::memory_requirement_t<N / 2>;
+
+    bool empty() const
+    {
+        return size_ == 0;
+    }
+
+    bool top() const
+    {
+        assert(size_ > 0);
+        return bits_[size_ - 1] & mask_;
+    }
+
+    template <bool Flag>
+    void push()
+    {
+        size_ += ((mask_ ^ 0xf0) + 1);
+        mask_ ^= 0xff;
+        
+        using tag = std::conditional_t<Flag, std::true_type, std::false_type>;
+        push_flag(tag());
+    }
+
+    void pop()
+    {
+        size_ -= ((mask_ ^ 0x0f) + 1);
+        mask_ ^= 0xff;
+    }
+
+private:
+    static_assert(0 == N % 2, "");
+
+    void push_flag(std::true_type)
+    {
+        bits_[size_ - 1] |= (mask_ & 0xff);
+    }
+
+    void push_flag(std::false_type)
+    {
+        bits_[size_ - 1] &= (mask_ ^ 0xff);
+    }
+
+    size_type size_ = 0;
+    uint8_t mask_ = 0xf0;
+    uint8_t bits_[N / 2];
+};
+
+template <int N>
+class objstack
+{
+public:
+    void push_array() noexcept
+    {
+        stack_.template push<true>();
+    }
+
+    void push_object() noexcept
+    {
+        stack_.template push<false>();
+    }
+
+    bool is_object_on_top() const noexcept
+    {
+        return !stack_.top();    
+    }
+
+    bool is_array_on_top() const noexcept
+    {
+        return stack_.top();
+    }
+
+    void pop() noexcept
+    {
+        stack_.pop();
+    }
+
+    bool empty() const noexcept
+    {
+        return stack_.empty();
+    }
+
+private:
+    boolstack<N> stack_;
+};
+
+template <int N>
+class compressed_objstack
+{
+public:
+    void push_array()
+    {
+        if (is_array_on_top())
+        {
+            assert(stack_[size_] != 0x7f);
+            ++stack_[size_];
+        }
+        else
+        {
+            assert(size_ < N);
+            ++size_;
+            stack_[size_] = 0x01;
+        }
+    }
+
+    void push_object()
+    {
+        if (is_object_on_top())
+        {
+            assert(stack_[size_] != 0xff);
+            ++stack_[size_];
+        }
+        else
+        {
+            assert(size_ < N);
+            ++size_;
+            stack_[size_] = 0x81;
+        }
+    }
+
+    void pop()
+    {
+        assert(size_ >= 0);    
+        stack_[size_] -= 1;
+        if (!(stack_[size_] & 0x7f))
+        {
+            --size_;
+        }
+    }
+
+    bool is_object_on_top() const
+    {
+        return stack_[size_] & 0x80;
+    }
+
+    bool is_array_on_top() const
+    {
+        return !is_object_on_top();
+    }
+    
+
+private:
+    int size_ = -1;
+    uint8_t stack_[N];    
+};
+
+// a stack of 2-bit values which never gets full: the upper 32 levels are packed into a single word, the deeper ones
+// are spilled word by word, first into the inline buffer (N levels in total fit without allocations), then into
+// the heap; a push or a pop is a shift, unless it crosses a word boundary
+template <int N>
+class packed_stack
+{
+    enum { word_levels = 32, inline_words = N > word_levels ? (N - 1) / word_levels : 1 };
+
+public:
+    using size_type = size_t;
+
+    uint8_t top() const noexcept
+    {
+        assert(!empty());
+        return top_ & 3;
+    }
+
+    void push(uint8_t val)
+    {
+        assert(val < 4);
+        if (count_ == word_levels)
+        {
+            spill();
+        }
+
+        top_ = top_ << 2 | val;
+        ++count_;
+    }
+
+    void replace_top(uint8_t val) noexcept
+    {
+        assert(!empty() && val < 4);
+        top_ = (top_ & ~uint64_t{3}) | val;
+    }
+
+    void pop() noexcept
+    {
+        assert(!empty());
+        top_ >>= 2;
+        if (--count_ == 0 && spilled_)
+        {
+            restore();
+        }
+    }
+
+    bool empty() const noexcept
+    {
+        return count_ == 0;
+    }
+
+    static constexpr bool full() noexcept
+    {
+        return false;
+    }
+
+    size_type size() const noexcept
+    {
+        return spilled_ * word_levels + count_;
+    }
+
+    void clear() noexcept
+    {
+        top_ = 0;
+        count_ = 0;
+        spilled_ = 0;
+    }
+
+    // the levels which fit without an allocation
+    static constexpr size_type inline_capacity() noexcept
+    {
+        return (inline_words + 1) * word_levels;
+    }
+
+private:
+    void spill()
+    {
+        if (spilled_ < inline_words)
+        {
+            inline_[spilled_] = top_;
+        }
+        else if (spilled_ - inline_words < heap_.size())
+        {
+            heap_[spilled_ - inline_words] = top_;
+        }
+        else
+        {
+            heap_.push_back(top_);
+        }
+
+        ++spilled_;
+        top_ = 0;
+        count_ = 0;
+    }
+
+    void restore() noexcept
+    {
+        --spilled_;
+        top_ = spilled_ < inline_words ? inline_[spilled_] : heap_[spilled_ - inline_words];
+        count_ = word_levels;
+    }
+
+    uint64_t top_ = 0; // the topmost level is in the lowest bits
+    uint32_t count_ = 0; // the levels in top_
+    size_t spilled_ = 0; // the words spilled
+    uint64_t inline_[inline_words];
+    std::vector<uint64_t> heap_;
+};
+
+enum class error_code
+{
+    json_too_deep_to_parse, // if you get this error, consider increasing the MaxDepth parameter in the parser
+    malformed_json, 
+    unexpected_character,
+    invalid_utf8,
+    unspecified_error
+};
+
+using string_view = std::string_view;
+
+struct string_literal
+{
+    string_view view;
+};
+
+struct null_literal 
+{
+};
+
+struct bool_literal 
+{
+    bool value;
+};
+
+struct numeric_literal 
+{ 
+    string_view view; 
+};
+
+struct error 
+{ 
+    const char* position; 
+    error_code err; 
+    const char* record = nullptr; // the recovering parser only: where the malformed record begins
+};
+
+namespace detail
+{
+
+// converts to U and nothing else, so that on_value(int64_t) is not mistaken for on_value(double)
+template <typename U>
+struct exactly
+{
+    template <typename V, typename = std::enable_if_t<std::is_same<U, V>::value>>
+    operator V() const;
+};
+
+struct not_a_number {};
+
+// the number goes to the first typed callback it fits into, anything else goes as a numeric_literal
+template <bool Int64, bool Uint64, bool Double, typename Call>
+void deliver_number(string_view view, const decimal& num, Call&& call)
+{
+    if (num.valid)
+    {
+        if constexpr (Int64)
+        {
+            if (fits_int64(num))
+            {
+                return call(to_int64(num));
+            }
+        }
+
+        if constexpr (Uint64)
+        {
+            if (fits_uint64(num))
+            {
+                return call(num.mantissa);
+            }
+        }
+
+        if constexpr (Double)
+        {
+            return call(to_double(num, view));
+        }
+    }
+
+    call(numeric_literal{view});
+}
+
+} // namespace detail
+
+// parser policies, they go after MaxDepth: parser<T, 63, unescape_strings>
+
+// the strings reach on_key/on_value/on_array already decoded (see unescape), the escape-free ones are passed as is;
+// parse_in_situ() decodes them right in the input buffer, otherwise they are decoded either into the buffer given away
+// by the derivee's char* unescape_buffer(size_t) or into the parser's own scratch buffer (valid till the next string)
+struct unescape_strings {};
+
+// the input is checked against RFC 8259 in the same pass: no trailing commas, no missing colons, no keys in arrays,
+// no single-quoted strings, no control characters or malformed escapes in strings, no ill-formed UTF-8, no leading
+// zeros, exactly one value per document; the first violation goes to on_error, the derivee must have one;
+// skip() is ignored, since a skipped value would not be validated
+struct validating {};
+
+// the nesting depth is not limited: the parser states go into a packed_stack, 2 bits per level, MaxDepth levels are
+// kept inline, the deeper ones spill into the heap; json_too_deep_to_parse is never reported
+struct dynamic_depth {};
+
+// the input is newline-delimited json: a malformed record is reported to on_error (error::record tells where the record
+// begins) and the rest of its line is dropped, the parsing goes on from the next line with a clean stack; a newline
+// inside of a record cuts it short, since the records never span lines; the validating parser takes every record for
+// a separate document; the callbacks made for the malformed record before the error are not taken back;
+// the derivee must have on_error, feed() is not supported
+struct recovering {};
+
+// tells the derivee which one of the keyset's keys has been met, see keyset
+template <const char* Key>
+struct known_key
+{
+    static constexpr const char* value = Key;
+};
+
+namespace detail
+{
+
+constexpr size_t key_length(const char* key) noexcept
+{
+    size_t len = 0;
+    while (key[len])
+    {
+        ++len;
+    }
+    return len;
+}
+
+// up to 8 bytes packed into a word, the first one in the lowest byte, zero-padded
+constexpr uint64_t pack_bytes(const char* str, size_t len) noexcept
+{
+    uint64_t word = 0;
+    for (size_t i = 0; i < len && i < 8; ++i)
+    {
+        word |= uint64_t(uint8_t(str[i])) << (8 * i);
+    }
+    return word;
+}
+
+// the hash input: the length, the first 8 bytes and the last 8 bytes of a key
+constexpr uint64_t key_signature(size_t len, uint64_t head, uint64_t tail) noexcept
+{
+    return (head + len) ^ (len > 8 ? (tail << 29) | (tail >> 35) : 0);
+}
+
+constexpr uint64_t splitmix(uint64_t x) noexcept
+{
+    x += 0x9e3779b97f4a7c15;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111eb;
+    return x ^ (x >> 31);
+}
+
+// the first 8 bytes of the string, a short string is loaded whole unless it sits at the very end of a page
+HAISU_NO_SANITIZE_ADDRESS inline uint64_t load_head(const char* str, size_t len) noexcept
+{
+    uint64_t word;
+    if (len >= 8 || (reinterpret_cast<uintptr_t>(str) & (simd::page_size - 1)) <= simd::page_size - 8)
+    {
+        std::memcpy(&word, str, 8);
+        return len >= 8 ? word : word & ((uint64_t(1) << (8 * len)) - 1);
+    }
+    return pack_bytes(str, len);
+}
+
+template <typename... Ts> struct find_keyset { using type = void; };
+
+} // namespace detail
+
+// A compile-time set of keys the parser matches itself: once a key is scanned, it is looked up in a perfect hash
+// table built at compile time and the derivee gets on_key(known_key<K>) instead of on_key(string_literal), i.e. an overload
+// per key rather than a chain of string comparisons, e.g.
+//     static constexpr char id[] = "id";
+//     static constexpr char ts[] = "ts";
+//     struct handler : parser<handler, 63, keyset<id, ts>>
+//     {
+//         void on_key(known_key<id>) { ... }
+//         void on_key(known_key<ts>) { ... }
+//         void on_key(string_literal) { ... } // the keys out of the set, optional
+//     };
+// a key in the set the derivee has no overload for goes to on_key(string_literal) as usual;
+// the table is indexed by a multiplicative hash of the length and the first and the last 8 bytes of the key,
+// a hit is confirmed with the length, the first 8 bytes and, for a longer key, a memcmp of the rest;
+// byte order is assumed little-endian
+template <const char*... Keys>
+struct keyset
+{
+    static constexpr size_t size = sizeof...(Keys);
+    static_assert(size > 0 && size < 0xffff, "keyset must have from 1 to 65534 keys");
+
+    // the index of the key in the set, size if the key is not there
+    static size_t find(string_view str) noexcept
+    {
+        const auto len = str.size();
+        if (len < min_length || len > max_length)
+        {
+            return size;
+        }
+
+        const auto head = detail::load_head(str.data(), len);
+        uint64_t tail = 0;
+        if (len > 8)
+        {
+            std::memcpy(&tail, str.data() + len - 8, 8);
+        }
+
+        const auto hash = (detail::key_signature(len, head, tail) * table_.multiplier) >> (64 - table_.bits);
+        for (auto i = table_.slots[hash]; i != none; i = table_.next[i])
+        {
+            if (lengths_[i] == len && heads_[i] == head
+                && (len <= 8 || std::memcmp(str.data() + 8, keys_[i] + 8, len - 8) == 0))
+            {
+                return i;
+            }
+        }
+        return size;
+    }
+
+    // calls f(known_key<K>{}) for the index-th key of the set, returns false if the index is out of the set
+    template <typename F>
+    static bool visit(size_t index, F&& f)
+    {
+        size_t i = 0;
+        return ((i++ == index && (f(known_key<Keys>{}), true)) || ...);
+    }
+
+private:
+    static constexpr uint16_t none = 0xffff;
+    static constexpr const char* keys_[] = {Keys...};
+    static constexpr size_t lengths_[] = {detail::key_length(Keys)...};
+    static constexpr uint64_t heads_[] = {detail::pack_bytes(Keys, detail::key_length(Keys))...};
+    static constexpr size_t min_length = std::min({detail::key_length(Keys)...});
+    static constexpr size_t max_length = std::max({detail::key_length(Keys)...});
+
+    static constexpr uint64_t signature(size_t i) noexcept
+    {
+        const auto len = lengths_[i];
+        return detail::key_signature(len, heads_[i], len > 8 ? detail::pack_bytes(keys_[i] + len - 8, 8) : 0);
+    }
+
+    // the keys with equal signatures share a slot, they are told apart by the full comparison
+    static constexpr bool collides(uint64_t multiplier, int bits) noexcept
+    {
+        for (size_t i = 0; i < size; ++i)
+        {
+            for (size_t j = 0; j < i; ++j)
+            {
+                if (signature(i) != signature(j)
+                    && (signature(i) * multiplier) >> (64 - bits) == (signature(j) * multiplier) >> (64 - bits))
+                {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    struct hash_params
+    {
+        uint64_t multiplier;
+        int bits;
+    };
+
+    // the smallest table (2 to 16 slots per key) and an odd multiplier that spread the keys with no collisions
+    static constexpr hash_params pick_hash() noexcept
+    {
+        int bits = 1;
+        while ((size_t(1) << bits) < 2 * size)
+        {
+            ++bits;
+        }
+
+        for (const auto last = bits + 3; bits <= last; ++bits)
+        {
+            for (uint64_t seed = 0; seed < 64; ++seed)
+            {
+                const auto multiplier = detail::splitmix(seed) | 1;
+                if (!collides(multiplier, bits))
+                {
+                    return {multiplier, bits};
+                }
+            }
+        }
+        return {0, 0};
+    }
+
+    static constexpr hash_params params_ = pick_hash();
+    static_assert(params_.bits > 0, "no perfect hash has been found for the keyset");
+
+    struct table
+    {
+        uint64_t multiplier = params_.multiplier;
+        int bits = params_.bits;
+        uint16_t slots[size_t(1) << params_.bits] = {};
+        uint16_t next[size] = {};
+    };
+
+    static constexpr table build_table() noexcept
+    {
+        table t{};
+        for (auto& slot : t.slots)
+        {
+            slot = none;
+        }
+
+        // the chains keep the order of the keys
+        for (size_t i = size; i-- > 0;)
+        {
+            auto& slot = t.slots[(signature(i) * t.multiplier) >> (64 - t.bits)];
+            t.next[i] = slot;
+            slot = uint16_t(i);
+        }
+        return t;
+    }
+
+    static constexpr table table_ = build_table();
+};
+
+namespace detail
+{
+
+template <const char*... Keys, typename... Ts>
+struct find_keyset<keyset<Keys...>, Ts...> { using type = keyset<Keys...>; };
+
+template <typename T, typename... Ts>
+struct find_keyset<T, Ts...> : find_keyset<Ts...> {};
+
+} // namespace detail
+
+// A minimalistic JSON parser with following characteristics
+//     1) makes no memory allocations (but it uses stack memory alright), except for feed() when a token is split between chunks
+//     2) builds no DOM
+//     3) the parser is quite close to SAX philosophy, it provides a stream of events instead of DOM
+//     3) provides very limited validation, unless asked to do the full one with the validating policy
+//     4) relies on a CRTP derivee to sort out how it wants to handle the json
+//     5) a derivee may terminate parser at any moment by calling terminate()
+//     6) the maximum depth of json being parsed is limited, unless the dynamic_depth policy lifts the limit
+//     7) does no string unescaping, relies on the derivee, unless asked to do so with the unescape_strings policy
+//     8) numbers are presented as strings, unless the derivee has typed callbacks: on_value(int64_t), on_value(uint64_t),
+//        on_value(double) and the same for on_array, then the number goes to the first of them it fits into
+//     9) same for unicode, let the derivee handle this
+//     10) the main focus of this parser is performance, it should be easily customizable when performance is at stake
+//        and some features may be left out (if I don't want doubles, why bother parsing them anyway?)
+//     11) keys are passed as strings, unless the keyset policy matches them into on_key(known_key<K>) overloads
+//     12) the parsing stops at the first error, unless the recovering policy skips over the malformed ndjson records
+template <typename T, int MaxDepth = 63, typename... Policies>
+class parser
+{
+    static_assert(MaxDepth > 0, "MaxDepth is not allowed to be zero");
+    enum parser_state : int8_t
+    {
+        state_object_key,
+        state_object_value,
+        state_array_item,
+        state_bad
+    };
+
+    // the tokens the validating parser lets through next
+    enum accept : uint8_t
     {
-        mask_ >>= 1;
-    }
+        accept_nothing = 0,
+        accept_value = 1,
+        accept_close = 2,
+        accept_comma = 4,
+        accept_colon = 8
+    };
 
-    template <bool Flag>
-    void push()
+    enum class input_mode
     {
-        mask_ <<= 1;
-        using tag = std::conditional_t<Flag, std::true_type, std::false_type>;
-        push_flag(tag());
-    }
+        null_terminated,
+        bounded,
+        chunked // same as bounded, but a token cut by the end of input is put aside till the next chunk
+    };
 
-    void push(bool flag) {
-        if (flag) {
-            push<true>();
-        } else {
-            push<false>();
-        }
-    }
+public:
+    static constexpr int max_depth = MaxDepth;
 
-    constexpr int capacity() const
-    {
-        return 63;
-    }
+    // one element on the stack is reserved
+    using stack_t = std::conditional_t<meta::one_of<dynamic_depth, Policies...>::value,
+        packed_stack<MaxDepth + 1>, static_stack<int8_t, MaxDepth + 1>>;
 
-    bool empty() const {
-        return mask_ == 1;
-    }
+    // the keys matched by the parser itself, void if there is no keyset among the policies
+    using keyset_t = typename detail::find_keyset<Policies...>::type;
 
-private:
-    void push_flag(std::true_type)
+    // the input string must be null-terminated
+    void parse(const char* json_string)
     {
-        bits_ |= mask_;
+        parse<input_mode::null_terminated>(json_string, nullptr);
     }
 
-    void push_flag(std::false_type)
+    // the input is [begin, end), no null-terminator is needed; the scanners load whole aligned blocks and 8-byte heads,
+    // so the bytes past the end may be read, but only within the same page, and they are masked off
+    void parse(const char* begin, const char* end)
     {
-        bits_ &= ~mask_;
+        parse<input_mode::bounded>(begin, end);
     }
 
-    uint64_t bits_ = 0;
-    uint64_t mask_ = 1;
-};
-
-template <int N>
-class nibblestack
-{
-public:
-    using size_type = meta::memory_requirement_t<N / 2>;
-
-    bool empty() const
+    void parse(string_view json)
     {
-        return size_ == 0;
+        parse<input_mode::bounded>(json.data(), json.data() + json.size());
     }
 
-    bool top() const
+    // same as parse(), but the escaped strings are decoded in place, the buffer gets overwritten
+    void parse_in_situ(char* json_string)
     {
-        assert(size_ > 0);
-        return bits_[size_ - 1] & mask_;
+        static_assert(unescapes(), "parse_in_situ() needs the unescape_strings policy");
+        in_situ_ = true;
+        parse<input_mode::null_terminated>(json_string, nullptr);
+        in_situ_ = false;
     }
 
-    template <bool Flag>
-    void push()
+    void parse_in_situ(char* begin, char* end)
     {
-        size_ += ((mask_ ^ 0xf0) + 1);
-        mask_ ^= 0xff;
-        
-        using tag = std::conditional_t<Flag, std::true_type, std::false_type>;
-        push_flag(tag());
+        static_assert(unescapes(), "parse_in_situ() needs the unescape_strings policy");
+        in_situ_ = true;
+        parse<input_mode::bounded>(begin, end);
+        in_situ_ = false;
     }
 
-    void pop()
+    // push-style parsing, the document comes in pieces, the parser keeps its state in between the calls
+    // a token split between two chunks is copied aside, that is the only time the parser allocates memory
+    // an error position may point either into the chunk or into the copy of a split token
+    void feed(const char* begin, const char* end)
     {
-        size_ -= ((mask_ ^ 0x0f) + 1);
-        mask_ ^= 0xff;
-    }
+        static_assert(!recovers(), "feed() does not support the recovering policy");
 
-private:
-    static_assert(0 == N % 2, "");
+        if (!streaming_)
+        {
+            begin_document();
+            streaming_ = true;
+            stopped_ = false;
+        }
 
-    void push_flag(std::true_type)
-    {
-        bits_[size_ - 1] |= (mask_ & 0xff);
-    }
+        if (stopped_)
+        {
+            return;
+        }
 
-    void push_flag(std::false_type)
-    {
-        bits_[size_ - 1] &= (mask_ ^ 0xff);
-    }
+        if (!carry_.empty())
+        {
+            begin = complete_token(begin, end);
+            if (begin == end && !token_complete_)
+            {
+                return;
+            }
 
-    size_type size_ = 0;
-    uint8_t mask_ = 0xf0;
-    uint8_t bits_[N / 2];
-};
+            feed_ = carry_.data();
+            end_ = feed_ + carry_.size();
+            stopped_ = !run<input_mode::bounded>() || end_ == eof_;
+            carry_.clear();
 
-template <int N>
-class objstack
-{
-public:
-    void push_array() noexcept
-    {
-        stack_.template push<true>();
+            if (stopped_)
+            {
+                return;
+            }
+        }
+
+        feed_ = begin;
+        end_ = end;
+        token_ = nullptr;
+        stopped_ = !run<input_mode::chunked>() || end_ == eof_;
+
+        if (!stopped_ && token_)
+        {
+            carry_.assign(token_, end);
+        }
     }
 
-    void push_object() noexcept
+    void feed(string_view chunk)
     {
-        stack_.template push<false>();
+        feed(chunk.data(), chunk.data() + chunk.size());
     }
 
-    bool is_object_on_top() const noexcept
+    // the document is over, whatever is left of it gets parsed
+    void finish()
     {
-        return !stack_.top();    
+        if (!streaming_)
+        {
+            begin_document();
+        }
+
+        if (!stopped_ && !carry_.empty())
+        {
+            feed_ = carry_.data();
+            end_ = feed_ + carry_.size();
+            stopped_ = !run<input_mode::bounded>() || end_ == eof_;
+        }
+
+        if (!stopped_)
+        {
+            end_of_document();
+        }
+
+        carry_.clear();
+        streaming_ = false;
     }
 
-    bool is_array_on_top() const noexcept
+    // the documents (the records for the recovering parser) reported to on_error since the parser was created
+    size_t malformed_records() const noexcept
     {
-        return stack_.top();
+        return malformed_;
     }
 
-    void pop() noexcept
+protected:
+    void terminate()
     {
-        stack_.pop();
+        feed_ = end_ = eof_;
     }
 
-    bool empty() const noexcept
+    // skips the value being started without any callbacks, must be called either from on_key (the value of the key
+    // is skipped altogether) or from on_new_object/on_new_array (the contents are skipped, but the closing
+    // on_object_end/on_array_end still comes); the parser cannot skip the input coming through feed(), nor can
+    // the validating one skip anything, false is returned then and the callbacks keep coming
+    bool skip()
     {
-        return stack_.empty();
+        skip_ = !validates() && !streaming_;
+        return skip_;
     }
 
 private:
-    boolstack<N> stack_;
-};
-
-template <int N>
-class compressed_objstack
-{
-public:
-    void push_array()
+    template <input_mode Mode>
+    void parse(const char* json_string, const char* json_end)
     {
-        if (is_array_on_top())
+        begin_document();
+        feed_ = begin_ = record_ = json_string;
+        end_ = json_end;
+
+        auto parsed = run<Mode>();
+        if constexpr (recovers())
         {
-            assert(stack_[size_] != 0x7f);
-            ++stack_[size_];
+            while (!parsed && resync<Mode>())
+            {
+                parsed = run<Mode>();
+            }
         }
-        else
+
+        if (parsed && feed_ != eof_) // a terminated document is not an incomplete one
         {
-            assert(size_ < N);
-            ++size_;
-            stack_[size_] = 0x01;
+            end_of_document();
         }
     }
 
-    void push_object()
+    // the recovering parser only: drops the rest of the line the error has happened on, returns false if there is
+    // no next line or the parser has been terminated
+    template <input_mode Mode>
+    bool resync()
     {
-        if (is_object_on_top())
+        if (feed_ == eof_)
         {
-            assert(stack_[size_] != 0xff);
-            ++stack_[size_];
+            return false;
+        }
+
+        const char* newline;
+        if constexpr (Mode == input_mode::null_terminated)
+        {
+            newline = std::strchr(feed_, '\n');
         }
         else
         {
-            assert(size_ < N);
-            ++size_;
-            stack_[size_] = 0x81;
+            newline = feed_ < end_ ? static_cast<const char*>(std::memchr(feed_, '\n', end_ - feed_)) : nullptr;
         }
-    }
 
-    void pop()
-    {
-        assert(size_ >= 0);    
-        stack_[size_] -= 1;
-        if (!(stack_[size_] & 0x7f))
+        if (!newline)
         {
-            --size_;
+            return false;
         }
-    }
 
-    bool is_object_on_top() const
-    {
-        return stack_[size_] & 0x80;
+        begin_document();
+        feed_ = record_ = newline + 1;
+        return true;
     }
 
-    bool is_array_on_top() const
+    // the beginning of the line the position is on
+    const char* line_start(const char* pos) const noexcept
     {
-        return !is_object_on_top();
+        while (pos > begin_ && pos[-1] != '\n')
+        {
+            --pos;
+        }
+        return pos;
     }
-    
-
-private:
-    int size_ = -1;
-    uint8_t stack_[N];    
-};
-
-enum class error_code
-{
-    json_too_deep_to_parse, // if you get this error, consider increasing the MaxDepth parameter in the parser
-    malformed_json, 
-    unexpected_character,
-    unspecified_error
-};
-
-using string_view = std::string_view;
 
-struct string_literal
-{
-    string_view view;
-};
-
-struct null_literal 
-{
-};
-
-struct bool_literal 
-{
-    bool value;
-};
-
-struct numeric_literal 
-{ 
-    string_view view; 
-};
+    void begin_document()
+    {
+        static_assert(!validates() || has_error_handler(), "the validating policy needs on_error");
+        static_assert(!recovers() || has_error_handler(), "the recovering policy needs on_error");
 
-struct error 
-{ 
-    const char* position; 
-    error_code err; 
-};
+        expect_ = accept_value;
+        skip_ = false;
+        carry_.clear();
+        streaming_ = false;
+        stack_.clear();
+        stack_.push(static_cast<int8_t>(state_bad));
+    }
 
-// A minimalistic JSON parser with following characteristics
-//     1) makes no memory allocations (but it uses stack memory alright)
-//     2) builds no DOM
-//     3) the parser is quite close to SAX philosophy, it provides a stream of events instead of DOM
-//     3) provides very limited validation
-//     4) relies on a CRTP derivee to sort out how it wants to handle the json
-//     5) a derivee may terminate parser at any moment by calling terminate()
-//     6) the maximum depth of json being parsed is limited
-//     7) does no string unescaping, relies on the derivee
-//     8) does not parse numbers, numbers are presented as strings, passes that to the derivee
-//     9) same for unicode, let the derivee handle this
-//     10) the main focus of this parser is performance, it should be easily customizable when performance is at stake
-//        and some features may be left out (if I don't want doubles, why bother parsing them anyway?)
-template <typename T, int MaxDepth = 63>
-class parser
-{
-    static_assert(MaxDepth > 0, "MaxDepth is not allowed to be zero");
-    enum parser_state : int8_t
+    void end_of_document()
     {
-        state_object_key,
-        state_object_value,
-        state_array_item,
-        state_bad
-    };
-
-public:
-    using stack_t = static_stack<int8_t, MaxDepth + 1>; // one element on the stack is reserved
+        if constexpr (has_error_handler())
+        {
+            if (stack_.size() != 1 || stack_.top() != state_bad)
+            {
+                call_on_error(feed_);
+            }
+            else if (validates() && !recovers() && expect_ != accept_nothing) // an empty document
+            {
+                call_on_error({feed_, error_code::malformed_json});
+            }
+        }
+    }
 
-    // the input string must be null-terminated
-    void parse(const char* json_string)
+    // parses the input up to the end, returns false if an error was reported
+    template <input_mode Mode>
+    bool run()
     {
-        parser_state state = state_bad;
+        constexpr bool bounded = Mode != input_mode::null_terminated;
+        constexpr bool chunked = Mode == input_mode::chunked;
+        auto state = static_cast<parser_state>(stack_.top());
 
         const auto transit = [&](auto new_state) {
+            if constexpr (recovers())
+            {
+                if (state == state_bad) // a new record
+                {
+                    record_ = feed_;
+                }
+            }
             state = new_state;
             stack_.push(static_cast<int8_t>(new_state));
         };
 
         const auto transform = [&](auto new_state) {
             state = new_state;
-            stack_.top() = static_cast<int8_t>(new_state);
+            stack_.replace_top(static_cast<int8_t>(new_state));
         };
 
         const auto restore_previous_state = [&] {
@@ -591,9 +2814,16 @@ public:
             state = static_cast<parser_state>(stack_.top());
         };
 
-        stack_.clear();
-        feed_ = json_string;
-        transit(state_bad);
+        // the validating parser only: whatever is started here must be a value, not a key
+        const auto value_allowed = [&] {
+            return (expect_ & accept_value) && state != state_object_key;
+        };
+
+        // the validating parser only: a key or a value is over, the state tells what it was
+        const auto value_parsed = [&] {
+            expect_ = state == state_object_value ? accept_colon
+                : state == state_bad ? (recovers() ? accept_value : accept_nothing) : accept_comma | accept_close;
+        };
 
         auto& s = feed_;
 
@@ -612,21 +2842,75 @@ public:
         };
 #endif
 
+#if HAISU_JSON_SIMD
+        // the loop goes from one token to another, see simd::structural_index
+        // the parser with no error handler does not look at the commas and the colons, they are not indexed then
+        constexpr unsigned flags = (has_error_handler() ? simd::index_punctuation : 0) | (recovers() ? simd::index_newlines : 0)
+            | (validates() ? simd::index_string_stops : 0);
+        simd::block_indexer<bounded, flags> indexer(end_);
+        simd::structural_index<bounded, flags> index(indexer, s);
+        s = index.next(s);
+#endif
+
         while (true)
         {
 #ifdef DEBUG_JSON_PARSER
             auto prev_state = state;
             auto ch = s[0];
 #endif
+
+            if constexpr (bounded)
+            {
+                if (s >= end_)
+                {
+                    goto stop_parsing;
+                }
+            }
             
             switch (*s)
             {
+                case '\n':
+                    if constexpr (recovers())
+                    {
+                        if (state != state_bad) // a record cut short
+                        {
+                            return call_on_error({s, error_code::malformed_json});
+                        }
+                    }
+                    [[fallthrough]];
                 case ' ':
                 case '\r':
-                case '\n':
                 case '\t':
+                    if constexpr (recovers())
+                    {
+                        if (state != state_bad) // a run of blanks is not skipped over inside of a record, a newline may be there
+                        {
+                            break;
+                        }
+                    }
+
+                    if constexpr (bounded)
+                    {
+                        if (s + 1 < end_ && is_blank(s[1])) // a run of blanks, most likely an indentation
+                        {
+                            s = skip_blanks(s + 1, end_) - 1;
+                        }
+                    }
+                    else if (is_blank(s[1]))
+                    {
+                        s = skip_blanks(s + 1) - 1;
+                    }
                     break;
                 case '{': // new object
+                    if constexpr (validates())
+                    {
+                        if (!value_allowed())
+                        {
+                            return call_on_error({s, error_code::unexpected_character});
+                        }
+                        expect_ = accept_value | accept_close;
+                    }
+
                     switch (state) {
                         case state_object_value:
                             transform(state_object_key);
@@ -647,8 +2931,25 @@ public:
                             break;
                     }
                     call_on_new_object();
+                    if constexpr (!chunked)
+                    {
+                        if (skip_)
+                        {
+                            skip_ = false;
+                            s = (bounded ? skip_container(s + 1, end_) : skip_container(s + 1)) - 1;
+                        }
+                    }
                     break;
                 case '[': // new array
+                    if constexpr (validates())
+                    {
+                        if (!value_allowed())
+                        {
+                            return call_on_error({s, error_code::unexpected_character});
+                        }
+                        expect_ = accept_value | accept_close;
+                    }
+
                     switch (state) {
                         case state_object_value:
                             transform(state_array_item);
@@ -668,9 +2969,28 @@ public:
                             break;
                     }
                     call_on_new_array();
+                    if constexpr (!chunked)
+                    {
+                        if (skip_)
+                        {
+                            skip_ = false;
+                            s = (bounded ? skip_container(s + 1, end_) : skip_container(s + 1)) - 1;
+                        }
+                    }
                     break;
                 case '}': // object end
-                    if constexpr (!has_error_handler()) // assume no errors possible
+                    if constexpr (validates())
+                    {
+                        if (!(expect_ & accept_close) || state != state_object_key)
+                        {
+                            return call_on_error({s, error_code::malformed_json});
+                        }
+                        call_on_object_end();
+                        restore_previous_state();
+                        value_parsed();
+                        break;
+                    }
+                    else if constexpr (!has_error_handler()) // assume no errors possible
                     {
                         call_on_object_end();
                         restore_previous_state();
@@ -690,7 +3010,18 @@ public:
                         }
                     }
                 case ']': // array end
-                    if constexpr (!has_error_handler()) // assume no errors possible
+                    if constexpr (validates())
+                    {
+                        if (!(expect_ & accept_close) || state != state_array_item)
+                        {
+                            return call_on_error({s, error_code::malformed_json});
+                        }
+                        call_on_array_end();
+                        restore_previous_state();
+                        value_parsed();
+                        break;
+                    }
+                    else if constexpr (!has_error_handler()) // assume no errors possible
                     {
                         call_on_array_end();
                         restore_previous_state();
@@ -710,25 +3041,113 @@ public:
                         }
                     }
                 case ',':
-                    if constexpr (has_error_handler())
+                case ':':
+                    if (!punctuation(*s))
                     {
-                        if (stack_.size() <= 1)
-                        {
-                            return call_on_error({s, error_code::malformed_json});
-                        }
+                        return call_on_error({s, error_code::malformed_json});
                     }
-
-                    break;
-                case ':':
                     break;
+                case '\'':
                 case '"': // object key, or array item
                     {
-                        const auto k = ++s;
-                        s = skip_to_end_of_string<'"'>(k);
+                        if constexpr (validates())
+                        {
+                            if (*s != '"' || !(expect_ & accept_value))
+                            {
+                                return call_on_error({s, error_code::unexpected_character});
+                            }
+                        }
+
+                        const auto k = s + 1;
+                        [[maybe_unused]] const char* escape = nullptr;
+                        if constexpr (validates())
+                        {
+#if HAISU_JSON_SIMD
+                            s = index.plain_string_end(k); // most strings have nothing to validate
+                            if (!s)
+                            {
+                                s = validate_string<bounded>(k, end_, escape);
+                                index.skip_string_end();
+                            }
+#else
+                            s = validate_string<bounded>(k, end_, escape);
+#endif
+                            escape = escape ? escape : s;
+                        }
+                        else if constexpr (bounded && unescapes())
+                        {
+                            s = *s == '"' ? find_string_end<'"'>(k, end_, escape) : find_string_end<'\''>(k, end_, escape);
+#if HAISU_JSON_SIMD
+                            index.skip_string_end();
+#endif
+                        }
+                        else if constexpr (bounded)
+                        {
+#if HAISU_JSON_SIMD
+                            s = *s == '"' ? index.string_end(k) : skip_to_end_of_string<'\''>(k, end_);
+#else
+                            s = *s == '"' ? skip_to_end_of_string<'"'>(k, end_) : skip_to_end_of_string<'\''>(k, end_);
+#endif
+                        }
+                        else if constexpr (unescapes())
+                        {
+                            s = *s == '"' ? find_string_end<'"'>(k, escape) : find_string_end<'\''>(k, escape);
+#if HAISU_JSON_SIMD
+                            index.skip_string_end();
+#endif
+                        }
+                        else
+                        {
+#if HAISU_JSON_SIMD
+                            s = *s == '"' ? index.string_end(k) : skip_to_end_of_string<'\''>(k);
+#else
+                            s = *s == '"' ? skip_to_end_of_string<'"'>(k) : skip_to_end_of_string<'\''>(k);
+#endif
+                        }
+
+                        if (chunked && s == end_)
+                        {
+                            token_ = k - 1;
+                            goto stop_parsing;
+                        }
+
+                        if constexpr (validates())
+                        {
+                            if (bounded ? s >= end_ : !*s)
+                            {
+                                return call_on_error({s, error_code::malformed_json}); // an unterminated string
+                            }
+                            else if (*s != '"')
+                            {
+                                const auto code = uint8_t(*s) < 0x80 ? error_code::unexpected_character : error_code::invalid_utf8;
+                                return call_on_error({s, code});
+                            }
+                        }
+
+                        auto str = k;
+                        auto str_end = s;
+                        if constexpr (unescapes())
+                        {
+                            if (escape != s)
+                            {
+                                std::tie(str, str_end) = unescape_string(k, escape, s);
+                            }
+                        }
+
                         switch (state)
                         {
                             case state_object_key:
-                                call_on_key(k, s);
+                                call_on_key(str, str_end);
+
+                                if constexpr (!chunked)
+                                {
+                                    if (skip_ && (bounded ? s < end_ : *s))
+                                    {
+                                        skip_ = false;
+                                        s = (bounded ? skip_value(s + 1, end_) : skip_value(s + 1)) - 1;
+                                        break;
+                                    }
+                                }
 
                                 if constexpr (has_error_handler())
                                 {
@@ -741,22 +3160,42 @@ public:
                                 transit(state_object_value);
                                 break;
                             case state_object_value:
-                                call_on_value(k, s);
+                                call_on_value(str, str_end);
                                 restore_previous_state();
                                 break;
                             case state_array_item:
-                                call_on_array(k, s);
+                                call_on_array(str, str_end);
                                 break;
                             default:
                                 break;
                         }
-                        if (!*s) {
+
+                        if constexpr (validates())
+                        {
+                            value_parsed();
+                        }
+
+                        if (bounded ? s >= end_ : !*s) {
                             goto stop_parsing;
                         }
                     }
                     break;
                 case 'n': // null
-                    if (s[1] == 'u' && s[2] == 'l' && s[3] == 'l' && is_separator(s[4]))
+                    if (chunked && end_ - s < 5) // the literal and a separator
+                    {
+                        token_ = s;
+                        goto stop_parsing;
+                    }
+
+                    if constexpr (validates())
+                    {
+                        if (!value_allowed())
+                        {
+                            return call_on_error({s, error_code::unexpected_character});
+                        }
+                    }
+
+                    if (is_literal<Mode>(s, "null"))
                     {
                         switch (state)
                         {
@@ -771,6 +3210,10 @@ public:
                                 break;
                                                 
                         }
+                        if constexpr (validates())
+                        {
+                            value_parsed();
+                        }
                         s += 3;
                         break;
                     }
@@ -779,7 +3222,21 @@ public:
                         return call_on_error({s, error_code::unexpected_character});
                     }
                 case 't': // true
-                    if (s[1] == 'r' && s[2] == 'u' && s[3] == 'e' && is_separator(s[4]))
+                    if (chunked && end_ - s < 5) // the literal and a separator
+                    {
+                        token_ = s;
+                        goto stop_parsing;
+                    }
+
+                    if constexpr (validates())
+                    {
+                        if (!value_allowed())
+                        {
+                            return call_on_error({s, error_code::unexpected_character});
+                        }
+                    }
+
+                    if (is_literal<Mode>(s, "true"))
                     {
                         switch (state)
                         {
@@ -793,6 +3250,10 @@ public:
                             default:
                                 break;
                         }
+                        if constexpr (validates())
+                        {
+                            value_parsed();
+                        }
                         s += 3;
                         break;
                     }
@@ -801,7 +3262,21 @@ public:
                         return call_on_error({s, error_code::unexpected_character});
                     }
                 case 'f': // false
-                    if (s[1] == 'a' && s[2] == 'l' && s[3] == 's' && s[4] == 'e' && is_separator(s[5]))
+                    if (chunked && end_ - s < 6) // the literal and a separator
+                    {
+                        token_ = s;
+                        goto stop_parsing;
+                    }
+
+                    if constexpr (validates())
+                    {
+                        if (!value_allowed())
+                        {
+                            return call_on_error({s, error_code::unexpected_character});
+                        }
+                    }
+
+                    if (is_literal<Mode>(s, "false"))
                     {
                         switch (state)
                         {
@@ -814,6 +3289,10 @@ public:
                             default:
                                 break;
                         }
+                        if constexpr (validates())
+                        {
+                            value_parsed();
+                        }
                         s += 4;
                         break;
                     }
@@ -833,25 +3312,41 @@ public:
                 case '9':
                 case '-':
                     {
+                        if constexpr (validates())
+                        {
+                            if (!value_allowed())
+                            {
+                                return call_on_error({s, error_code::unexpected_character});
+                            }
+                        }
+
                         const auto k = s;
-                        do
+                        detail::decimal num;
+                        s = detail::scan_number<has_number_handler(), bounded>(s, end_, num);
+
+                        if (chunked && s == end_)
                         {
-                            ++s;
+                            token_ = k;
+                            goto stop_parsing;
                         }
-                        while ((*s >= '0' && *s <= '9') || *s == '.' || *s =='e');
 
                         if constexpr (has_error_handler())
                         {
-                            if (!is_separator(*s))
+                            if (!num.valid || (bounded ? s < end_ && !is_separator(*s) : *s && !is_separator(*s)))
                             {
                                 return call_on_error({s, error_code::unexpected_character});
                             }
                         }
 
-                        // TODO: extract function
-                        const auto literal_ptr = k;
-                        const auto literal_size = size_t(s - k);
-                        auto literal = numeric_literal{string_view{literal_ptr, literal_size}};
+                        if constexpr (validates())
+                        {
+                            const auto digits = k + (*k == '-');
+                            if (*digits == '0' && digits + 1 < s && detail::is_digit(digits[1])) // a leading zero
+                            {
+                                return call_on_error({digits, error_code::unexpected_character});
+                            }
+                        }
+
                         switch (state)
                         {
 //                        TODO: do we allow numeric keys?
@@ -860,21 +3355,34 @@ public:
 //                            break;
 //
                             case state_object_value:
-                                call_on_value(literal);
+                                call_on_number_value(k, s, num);
                                 restore_previous_state();
                                 break;
                             case state_array_item:
-                                call_on_array(literal);
+                                call_on_number_array(k, s, num);
                                 break;
                             default:
                                 break;
                         }
+
+                        if constexpr (validates())
+                        {
+                            value_parsed();
+                        }
                         --s;
                     }
 
                     break;
                 case 0:
-                    goto stop_parsing;
+                    if constexpr (bounded && has_error_handler()) // a stray null-terminator inside of the buffer
+                    {
+                        return call_on_error({s, error_code::unexpected_character});
+                    }
+                    else if constexpr (!bounded)
+                    {
+                        goto stop_parsing;
+                    }
+                    break;
                 default:
                     if constexpr (has_error_handler())
                     {
@@ -886,30 +3394,134 @@ public:
             std::cout << ch << " : " << state_str(prev_state) << " --> " << state_str(state) << " : " << (int)stack_.size()  << std::endl;
 #endif
 
+#if HAISU_JSON_SIMD
+            if constexpr (has_error_handler())
+            {
+                // a comma or a colon right after a token is not indexed (see simd::index_punctuation), it is taken
+                // on the way to the next token
+                if ((!bounded || s + 1 < end_) && (s[1] == ',' || s[1] == ':') && !punctuation(*++s))
+                {
+                    return call_on_error({s, error_code::malformed_json});
+                }
+            }
+            s = end_ != eof_ ? index.next(s + 1) : s + 1; // terminate() has moved the parser out of the input
+#else
             ++s;
+#endif
         }
 
 stop_parsing:
-        if constexpr (has_error_handler())
+        return true;
+    }
+
+    // appends the beginning of a chunk to the token put aside, returns the position right after the token
+    const char* complete_token(const char* begin, const char* end)
+    {
+        const auto first = carry_.front();
+        auto pos = begin;
+
+        if (first == '"' || first == '\'')
         {
-            if (stack_.size() != 1 || stack_.top() != state_bad)
+            bool escaped = false;
+            for (auto it = carry_.begin() + 1; it != carry_.end(); ++it)
+            {
+                escaped = !escaped && *it == '\\';
+            }
+
+            if (escaped && pos != end)
+            {
+                ++pos;
+            }
+
+            pos = first == '"' ? skip_to_end_of_string<'"'>(pos, end) : skip_to_end_of_string<'\''>(pos, end);
+            token_complete_ = pos != end;
+            pos += token_complete_ ? 1 : 0;
+        }
+        else
+        {
+            // either a number or a literal, both end with a separator
+            while (pos != end && !is_separator(*pos) && *pos != '{' && *pos != '[' && *pos != ':' && *pos != '"')
             {
-                call_on_error(s);
+                ++pos;
             }
+            token_complete_ = pos != end;
         }
+
+        carry_.append(begin, pos);
+        return pos;
     }
 
-protected:
-    void terminate()
+    // the string has at least one escape sequence, the decoded string goes either in place of the original one or into
+    // a separate buffer, the input is left intact then
+    std::pair<const char*, const char*> unescape_string(const char* begin, const char* escape, const char* end)
     {
-        feed_ = "";
+        if (in_situ_)
+        {
+            auto out = const_cast<char*>(escape); // parse_in_situ() was given a mutable buffer
+            return {begin, unescape(escape, end, out)};
+        }
+
+        const auto prefix = size_t(escape - begin);
+        auto buf = call_unescape_buffer(*static_cast<T*>(this), size_t(end - begin), 0);
+        std::memcpy(buf, begin, prefix);
+        return {buf, unescape(escape, end, buf + prefix)};
+    }
+
+    // a literal must be followed by a separator (or by the end of input, the terminating null included)
+    template <input_mode Mode, size_t N>
+    bool is_literal(const char* s, const char (&literal)[N]) const noexcept
+    {
+        constexpr size_t len = N - 1;
+        if constexpr (Mode != input_mode::null_terminated)
+        {
+            if (size_t(end_ - s) < len)
+            {
+                return false;
+            }
+        }
+
+        for (size_t i = 1; i < len; ++i)
+        {
+            if (s[i] != literal[i])
+            {
+                return false;
+            }
+        }
+
+        if constexpr (Mode != input_mode::null_terminated)
+        {
+            return s + len == end_ || is_separator(s[len]);
+        }
+        else
+        {
+            return !s[len] || is_separator(s[len]);
+        }
     }
 
-private:
     void call_on_key(const char* str, const char* end)
     {
+        auto& t = *static_cast<T*>(this);
         const auto view = string_view(str, end - str);
-        call_key(*static_cast<T*>(this), string_literal{view}, 0);
+        if constexpr (!std::is_void_v<keyset_t>)
+        {
+            const auto found = keyset_t::visit(keyset_t::find(view), [&t, view](auto k)
+            {
+                if constexpr (is_valid_expression<T>([](auto&& o) -> decltype(o.on_key(decltype(k){})) {}))
+                {
+                    t.on_key(k);
+                }
+                else
+                {
+                    call_key(t, string_literal{view}, 0);
+                }
+            });
+
+            if (found)
+            {
+                return;
+            }
+        }
+        call_key(t, string_literal{view}, 0);
     }
 
     void call_on_value(const char* str, const char* end)
@@ -936,15 +3548,20 @@ private:
         call_array(*static_cast<T*>(this), bool_literal{B}, 0);
     }
 
-    void call_on_value(numeric_literal lit)
+    void call_on_number_value(const char* str, const char* end, const detail::decimal& num)
     {
-        call_value(*static_cast<T*>(this), lit, 0);
+        auto& t = *static_cast<T*>(this);
+        detail::deliver_number<has_value_handler<int64_t>(), has_value_handler<uint64_t>(), has_value_handler<double>()>(
+            string_view(str, end - str), num, [&t](auto val) { call_value(t, val, 0); });
     }
 
-    void call_on_array(numeric_literal lit)
+    void call_on_number_array(const char* str, const char* end, const detail::decimal& num)
     {
-        call_array(*static_cast<T*>(this), lit, 0);
+        auto& t = *static_cast<T*>(this);
+        detail::deliver_number<has_array_handler<int64_t>(), has_array_handler<uint64_t>(), has_array_handler<double>()>(
+            string_view(str, end - str), num, [&t](auto val) { call_array(t, val, 0); });
     }
+
     
     void call_on_null_value()
     {
@@ -976,14 +3593,42 @@ private:
         call_array_end(*static_cast<T*>(this), 0);
     }
 
-    void call_on_error(const char* pos)
+    bool call_on_error(const char* pos)
+    {
+        return call_on_error(error{pos, error_code::unspecified_error});
+    }
+
+    // a comma or a colon, false if it is not allowed where it is
+    bool punctuation(char ch) noexcept
     {
-        call_on_error(error{pos, error_code::unspecified_error});
+        if constexpr (validates())
+        {
+            if (!(expect_ & (ch == ',' ? accept_comma : accept_colon)))
+            {
+                return false;
+            }
+            expect_ = accept_value;
+        }
+        else if constexpr (has_error_handler())
+        {
+            if (ch == ',' && stack_.size() <= 1)
+            {
+                return false;
+            }
+        }
+        return true;
     }
 
-    void call_on_error(error err)
+    bool call_on_error(error err)
     {
+        if constexpr (recovers())
+        {
+            err.record = stack_.size() > 1 ? record_ : line_start(err.position);
+        }
+
+        ++malformed_;
         call_error(*static_cast<T*>(this), err, 0);
+        return false;
     }
 
     static constexpr bool has_error_handler() noexcept
@@ -991,6 +3636,51 @@ private:
         return is_valid_expression<T>([](auto&& o) -> decltype(o.on_error(error{})) {});
     }
 
+    static constexpr bool unescapes() noexcept
+    {
+        return meta::one_of<unescape_strings, Policies...>::value;
+    }
+
+    static constexpr bool validates() noexcept
+    {
+        return meta::one_of<validating, Policies...>::value;
+    }
+
+    static constexpr bool recovers() noexcept
+    {
+        return meta::one_of<recovering, Policies...>::value;
+    }
+
+    // a catch-all template handler would swallow anything, it keeps getting numeric_literal
+    static constexpr bool has_generic_value_handler() noexcept
+    {
+        return is_valid_expression<T>([](auto&& o) -> decltype(o.on_value(detail::not_a_number{})) {});
+    }
+
+    static constexpr bool has_generic_array_handler() noexcept
+    {
+        return is_valid_expression<T>([](auto&& o) -> decltype(o.on_array(detail::not_a_number{})) {});
+    }
+
+    template <typename U>
+    static constexpr bool has_value_handler() noexcept
+    {
+        return !has_generic_value_handler() && is_valid_expression<T>([](auto&& o) -> decltype(o.on_value(detail::exactly<U>{})) {});
+    }
+
+    template <typename U>
+    static constexpr bool has_array_handler() noexcept
+    {
+        return !has_generic_array_handler() && is_valid_expression<T>([](auto&& o) -> decltype(o.on_array(detail::exactly<U>{})) {});
+    }
+
+    // the numbers are converted on the fly if the derivee wants them typed
+    static constexpr bool has_number_handler() noexcept
+    {
+        return has_value_handler<int64_t>() || has_value_handler<uint64_t>() || has_value_handler<double>()
+            || has_array_handler<int64_t>() || has_array_handler<uint64_t>() || has_array_handler<double>();
+    }
+
     template <typename U, typename Literal>
     static auto call_key(U& t, Literal&& lit, int) -> decltype(t.on_key(std::forward<Literal>(lit)), void())
     {
@@ -1055,6 +3745,22 @@ private:
 
     template <typename U> static void call_array_end(U&, long) {}
 
+    template <typename U>
+    static auto call_unescape_buffer(U& t, size_t size, int) -> decltype(static_cast<char*>(t.unescape_buffer(size)))
+    {
+        return t.unescape_buffer(size);
+    }
+
+    template <typename U>
+    char* call_unescape_buffer(U&, size_t size, long)
+    {
+        if (scratch_.size() < size)
+        {
+            scratch_.resize(size);
+        }
+        return &scratch_[0];
+    }
+
     template <typename U, typename Error>
     static auto call_error(U& t, Error&& err, int) -> decltype(t.on_error(std::forward<Error>(err)), void())
     {
@@ -1064,8 +3770,29 @@ private:
     template <typename U, typename Error> static void call_error(U&, Error&&, long) {}
 
 
+    static constexpr char eof_[8] = {}; // terminate() points the parser here, it is safe to look a few bytes ahead
+
     stack_t stack_; // one element on the stack is reserved
     const char* feed_;
+    const char* end_;
+    const char* begin_ = nullptr; // the input given to parse()
+    const char* record_ = nullptr; // the recovering parser only: the top-level value being parsed
+    size_t malformed_ = 0;
+
+    // streaming
+    const char* token_ = nullptr; // a token cut by the end of the chunk
+    std::string carry_; // the beginning of a token which did not fit into the previous chunk
+    bool token_complete_ = false;
+    bool streaming_ = false;
+    bool stopped_ = false;
+
+    bool skip_ = false; // see skip()
+
+    uint8_t expect_ = accept_value; // the validating parser only: the tokens allowed next, a combination of accept flags
+
+    // string unescaping
+    std::string scratch_; // the decoded strings go here unless the derivee has its own buffer
+    bool in_situ_ = false;
 };
 
 } // namespace json
@@ -27,16 +27,54 @@ For more information, please refer to <http://unlicense.org/>
 
 #pragma once
 #include "haisu/json.h"
+#include "haisu/memory.h"
 #include "haisu/zbuf.h"
 #include "haisu/trivial_variant.h"
 
+#include <cerrno>
 #include <variant>
 
+#include <fcntl.h>
+#include <unistd.h>
+
 namespace haisu
 {
 namespace json
 {
 
+// FNV-1a, good enough for the keys, can be computed at compile time
+constexpr uint64_t key_hash(const char* str, size_t len) noexcept
+{
+    uint64_t ret = 14695981039346656037ull;
+    for (size_t i = 0; i < len; ++i)
+    {
+        ret = (ret ^ uint8_t(str[i])) * 1099511628211ull;
+    }
+    return ret;
+}
+
+// a key with its hash computed in advance, a constexpr one costs nothing at run time:
+//     static constexpr json::key user_id{"user_id"};
+//     model.child(user_id);
+struct key
+{
+    template <size_t N>
+    constexpr key(const char (&str)[N]) noexcept
+        : view(str, N - 1)
+        , hash(key_hash(str, N - 1))
+    {
+    }
+
+    constexpr explicit key(string_view str) noexcept
+        : view(str)
+        , hash(key_hash(str.data(), str.size()))
+    {
+    }
+
+    string_view view;
+    uint64_t hash;
+};
+
 namespace detail
 {
 
@@ -48,14 +86,41 @@ struct list_node
 struct object : list_node
 {
     string_literal key;
+    size_t index; // the first key of a large object knows where its key index is, the offset is one-based
+};
+
+// an open addressing hash table of the keys of a single object, goes into a separate buffer:
+// the header is followed by the slots, an empty slot has zero offset
+struct key_index_header
+{
+    uint64_t mask; // the number of the slots minus one, the number is a power of two
+};
+
+struct key_index_slot
+{
+    uint64_t hash;
+    size_t offset; // the key offset plus one
+};
+
+// an object having no keys, the other objects are their first keys
+struct empty_object
+{
 };
 
+// the array is a chain of the nodes: the head, then a link after every item, the link knows where its item begins
 struct array : list_node
 {
-    size_t next;
+    size_t items; // the head of the array knows where its item table is, the offset is one-based
+    size_t item; // the offset of the item, the links only
+};
+
+// the offsets of the array items, one after another, goes into the same buffer as the key indices
+struct item_table_header
+{
+    uint64_t count;
 };
 
-using jsonval = haisu::trivial_variant<object, array, string_literal, null_literal, numeric_literal>;
+using jsonval = haisu::trivial_variant<object, array, string_literal, null_literal, numeric_literal, bool_literal, empty_object>;
 
 // cant' use std::variant because it is not trivially copyable
 
@@ -169,61 +234,91 @@ const array* jsonval::get_if<array>() const noexcept
     return type == type_array ? &get<array>() : nullptr;
 }*/
 
+// the snapshot of a model (see model::write) is the header followed by the nodes, the key indices/item tables and
+// the strings; the nodes are written as they are, except for the string views, they hold the offsets of the strings
+// relative to the string section; the snapshot is only good for the same build of the library on the same platform
+struct snapshot_header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t node_size; // sizeof(jsonval), a different build may have a different one
+    uint64_t nodes; // the sizes of the sections in bytes
+    uint64_t index;
+    uint64_t strings;
+};
+
+constexpr char snapshot_magic[8] = {'h', 'a', 'i', 's', 'u', 'j', 's', 'n'};
+constexpr uint32_t snapshot_version = 2;
+
+// the memory a model_view looks at, either the buffers of a model or a snapshot of them
+struct model_memory
+{
+    const char* nodes;
+    size_t size; // of the nodes, in bytes
+    const char* index; // the key indices and the item tables, if any
+    const char* strings; // a snapshot keeps the strings apart, the string views hold the offsets relative to it then
+};
+
+inline const char* memory_of(const zbuf& buffer) noexcept
+{
+    return buffer.empty() ? nullptr : buffer.ptr(0);
+}
+
 class model_view
 {
 public:
     model_view(const zbuf& buffer, size_t offset)
-        : buffer_(buffer)
+        : mem_{memory_of(buffer), buffer.size(), nullptr, nullptr}
         , offset_(offset)
     {
     }
 
     explicit model_view(const zbuf& buffer)
-        : buffer_(buffer)
-        , offset_(buffer.size())
+        : model_view(buffer, buffer.size())
+    {
+    }
+
+    // the large objects are looked up through the key index, if there is one
+    model_view(const zbuf& buffer, size_t offset, const zbuf* index)
+        : mem_{memory_of(buffer), buffer.size(), index ? memory_of(*index) : nullptr, nullptr}
+        , offset_(offset)
+    {
+    }
+
+    model_view(const model_memory& mem, size_t offset)
+        : mem_(mem)
+        , offset_(offset)
     {
     }
 
     bool has_key(const char* key) const noexcept
     {
-        if (is_object())
-        {
-            auto offset = offset_;
-            do
-            {
-                const auto o = get_object(offset);
-                if (!o->key.view.compare(key))
-                {
-                    return true;
-                }
-                offset = o->next;
-            }
-            while (offset);
-        }
-        return false;
+        return has_key(string_view(key));
+    }
+
+    bool has_key(string_view key) const noexcept
+    {
+        return find(key) != npos;
+    }
+
+    bool has_key(const json::key& key) const noexcept
+    {
+        return find(key.view, key.hash) != npos;
     }
 
     model_view child(const char* key) const noexcept
     {
-        if (is_object())
-        {
-            auto offset = offset_;
-            do
-            {
-                const auto o = get_object(offset);
-                if (!o->key.view.compare(key))
-                {
-                    auto child_offset = offset + sizeof(jsonval);
-                    if (get_object(child_offset))
-                    {
-                        return model_view{buffer_, offset + sizeof(jsonval)};
-                    }
-                }
-                offset = o->next;
-            }
-            while (offset);
-        }
-        return model_view{buffer_};
+        return child_at(find(string_view(key)));
+    }
+
+    model_view child(string_view key) const noexcept
+    {
+        return child_at(find(key));
+    }
+
+    model_view child(const json::key& key) const noexcept
+    {
+        return child_at(find(key.view, key.hash));
     }
 
     auto count() const noexcept
@@ -236,15 +331,15 @@ public:
     auto count_array() const noexcept
     {
         auto ret = size_t{};
-        if (is_array())
+        if (const auto table = item_table())
         {
-            auto off = offset_;
-            auto a = get<array>(off);
-            while (a->next)
+            ret = at<item_table_header>(mem_.index, table - 1).count;
+        }
+        else if (is_array())
+        {
+            for (auto a = get<array>(offset_); a->next; a = get<array>(a->next))
             {
                 ++ret;
-                off = a->next;
-                a = get<array>(off);
             }
         }
 
@@ -254,12 +349,12 @@ public:
     template <typename F>
     void foreach_child(F&& f) const noexcept
     {
-        if (is_object())
+        if (has_keys())
         {
             auto offset = offset_;
             do
             {
-                f(model_view{buffer_, offset});
+                f(model_view{mem_, offset});
                 const auto o = get_object(offset);
                 offset = o->next;
             }
@@ -269,17 +364,17 @@ public:
 
     bool empty() const noexcept
     {
-        return buffer_.size() <= offset_;
+        return mem_.size <= offset_;
     }
 
     bool is_object() const noexcept
     {
-        return !empty() && get_object(offset_);
+        return has_keys() || (!empty() && get_if<empty_object>(offset_));
     }
 
     bool is_literal() const noexcept
     {
-        return !empty() && !get_object(offset_);
+        return !empty() && !is_object();
     }
 
     bool is_string() const noexcept
@@ -292,24 +387,271 @@ public:
         return !empty() && get_if<array>(offset_);
     }
 
+    bool is_number() const noexcept
+    {
+        return !empty() && get_if<numeric_literal>(offset_);
+    }
+
+    bool is_null() const noexcept
+    {
+        return !empty() && get_if<null_literal>(offset_);
+    }
+
+    bool is_bool() const noexcept
+    {
+        return !empty() && get_if<bool_literal>(offset_);
+    }
+
+    // false if this is not a boolean
+    bool as_bool() const noexcept
+    {
+        return is_bool() && get<bool_literal>(offset_)->value;
+    }
+
+    // the text of a string or a number, empty otherwise
+    string_view literal() const noexcept
+    {
+        if (is_string())
+        {
+            return text(get<string_literal>(offset_)->view);
+        }
+        else if (is_number())
+        {
+            return text(get<numeric_literal>(offset_)->view);
+        }
+        return string_view{};
+    }
+
+    // the number converted, zero if this is not a number (or the integer does not fit)
+    double as_double() const noexcept
+    {
+        detail::decimal num;
+        const auto view = scan(num);
+        return num.valid ? detail::to_double(num, view) : 0.0;
+    }
+
+    int64_t as_int64() const noexcept
+    {
+        detail::decimal num;
+        scan(num);
+        return num.valid && detail::fits_int64(num) ? detail::to_int64(num) : 0;
+    }
+
+    // an array item, either through the item table or by walking the array
+    model_view operator[](size_t i) const noexcept
+    {
+        if (const auto table = item_table())
+        {
+            if (i < at<item_table_header>(mem_.index, table - 1).count)
+            {
+                return model_view{mem_, item_at(table, i)};
+            }
+        }
+        else if (is_array())
+        {
+            for (auto a = get<array>(offset_); a->next; )
+            {
+                a = get<array>(a->next);
+                if (!i--)
+                {
+                    return model_view{mem_, a->item};
+                }
+            }
+        }
+        return model_view{mem_, mem_.size};
+    }
+
+    // goes over the array items in order
+    class item_iterator
+    {
+    public:
+        item_iterator(const model_view& array, size_t i) noexcept
+            : array_(&array)
+            , i_(i)
+        {
+        }
+
+        model_view operator*() const noexcept
+        {
+            return (*array_)[i_];
+        }
+
+        item_iterator& operator++() noexcept
+        {
+            ++i_;
+            return *this;
+        }
+
+        bool operator==(const item_iterator& other) const noexcept
+        {
+            return i_ == other.i_;
+        }
+
+        bool operator!=(const item_iterator& other) const noexcept
+        {
+            return i_ != other.i_;
+        }
+
+    private:
+        const model_view* array_;
+        size_t i_;
+    };
+
+    // for (auto item : view) ..., an object or a literal has no items
+    item_iterator begin() const noexcept
+    {
+        return item_iterator{*this, 0};
+    }
+
+    item_iterator end() const noexcept
+    {
+        return item_iterator{*this, count_array()};
+    }
+
 private:
+    // the one-based offset of the item table of the array, zero if there is none
+    size_t item_table() const noexcept
+    {
+        if (mem_.index && is_array())
+        {
+            return get<array>(offset_)->items;
+        }
+        return 0;
+    }
+
+    size_t item_at(size_t table, size_t i) const noexcept
+    {
+        return at<size_t>(mem_.index, table - 1 + sizeof(item_table_header) + i * sizeof(size_t));
+    }
+
+    string_view scan(detail::decimal& num) const noexcept
+    {
+        const auto view = is_number() ? text(get<numeric_literal>(offset_)->view) : string_view{};
+        const auto end = view.data() + view.size();
+        num.valid = !view.empty() && detail::scan_number<true, true>(view.data(), end, num) == end;
+        return view;
+    }
+
+    static constexpr size_t npos = std::numeric_limits<size_t>::max();
+
+    // the offset of the key, npos if there is no such key
+    size_t find(string_view key) const noexcept
+    {
+        if (const auto index = key_index())
+        {
+            return find_indexed(key, key_hash(key.data(), key.size()), index);
+        }
+        return find_linear(key);
+    }
+
+    size_t find(string_view key, uint64_t hash) const noexcept
+    {
+        if (const auto index = key_index())
+        {
+            return find_indexed(key, hash, index);
+        }
+        return find_linear(key);
+    }
+
+    size_t find_linear(string_view key) const noexcept
+    {
+        if (has_keys())
+        {
+            auto offset = offset_;
+            do
+            {
+                const auto o = get_object(offset);
+                if (text(o->key.view) == key)
+                {
+                    return offset;
+                }
+                offset = o->next;
+            }
+            while (offset);
+        }
+        return npos;
+    }
+
+    size_t find_indexed(string_view key, uint64_t hash, size_t index) const noexcept
+    {
+        const auto mask = at<key_index_header>(mem_.index, index - 1).mask;
+        const auto slots = index - 1 + sizeof(key_index_header);
+        for (auto i = hash & mask; ; i = (i + 1) & mask)
+        {
+            const auto& slot = at<key_index_slot>(mem_.index, slots + i * sizeof(key_index_slot));
+            if (!slot.offset)
+            {
+                return npos;
+            }
+
+            if (slot.hash == hash && text(get_object(slot.offset - 1)->key.view) == key)
+            {
+                return slot.offset - 1;
+            }
+        }
+    }
+
+    // the one-based offset of the key index of the object, zero if there is none
+    size_t key_index() const noexcept
+    {
+        if (mem_.index && has_keys())
+        {
+            return get_object(offset_)->index;
+        }
+        return 0;
+    }
+
+    // the value goes right after its key
+    model_view child_at(size_t offset) const noexcept
+    {
+        if (offset != npos)
+        {
+            auto child_offset = offset + sizeof(jsonval);
+            if (child_offset < mem_.size)
+            {
+                return model_view{mem_, child_offset};
+            }
+        }
+        return model_view{mem_, mem_.size};
+    }
+
     const object* get_object(size_t offset) const noexcept
     {
         return get_if<object>(offset);
     }
 
+    // an object is its first key, unless it is empty
+    bool has_keys() const noexcept
+    {
+        return !empty() && get_object(offset_);
+    }
+
     template <typename T>
     const T* get_if(size_t offset) const noexcept
     {
-        auto& v = buffer_.at_offset<jsonval>(offset);
-        return v.get_if<T>();
+        return at<jsonval>(mem_.nodes, offset).get_if<T>();
     }
 
     template <typename T>
     const T* get(size_t offset) const noexcept
     {
-        auto& v = buffer_.at_offset<jsonval>(offset);
-        return &v.get<T>();
+        return &at<jsonval>(mem_.nodes, offset).get<T>();
+    }
+
+    template <typename T>
+    static const T& at(const char* mem, size_t offset) noexcept
+    {
+        return *reinterpret_cast<const T*>(mem + offset);
+    }
+
+    // the string a node refers to
+    string_view text(string_view view) const noexcept
+    {
+        if (mem_.strings)
+        {
+            return string_view(mem_.strings + reinterpret_cast<uintptr_t>(view.data()), view.size());
+        }
+        return view;
     }
     
     const object* get_root() const noexcept
@@ -317,7 +659,7 @@ private:
         return get_object(offset_);
     }
 
-    const zbuf& buffer_;
+    model_memory mem_;
     size_t offset_{};
 };
 } // namespace detail
@@ -334,19 +676,31 @@ class model : private parser<model>
     constexpr static size_t npos = std::numeric_limits<size_t>::max();
 
 public:
-    bool has_key(const char* key) const noexcept
+    // the objects having at least that many keys get a key index
+    static constexpr size_t default_index_threshold = 16;
+
+    model() = default;
+
+    explicit model(size_t index_threshold)
+        : index_threshold_(index_threshold)
     {
-        return model_view{buf_, 0}.has_key(key);
     }
 
-    model_view child(const char* key) const noexcept
+    template <typename Key>
+    bool has_key(const Key& key) const noexcept
+    {
+        return root().has_key(key);
+    }
+
+    template <typename Key>
+    model_view child(const Key& key) const noexcept
     {
-        return model_view{buf_, 0}.child(key);
+        return root().child(key);
     }
 
     model_view root() const noexcept
     {
-        return model_view{buf_, 0};
+        return model_view{buf_, 0, &index_};
     }
 
     void parse(const char* json_string)
@@ -355,12 +709,60 @@ public:
         parser_type::parse(json_string);
     }
 
+    // writes a self-contained snapshot of the model, model_snapshot looks at it with no parsing,
+    // returns false if the write fails
+    bool write(int fd) const
+    {
+        std::vector<char> nodes(buf_.size());
+        if (!buf_.empty())
+        {
+            std::memcpy(nodes.data(), buf_.ptr(0), buf_.size());
+        }
+
+        std::string strings;
+        const auto relocate = [&strings](string_view& view) {
+            const auto offset = strings.size();
+            strings.append(view.data(), view.size());
+            view = string_view(reinterpret_cast<const char*>(uintptr_t(offset)), view.size());
+        };
+
+        for (size_t offset = 0; offset < nodes.size(); offset += sizeof(jsonval))
+        {
+            auto& node = *reinterpret_cast<jsonval*>(&nodes[offset]);
+            if (auto o = node.get_if<object>())
+            {
+                relocate(o->key.view);
+            }
+            else if (auto str = node.get_if<string_literal>())
+            {
+                relocate(str->view);
+            }
+            else if (auto num = node.get_if<numeric_literal>())
+            {
+                relocate(num->view);
+            }
+        }
+
+        detail::snapshot_header header{};
+        std::memcpy(header.magic, detail::snapshot_magic, sizeof(header.magic));
+        header.version = detail::snapshot_version;
+        header.node_size = sizeof(jsonval);
+        header.nodes = nodes.size();
+        header.index = index_.size();
+        header.strings = strings.size();
+
+        return write_all(fd, &header, sizeof(header))
+            && write_all(fd, nodes.data(), nodes.size())
+            && write_all(fd, detail::memory_of(index_), index_.size())
+            && write_all(fd, strings.data(), strings.size());
+    }
+
 private:
     void on_key(string_literal lit)
     {
         const auto offset = buf_.size();
-        append_buf(object{0, lit});
-        assert(offset + sizeof(jsonval) == buf_.size()); // in case zbuf changes and starts aligning data which would be a disaster
+        append_buf(object{0, lit, 0});
+        assert(offset + sizeof(jsonval) == buf_.size()); // zbuf::append packs the nodes back to back, it never pads
         assert(!stack_.empty()); // if this fires, then there is something wrong with the parser
 
         const auto prev_offset = stack_.top();
@@ -369,49 +771,216 @@ private:
             const auto prev_obj = &buf_.at_offset<jsonval>(prev_offset).get<object>();
             prev_obj->next = offset; 
         }
+        else
+        {
+            first_.top() = offset;
+        }
         stack_.top() = offset;
     }
 
+    // every value goes right after its key, so that child() finds it there
     void on_value(string_literal lit)
     {
         append_buf(lit);
     }
 
+    void on_value(numeric_literal lit)
+    {
+        append_buf(lit);
+    }
+
+    void on_value(null_literal lit)
+    {
+        append_buf(lit);
+    }
+
+    void on_value(bool_literal lit)
+    {
+        append_buf(lit);
+    }
+
     void on_new_object()
     {
         stack_.push(npos);
+        first_.push(npos);
     }
 
     void on_object_end()
     {
+        auto start = first_.top();
+        if (start != npos)
+        {
+            build_key_index(start);
+        }
+        else
+        {
+            start = buf_.size();
+            append_buf(detail::empty_object{});
+        }
+
         stack_.pop();
+        first_.pop();
+        link_container(start);
     }
 
     void on_new_array()
     {
         const auto offset = buf_.size();
-        append_buf(array{0});
+        append_buf(array{0, 0, 0});
         stack_.push(offset);
+        first_.push(offset);
    }
 
     void on_array(string_literal lit)
     {
-        append_buf(lit);
+        append_item(lit);
+    }
+
+    void on_array(numeric_literal lit)
+    {
+        append_item(lit);
+    }
 
-        const auto prev = stack_.top();
-        
-        const auto arr = &buf_.at_offset<jsonval>(prev).get<array>();
+    void on_array(null_literal lit)
+    {
+        append_item(lit);
+    }
 
+    void on_array(bool_literal lit)
+    {
+        append_item(lit);
+    }
+
+    template <typename Literal>
+    void append_item(Literal lit)
+    {
+        const auto item = buf_.size();
+        append_buf(lit);
+        append_link(item);
+    }
+
+    // the item is in place, the link after it goes to the chain of the array
+    void append_link(size_t item)
+    {
         const auto offset = buf_.size();
-        arr->next = buf_.size();
+        buf_.at_offset<jsonval>(stack_.top()).get<array>().next = offset;
 
-        append_buf(array{0});
+        append_buf(array{0, 0, item});
         stack_.top() = offset;
     }
 
+    // a container nested into an array is an item of it too
+    void link_container(size_t start)
+    {
+        if (!stack_.empty() && stack_.top() != npos && buf_.at_offset<jsonval>(stack_.top()).get_if<array>())
+        {
+            append_link(start);
+        }
+    }
+
     void on_array_end()
     {
+        const auto head = first_.top();
+        build_item_table(head);
         stack_.pop();
+        first_.pop();
+        link_container(head);
+    }
+
+    // the array is done, the item offsets go to a contiguous table
+    void build_item_table(size_t head)
+    {
+        const auto table = index_.append_aligned(detail::item_table_header{0});
+
+        uint64_t count = 0;
+        for (auto next = buf_.at_offset<jsonval>(head).get<array>().next; next; ++count)
+        {
+            const auto& link = buf_.at_offset<jsonval>(next).get<array>();
+            index_.append(link.item);
+            next = link.next;
+        }
+
+        index_.at_offset<detail::item_table_header>(table).count = count;
+        buf_.at_offset<jsonval>(head).get<array>().items = table + 1;
+    }
+
+    void build_key_index(size_t first)
+    {
+        size_t count = 0;
+        for (auto offset = first; ; offset = key_at(offset).next)
+        {
+            ++count;
+            if (!key_at(offset).next)
+            {
+                break;
+            }
+        }
+
+        if (count < index_threshold_)
+        {
+            return;
+        }
+
+        auto slots = size_t{1};
+        while (slots < count * 2) // the load factor is at most one half
+        {
+            slots *= 2;
+        }
+
+        const auto index = index_.append_aligned(detail::key_index_header{slots - 1});
+        for (size_t i = 0; i < slots; ++i)
+        {
+            index_.append(detail::key_index_slot{0, 0});
+        }
+
+        const auto slot_at = [this, index](size_t i) -> detail::key_index_slot& {
+            return index_.at_offset<detail::key_index_slot>(index + sizeof(detail::key_index_header) + i * sizeof(detail::key_index_slot));
+        };
+
+        for (auto offset = first; ; offset = key_at(offset).next)
+        {
+            const auto& key = key_at(offset).key.view;
+            const auto hash = key_hash(key.data(), key.size());
+
+            auto i = hash & (slots - 1);
+            while (slot_at(i).offset)
+            {
+                i = (i + 1) & (slots - 1);
+            }
+            slot_at(i) = detail::key_index_slot{hash, offset + 1};
+
+            if (!key_at(offset).next)
+            {
+                break;
+            }
+        }
+
+        key_at(first).index = index + 1;
+    }
+
+    object& key_at(size_t offset)
+    {
+        return buf_.at_offset<jsonval>(offset).get<object>();
+    }
+
+    static bool write_all(int fd, const void* data, size_t size)
+    {
+        auto ptr = static_cast<const char*>(data);
+        while (size)
+        {
+            const auto written = ::write(fd, ptr, size);
+            if (written < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            else if (written <= 0)
+            {
+                return false;
+            }
+            ptr += written;
+            size -= size_t(written);
+        }
+        return true;
     }
 
     template <typename T>
@@ -422,8 +991,95 @@ private:
 
     friend class parser<model>;
 
-    static_stack<size_t, 64> stack_; // TODO: synchronize with the underlaying json
+    // the parser never goes deeper than its max_depth
+    static_stack<size_t, parser_type::max_depth + 1> stack_;
+    static_stack<size_t, parser_type::max_depth + 1> first_; // the first key of every object being parsed (npos if none yet), the head of every array
     haisu::zbuf buf_;
+    haisu::zbuf index_; // the key indices of the large objects and the item tables of the arrays
+    size_t index_threshold_ = default_index_threshold;
+};
+
+// a model written by model::write(), looked at right where it is: mapped from a file, or sitting in memory;
+// nothing is parsed or copied, the loading costs as much as the page faults do
+class model_snapshot
+{
+    using model_view = detail::model_view;
+
+public:
+    // maps the file, returns false if it cannot be mapped or it is not a snapshot of this version
+    bool open(const char* path)
+    {
+        const int fd = ::open(path, O_RDONLY);
+        if (fd < 0)
+        {
+            return false;
+        }
+
+        const bool ret = open(fd);
+        ::close(fd);
+        return ret;
+    }
+
+    bool open(int fd)
+    {
+        close();
+        return map_.map_file(fd) && assign(map_.get(), map_.size());
+    }
+
+    // the snapshot is in memory already, the memory must outlive the model_snapshot and be 8-byte aligned
+    bool assign(const void* data, size_t size)
+    {
+        mem_ = detail::model_memory{nullptr, 0, nullptr, nullptr};
+
+        detail::snapshot_header header;
+        if (size < sizeof(header))
+        {
+            return false;
+        }
+
+        std::memcpy(&header, data, sizeof(header));
+        if (std::memcmp(header.magic, detail::snapshot_magic, sizeof(header.magic))
+            || header.version != detail::snapshot_version
+            || header.node_size != sizeof(detail::jsonval)
+            || sizeof(header) + header.nodes + header.index + header.strings != size)
+        {
+            return false;
+        }
+
+        const auto nodes = static_cast<const char*>(data) + sizeof(header);
+        mem_ = detail::model_memory{nodes, size_t(header.nodes), nodes + header.nodes, nodes + header.nodes + header.index};
+        return true;
+    }
+
+    void close()
+    {
+        mem_ = detail::model_memory{nullptr, 0, nullptr, nullptr};
+        if (map_.size())
+        {
+            map_.destroy();
+        }
+    }
+
+    template <typename Key>
+    bool has_key(const Key& key) const noexcept
+    {
+        return root().has_key(key);
+    }
+
+    template <typename Key>
+    model_view child(const Key& key) const noexcept
+    {
+        return root().child(key);
+    }
+
+    model_view root() const noexcept
+    {
+        return model_view{mem_, 0};
+    }
+
+private:
+    memap map_;
+    detail::model_memory mem_{nullptr, 0, nullptr, nullptr};
 };
 
 } // namespace json
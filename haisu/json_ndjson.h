@@ -0,0 +1,199 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org/>
+*/
+
+// clang-format off
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "haisu/json.h"
+
+namespace haisu
+{
+namespace json
+{
+
+// calls f(string_view) for every line of the buffer unless the line is blank
+// a newline always ends the record: json strings cannot have raw newlines inside, so a record with an unbalanced
+// quote does not swallow the ones after it (the recovering parser sees the lines the same way)
+template <typename F>
+void for_each_record(const char* begin, const char* end, F&& f)
+{
+    const auto emit = [&](const char* first, const char* last) {
+        if (skip_blanks(first, last) != last)
+        {
+            f(string_view(first, last - first));
+        }
+    };
+
+    if (begin >= end)
+    {
+        return;
+    }
+
+    auto record = begin;
+    while (auto newline = static_cast<const char*>(memchr(record, '\n', end - record)))
+    {
+        emit(record, newline);
+        record = newline + 1;
+    }
+
+    emit(record, end);
+}
+
+inline std::vector<string_view> split_records(string_view buffer)
+{
+    std::vector<string_view> ret;
+    for_each_record(buffer.data(), buffer.data() + buffer.size(), [&ret](string_view record) {
+        ret.push_back(record);
+    });
+    return ret;
+}
+
+namespace detail
+{
+
+// every worker owns a range of items, once it runs out of work it starts stealing from the others
+class work_ranges
+{
+public:
+    work_ranges(size_t items, size_t workers, size_t batch)
+        : ranges_(workers)
+        , batch_(batch)
+    {
+        assert(workers > 0 && batch > 0);
+
+        const auto share = items / workers;
+        const auto extra = items % workers;
+        auto first = size_t{};
+        for (size_t i = 0; i < workers; ++i)
+        {
+            const auto last = first + share + (i < extra ? 1 : 0);
+            ranges_[i].next.store(first, std::memory_order_relaxed);
+            ranges_[i].end = last;
+            first = last;
+        }
+    }
+
+    // hands out the next batch [first, last), returns false when there is nothing left
+    bool pop(size_t worker, size_t& first, size_t& last) noexcept
+    {
+        const auto workers = ranges_.size();
+        for (size_t i = 0; i < workers; ++i)
+        {
+            auto& range = ranges_[(worker + i) % workers];
+            if (range.next.load(std::memory_order_relaxed) >= range.end)
+            {
+                continue;
+            }
+
+            const auto pos = range.next.fetch_add(batch_, std::memory_order_relaxed);
+            if (pos < range.end)
+            {
+                first = pos;
+                last = std::min(pos + batch_, range.end);
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    struct alignas(64) range
+    {
+        std::atomic<size_t> next{};
+        size_t end{};
+    };
+
+    std::vector<range> ranges_;
+    size_t batch_;
+};
+
+} // namespace detail
+
+// parses a buffer of newline-delimited json documents on several threads
+// T is a parser<T> derivee, every thread gets its own instance, which are then returned to the caller for merging
+// shards = 0 means one shard per hardware thread
+// the buffer is handed out in chunks of bytes, there is no splitting ahead: a chunk takes the records starting in it,
+// the last one of them may end past the chunk
+template <typename T>
+std::vector<T> parse_records(string_view buffer, size_t shards = 0, size_t chunk = 64 * 1024)
+{
+    if (!shards)
+    {
+        shards = std::max(1u, std::thread::hardware_concurrency());
+    }
+    shards = std::max<size_t>(1, std::min(shards, (buffer.size() + chunk - 1) / chunk));
+
+    std::vector<T> handlers(shards);
+    detail::work_ranges work(buffer.size(), shards, chunk);
+
+    const auto begin = buffer.data();
+    const auto end = begin + buffer.size();
+    const auto next_line = [end](const char* ptr) {
+        const auto newline = static_cast<const char*>(memchr(ptr, '\n', end - ptr));
+        return newline ? newline + 1 : end;
+    };
+
+    const auto worker = [&](size_t id) {
+        auto& handler = handlers[id];
+        size_t first = 0;
+        size_t last = 0;
+        while (work.pop(id, first, last))
+        {
+            // a record starts right after a newline
+            const auto from = first ? next_line(begin + first - 1) : begin;
+            if (from < begin + last)
+            {
+                const auto to = next_line(begin + last - 1);
+                for_each_record(from, to, [&handler](string_view record) { handler.parse(record); });
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(shards - 1);
+    for (size_t i = 1; i < shards; ++i)
+    {
+        threads.emplace_back(worker, i);
+    }
+
+    worker(0);
+
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+
+    return handlers;
+}
+
+} // namespace json
+} // namespace haisu
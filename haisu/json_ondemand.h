@@ -0,0 +1,301 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org/>
+*/
+
+// clang-format off
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include "haisu/json.h"
+
+namespace haisu
+{
+namespace json
+{
+
+// A forward-only cursor over a json buffer: nothing is parsed until asked for, and whatever is not asked for
+// is skipped without a look inside (see skip_value, the containers are skipped block by block), e.g.
+//     ondemand_cursor doc{request};
+//     auto user = doc.find_field("user");
+//     const auto id = user.find_field("id").get_int64();
+//     const auto name = user.find_field("name").get_raw_string();
+// An object cursor keeps its place: the next find_field goes on from the member the previous one has found, so
+// the fields read in the order they are written take a single pass over the object, while a field which is
+// behind the cursor is not found anymore; the same goes for next_item() and the arrays.
+// A missing field, an item past the end, a value of some other type: the cursor is empty, a getter returns
+// a zero, nothing is ever thrown. The input must outlive the cursor, it does not have to be null-terminated.
+class ondemand_cursor
+{
+public:
+    ondemand_cursor() = default;
+
+    explicit ondemand_cursor(string_view json) noexcept
+        : ondemand_cursor(json.data(), json.data() + json.size())
+    {
+    }
+
+    explicit ondemand_cursor(const char* json_string) noexcept
+        : ondemand_cursor(json_string, json_string + std::strlen(json_string))
+    {
+    }
+
+    ondemand_cursor(const char* begin, const char* end) noexcept
+        : value_(skip_blanks(begin, end))
+        , end_(end)
+    {
+        if (value_ == end_)
+        {
+            value_ = nullptr;
+        }
+    }
+
+    // the value of the key, looked up among the members of the object which are after the cursor
+    ondemand_cursor find_field(string_view key) noexcept
+    {
+        for (auto s = next_member('{'); s; s = next_member('{'))
+        {
+            const char* escape;
+            const auto key_end = *s == '"' ? find_string_end<'"'>(s + 1, end_, escape)
+                : find_string_end<'\''>(s + 1, end_, escape);
+            auto value = key_end != end_ ? skip_blanks(key_end + 1, end_) : end_;
+            if (value == end_ || *value != ':' || (value = skip_blanks(value + 1, end_)) == end_)
+            {
+                next_ = end_; // malformed, nothing is found from now on
+                return {};
+            }
+
+            next_ = value;
+            skip_pending_ = true;
+            if (decoded_equals(s + 1, key_end, escape, key))
+            {
+                return {value, end_};
+            }
+        }
+        return {};
+    }
+
+    ondemand_cursor operator[](string_view key) noexcept
+    {
+        return find_field(key);
+    }
+
+    // the next item of the array, an empty cursor past the last one
+    ondemand_cursor next_item() noexcept
+    {
+        const auto s = next_member('[');
+        if (!s)
+        {
+            return {};
+        }
+
+        next_ = s;
+        skip_pending_ = true;
+        return {s, end_};
+    }
+
+    // the item of the array, counted from the very first one, the cursor is left where it is
+    ondemand_cursor at(size_t index) const noexcept
+    {
+        if (!value_)
+        {
+            return {};
+        }
+
+        ondemand_cursor items{value_, end_};
+        auto item = items.next_item();
+        while (index-- && !item.empty())
+        {
+            item = items.next_item();
+        }
+        return item;
+    }
+
+    bool empty() const noexcept
+    {
+        return !value_;
+    }
+
+    bool is_object() const noexcept
+    {
+        return value_ && *value_ == '{';
+    }
+
+    bool is_array() const noexcept
+    {
+        return value_ && *value_ == '[';
+    }
+
+    bool is_string() const noexcept
+    {
+        return value_ && (*value_ == '"' || *value_ == '\'');
+    }
+
+    bool is_number() const noexcept
+    {
+        return value_ && (*value_ == '-' || detail::is_digit(*value_));
+    }
+
+    bool is_bool() const noexcept
+    {
+        return is_literal("true") || is_literal("false");
+    }
+
+    bool is_null() const noexcept
+    {
+        return is_literal("null");
+    }
+
+    int64_t get_int64() const noexcept
+    {
+        detail::decimal num;
+        return scan(num) && detail::fits_int64(num) ? detail::to_int64(num) : 0;
+    }
+
+    uint64_t get_uint64() const noexcept
+    {
+        detail::decimal num;
+        return scan(num) && detail::fits_uint64(num) ? num.mantissa : 0;
+    }
+
+    double get_double() const noexcept
+    {
+        detail::decimal num;
+        const auto last = scan(num);
+        return last ? detail::to_double(num, string_view(value_, last - value_)) : 0.0;
+    }
+
+    bool get_bool() const noexcept
+    {
+        return is_literal("true");
+    }
+
+    // the string as it is in the input, the escape sequences are not decoded
+    string_view get_raw_string() const noexcept
+    {
+        const char* escape;
+        const auto last = string_end(escape);
+        return last ? string_view(value_ + 1, last - value_ - 1) : string_view{};
+    }
+
+    // the decoded string
+    std::string get_string() const
+    {
+        const char* escape;
+        const auto last = string_end(escape);
+        if (!last)
+        {
+            return {};
+        }
+
+        std::string ret(value_ + 1, last);
+        if (escape != last)
+        {
+            ret.resize(unescape(&ret[0], &ret[0] + ret.size(), &ret[0]) - &ret[0]);
+        }
+        return ret;
+    }
+
+    // the whole value as it is in the input
+    string_view raw() const noexcept
+    {
+        return value_ ? string_view(value_, skip_value(value_, end_) - value_) : string_view{};
+    }
+
+private:
+    // the next member of the object or item of the array, the container is entered on the first call,
+    // the value found by the previous call is skipped; nullptr at the end of the container
+    const char* next_member(char open) noexcept
+    {
+        auto s = next_;
+        if (!s)
+        {
+            if (!value_ || *value_ != open)
+            {
+                return nullptr;
+            }
+            s = value_ + 1;
+        }
+        else if (skip_pending_)
+        {
+            s = skip_value(s, end_);
+        }
+
+        skip_pending_ = false;
+        s = skip_blanks(s, end_);
+        if (s != end_ && *s == ',')
+        {
+            s = skip_blanks(s + 1, end_);
+        }
+
+        next_ = s;
+        if (s == end_ || *s == '}' || *s == ']')
+        {
+            return nullptr;
+        }
+        return open == '[' || *s == '"' || *s == '\'' ? s : nullptr;
+    }
+
+    bool is_literal(string_view lit) const noexcept
+    {
+        return value_ && size_t(end_ - value_) >= lit.size() && std::memcmp(value_, lit.data(), lit.size()) == 0
+            && (size_t(end_ - value_) == lit.size() || !is_scalar_char(value_[lit.size()]));
+    }
+
+    // the end of the number, nullptr if the value is not a well-formed number
+    const char* scan(detail::decimal& num) const noexcept
+    {
+        if (!is_number())
+        {
+            return nullptr;
+        }
+
+        const auto last = detail::scan_number<true, true>(value_, end_, num);
+        return num.valid && (last == end_ || !is_scalar_char(*last)) ? last : nullptr;
+    }
+
+    // the closing quote, nullptr if the value is not a string or the string is not closed
+    const char* string_end(const char*& escape) const noexcept
+    {
+        if (!is_string())
+        {
+            return nullptr;
+        }
+
+        const auto last = *value_ == '"' ? find_string_end<'"'>(value_ + 1, end_, escape)
+            : find_string_end<'\''>(value_ + 1, end_, escape);
+        return last != end_ ? last : nullptr;
+    }
+
+    const char* value_ = nullptr; // the first character of the value, nullptr if there is no value
+    const char* end_ = nullptr;
+    const char* next_ = nullptr; // the container only: where the next member/item is looked for
+    bool skip_pending_ = false; // next_ is at the value found last, it is yet to be skipped
+};
+
+} // namespace json
+} // namespace haisu
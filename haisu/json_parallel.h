@@ -0,0 +1,401 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org/>
+*/
+
+// clang-format off
+#pragma once
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include "haisu/json.h"
+
+namespace haisu
+{
+namespace json
+{
+
+namespace detail
+{
+
+enum { parallel_min_chunk = 64 * 1024 };
+
+// runs f(0) ... f(tasks - 1) on their own threads, f(0) goes on the calling one
+template <typename F>
+void run_parallel(size_t tasks, F&& f)
+{
+    std::vector<std::thread> threads;
+    threads.reserve(tasks - 1);
+    for (size_t i = 1; i < tasks; ++i)
+    {
+        threads.emplace_back(f, i);
+    }
+
+    f(0);
+
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+}
+
+// an odd backslash run right before pos escapes the byte at pos
+inline bool escaped_at(const char* begin, const char* pos) noexcept
+{
+    auto ptr = pos;
+    while (ptr != begin && ptr[-1] == '\\')
+    {
+        --ptr;
+    }
+    return (pos - ptr) & 1;
+}
+
+// calls f(ptr, block, valid, strings) for every block of [first, last), strings being the mask of the bytes inside
+// of strings; the scan stops early once f returns true, the scanner is left where the scan has stopped
+template <typename F>
+HAISU_NO_SANITIZE_ADDRESS void scan_blocks(const char* first, const char* last, simd::string_scanner& scanner, F&& f)
+{
+    auto ptr = simd::align_down(first);
+    auto valid = ~uint64_t{} << (first - ptr);
+    while (ptr < last)
+    {
+        if (last - ptr < simd::block_size)
+        {
+            valid &= ~uint64_t{} >> (simd::block_size - (last - ptr));
+        }
+
+        const simd::block b(ptr);
+        const auto strings = scanner.strings(b.eq<'"'>() & valid, b.eq<'\\'>() & valid) & valid;
+        if (f(ptr, b, valid, strings))
+        {
+            return;
+        }
+
+        ptr += simd::block_size;
+        valid = ~uint64_t{};
+    }
+}
+
+// what the first pass learns about a chunk, both for the chunk starting outside of a string ([0]) and inside of
+// one ([1]), the two differ only in which of the bytes are inside of strings: the prefix-xor of the quotes flips
+struct chunk_summary
+{
+    int64_t depth[2] = {}; // the brackets opened minus the brackets closed outside of strings
+    int64_t low[2] = {}; // the lowest the depth gets in the chunk, relative to its start
+    bool squote[2] = {}; // a single quote outside of strings, such a string is not to be indexed
+    bool quotes_odd = false; // the chunk flips the string state
+};
+
+// the lowest depth the brackets of a block take the depth to
+inline int64_t lowest_depth(int64_t depth, uint64_t opens, uint64_t closes) noexcept
+{
+    auto ret = depth;
+    for (auto events = opens | closes; events; events &= events - 1)
+    {
+        depth += (opens & events & (0 - events)) ? 1 : -1;
+        ret = std::min(ret, depth);
+    }
+    return ret;
+}
+
+HAISU_NO_SANITIZE_ADDRESS inline chunk_summary summarize_chunk(const char* begin, const char* first, const char* last)
+{
+    chunk_summary ret;
+    simd::string_scanner scanner(escaped_at(begin, first), false);
+    scan_blocks(first, last, scanner, [&ret](const char*, const simd::block& b, uint64_t valid, uint64_t strings) {
+        const auto opens = b.eq<'{', '['>() & valid;
+        const auto closes = b.eq<'}', ']'>() & valid;
+        const auto squotes = b.eq<'\''>() & valid;
+        const auto outside = ~strings;
+
+        if (closes & outside)
+        {
+            ret.low[0] = std::min(ret.low[0], lowest_depth(ret.depth[0], opens & outside, closes & outside));
+        }
+        if (closes & strings)
+        {
+            ret.low[1] = std::min(ret.low[1], lowest_depth(ret.depth[1], opens & strings, closes & strings));
+        }
+        ret.depth[0] += __builtin_popcountll(opens & outside) - __builtin_popcountll(closes & outside);
+        ret.depth[1] += __builtin_popcountll(opens & strings) - __builtin_popcountll(closes & strings);
+        ret.squote[0] |= (squotes & outside) != 0;
+        ret.squote[1] |= (squotes & strings) != 0;
+        return false;
+    });
+    ret.quotes_odd = scanner.in_string();
+    return ret;
+}
+
+// the opening brackets of the containers at the levels 1..top that are still open at the end of [first, last),
+// the chunk starts the document: at the depth of zero, outside of a string
+HAISU_NO_SANITIZE_ADDRESS inline std::vector<const char*> find_opens(const char* begin, const char* first, const char* last,
+    int64_t top)
+{
+    std::vector<const char*> ret(top + 1);
+    int64_t depth = 0;
+    simd::string_scanner scanner(escaped_at(begin, first), false);
+    scan_blocks(first, last, scanner, [&](const char* ptr, const simd::block& b, uint64_t valid, uint64_t strings) {
+        const auto outside = ~strings & valid;
+        const auto opens = b.eq<'{', '['>() & outside;
+        const auto closes = b.eq<'}', ']'>() & outside;
+
+        for (auto events = opens | closes; events; events &= events - 1)
+        {
+            const auto bit = events & (0 - events);
+            if (!(opens & bit))
+            {
+                --depth;
+            }
+            else if (++depth <= top)
+            {
+                ret[depth] = ptr + simd::first_bit(bit);
+            }
+        }
+        return false;
+    });
+    return ret;
+}
+
+// the commas and the closing brackets of the containers at the levels 1..top, the ones open at the start of
+// [first, last)
+struct level_marks
+{
+    std::vector<const char*> comma; // the first comma of the container
+    std::vector<const char*> close;
+};
+
+// the chunk starts at the given depth, which is top or deeper; the scan stops once the container at top has
+// a comma, or, if to_close, once the top-level container is closed (the commas of the shallower levels come after
+// the deeper levels are closed)
+HAISU_NO_SANITIZE_ADDRESS inline level_marks find_level_marks(const char* begin, const char* first, const char* last,
+    bool in_string, int64_t depth, int64_t top, bool to_close)
+{
+    level_marks ret{std::vector<const char*>(top + 1), std::vector<const char*>(top + 1)};
+    auto floor = top; // the levels below are closed, the ones above are not looked at
+    simd::string_scanner scanner(escaped_at(begin, first), in_string);
+    scan_blocks(first, last, scanner, [&](const char* ptr, const simd::block& b, uint64_t valid, uint64_t strings) {
+        const auto outside = ~strings & valid;
+        const auto opens = b.eq<'{', '['>() & outside;
+        const auto closes = b.eq<'}', ']'>() & outside;
+        const auto commas = b.eq<','>() & outside;
+
+        if (depth - __builtin_popcountll(closes) > floor || (!commas && !closes))
+        {
+            depth += __builtin_popcountll(opens) - __builtin_popcountll(closes);
+            return false;
+        }
+
+        for (auto events = opens | closes | commas; events; events &= events - 1)
+        {
+            const auto bit = events & (0 - events);
+            if (opens & bit)
+            {
+                ++depth;
+            }
+            else if (closes & bit)
+            {
+                if (depth-- == floor)
+                {
+                    ret.close[floor--] = ptr + simd::first_bit(bit);
+                    if (!floor)
+                    {
+                        return true;
+                    }
+                }
+            }
+            else if (depth == floor && !ret.comma[floor])
+            {
+                ret.comma[floor] = ptr + simd::first_bit(bit);
+                if (!to_close)
+                {
+                    return true;
+                }
+            }
+        }
+        return false;
+    });
+    return ret;
+}
+
+} // namespace detail
+
+// The first stage of the parallel parsing: the contents of an object or array are split at its commas into up to
+// shards slices of about the same size, every slice is a sequence of complete members/items.
+// The input is cut into chunks, every chunk is scanned on its own thread twice: first it is summarized (the number
+// of the quotes, the depth change and the lowest depth, for both the chunk starting in and out of a string), then
+// the states are carried over the chunks one after another (a prefix-xor of the quote parity), then every chunk
+// looks for the first commas of the containers it is in; an escape is never carried over, a chunk looks at the
+// backslashes before it.
+// The container split is the one whose slices come out the most even, so a document like {"items":[...]} is split
+// inside of its array. It may be nested: the document around it is then everything before the first slice
+// (up to and with its opening bracket) and everything after the last one (from its closing bracket on).
+// Only the containers which hold all of the chunk bounds are looked at, there is no per-chunk structural index:
+// a document whose bulk is spread over several sibling containers (say {"a":[...],"b":[...]}) is split at best
+// at the commas of their parent, into as many slices as that one has members.
+// Nothing is returned if the input is not a single object/array, if it is too small to be worth splitting, if its
+// brackets or quotes do not add up, or if there are single-quoted strings (which the scan is unable to follow).
+inline std::vector<string_view> split_top_level(string_view json, size_t shards = 0)
+{
+    if (!shards)
+    {
+        shards = std::max(1u, std::thread::hardware_concurrency());
+    }
+    shards = std::min(shards, json.size() / detail::parallel_min_chunk);
+
+    const auto begin = json.data();
+    const auto end = begin + json.size();
+    const auto first = skip_blanks(begin, end);
+    auto last = end;
+    while (last != first && is_blank(last[-1]))
+    {
+        --last;
+    }
+
+    if (shards < 2 || first == last || last[-1] != (*first == '{' ? '}' : ']') || (*first != '{' && *first != '['))
+    {
+        return {};
+    }
+
+    // the chunks are block-aligned, but the first one
+    std::vector<const char*> bounds(shards + 1);
+    bounds[0] = first;
+    bounds[shards] = last;
+    for (size_t i = 1; i < shards; ++i)
+    {
+        bounds[i] = std::max(first, simd::align_down(first + (last - first) * i / shards));
+    }
+
+    std::vector<detail::chunk_summary> summaries(shards);
+    detail::run_parallel(shards, [&](size_t i) {
+        summaries[i] = detail::summarize_chunk(begin, bounds[i], bounds[i + 1]);
+    });
+
+    std::vector<uint8_t> in_string(shards);
+    std::vector<int64_t> depth(shards);
+    bool state = false;
+    int64_t level = 0;
+    for (size_t i = 0; i < shards; ++i)
+    {
+        const auto& summary = summaries[i];
+        if (summary.squote[state])
+        {
+            return {};
+        }
+
+        in_string[i] = state;
+        depth[i] = level;
+        level += summary.depth[state];
+        state ^= summary.quotes_odd;
+    }
+
+    if (state || level != 0)
+    {
+        return {};
+    }
+
+    // the containers at the levels 1..top hold all of the chunk bounds
+    auto top = depth[1];
+    for (size_t i = 1; i < shards; ++i)
+    {
+        top = std::min(top, depth[i]);
+        if (i + 1 < shards)
+        {
+            top = std::min(top, depth[i] + summaries[i].low[in_string[i]]);
+        }
+    }
+    if (top < 1)
+    {
+        return {};
+    }
+
+    std::vector<const char*> opens;
+    std::vector<detail::level_marks> marks(shards);
+    detail::run_parallel(shards, [&](size_t i) {
+        if (!i)
+        {
+            opens = detail::find_opens(begin, first, bounds[1], top);
+            return;
+        }
+        marks[i] = detail::find_level_marks(begin, bounds[i], bounds[i + 1], in_string[i], depth[i], top,
+            i + 1 == shards);
+    });
+
+    // the level whose split keeps the longest of the pieces (the slices, and the document around them, which is
+    // parsed alongside) the shortest
+    int64_t split = 0;
+    auto shortest = last - first;
+    for (int64_t level = 1; level <= top; ++level)
+    {
+        const auto close = marks.back().close[level];
+        if (!opens[level] || !close)
+        {
+            continue;
+        }
+
+        auto longest = (opens[level] - first) + (last - close);
+        auto slice = opens[level] + 1;
+        for (size_t i = 1; i < shards; ++i)
+        {
+            if (const auto comma = marks[i].comma[level])
+            {
+                longest = std::max(longest, comma - slice);
+                slice = comma + 1;
+            }
+        }
+        longest = std::max(longest, close - slice);
+
+        if (longest < shortest)
+        {
+            shortest = longest;
+            split = level;
+        }
+    }
+    if (!split)
+    {
+        return {};
+    }
+
+    std::vector<string_view> ret;
+    auto slice = opens[split] + 1;
+    for (size_t i = 1; i < shards; ++i)
+    {
+        if (const auto comma = marks[i].comma[split])
+        {
+            ret.emplace_back(slice, comma - slice);
+            slice = comma + 1;
+        }
+    }
+    ret.emplace_back(slice, marks.back().close[split] - slice);
+
+    if (ret.size() < 2)
+    {
+        ret.clear();
+    }
+    return ret;
+}
+
+} // namespace json
+} // namespace haisu
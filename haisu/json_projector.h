@@ -0,0 +1,444 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org/>
+*/
+
+// clang-format off
+#pragma once
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+#include "haisu/json.h"
+
+namespace haisu
+{
+namespace json
+{
+
+// tells the derivee of projector which one of the paths has matched
+template <const char* Path>
+struct path
+{
+    static constexpr const char* value = Path;
+};
+
+namespace detail
+{
+
+struct path_step
+{
+    enum kind_t : uint8_t
+    {
+        key,
+        any_key,
+        index,
+        any_index
+    };
+
+    kind_t kind = key;
+    const char* name = nullptr;
+    size_t size = 0;
+    size_t pos = 0;
+
+    // the key comes still escaped, the way the parser gives it away, it is compared as it would be decoded
+    bool matches_key(string_view k) const noexcept
+    {
+        if (kind != key)
+        {
+            return kind == any_key;
+        }
+        if (k.size() < size) // an escape sequence is never shorter than what it decodes into
+        {
+            return false;
+        }
+
+        const auto escape = static_cast<const char*>(std::memchr(k.data(), '\\', k.size()));
+        return escape ? decoded_equals(k.data(), k.data() + k.size(), escape, string_view(name, size))
+            : string_view(name, size) == k;
+    }
+
+    bool matches_index(size_t i) const noexcept
+    {
+        return kind == any_index || (kind == index && pos == i);
+    }
+};
+
+// a malformed path does not compile, throw is not allowed in a constant expression
+constexpr size_t path_length(const char* path)
+{
+    if (path[0] != '$')
+    {
+        throw "a path starts with $";
+    }
+
+    size_t ret = 0;
+    for (size_t i = 1; path[i]; ++i)
+    {
+        ret += path[i] == '.' || path[i] == '[';
+    }
+    return ret;
+}
+
+template <size_t N>
+constexpr std::array<path_step, N> compile_path(const char* path)
+{
+    std::array<path_step, N> ret{};
+    size_t i = 1;
+    for (size_t n = 0; n < N; ++n)
+    {
+        auto& step = ret[n];
+        if (path[i] == '.')
+        {
+            const auto begin = ++i;
+            while (path[i] && path[i] != '.' && path[i] != '[')
+            {
+                ++i;
+            }
+
+            if (i == begin)
+            {
+                throw "an empty key in the path";
+            }
+
+            step.kind = i - begin == 1 && path[begin] == '*' ? path_step::any_key : path_step::key;
+            step.name = path + begin;
+            step.size = i - begin;
+        }
+        else
+        {
+            ++i;
+            if (path[i] == '*')
+            {
+                step.kind = path_step::any_index;
+                ++i;
+            }
+            else
+            {
+                if (path[i] < '0' || path[i] > '9')
+                {
+                    throw "either an index or * is expected in the brackets";
+                }
+
+                step.kind = path_step::index;
+                while (path[i] >= '0' && path[i] <= '9')
+                {
+                    step.pos = step.pos * 10 + size_t(path[i++] - '0');
+                }
+            }
+
+            if (path[i] != ']')
+            {
+                throw "] is expected in the path";
+            }
+            ++i;
+        }
+    }
+    return ret;
+}
+
+template <const char* Path>
+struct compiled_path
+{
+    static constexpr size_t length = path_length(Path);
+    static_assert(length > 0, "a path must go deeper than $");
+    static constexpr std::array<path_step, length> steps = compile_path<length>(Path);
+};
+
+struct path_info
+{
+    const path_step* steps;
+    size_t length;
+};
+
+} // namespace detail
+
+// Calls the derivee only for the values found at the given paths, the subtrees nobody is interested in are skipped at
+// scanner speed with no callbacks at all.
+// A path is a pointer to a static constexpr string (C++17 does not take string literals as template arguments):
+//     static constexpr char user_id[] = "$.user.id";
+//     static constexpr char event_ts[] = "$.events[*].ts";
+//     struct handler : json::projector<handler, user_id, event_ts>
+//     {
+//         void on_match(json::path<user_id>, int64_t id);
+//         void on_match(json::path<event_ts>, double ts);
+//     };
+// The steps are .key, .*, [N] and [*]. The paths are compiled into step tables, while parsing the projector keeps
+// a bitmask of the paths still matching for every level of the document. The derivee gets on_match(path<P>, value),
+// value is either a string_literal, a bool_literal, a null_literal or a number: a typed one, the same way as parser
+// does it, or a numeric_literal. A path ending at an object or an array matches nothing.
+// The subtrees are only skipped by parse(), the input coming through feed() is looked at in full.
+template <typename T, const char*... Paths>
+class projector : private parser<projector<T, Paths...>>
+{
+    static_assert(sizeof...(Paths) > 0 && sizeof...(Paths) <= 64, "a projector takes from 1 to 64 paths");
+
+    using parser_type = parser<projector<T, Paths...>>;
+    friend parser_type;
+
+    static constexpr size_t max_depth = 64;
+
+    struct frame
+    {
+        uint64_t paths; // the paths going deeper than this container
+        uint64_t value; // object: the paths matching the current key
+        size_t index; // array: the index of the next item
+        bool array;
+    };
+
+public:
+    void parse(const char* json_string)
+    {
+        reset_matches();
+        parser_type::parse(json_string);
+    }
+
+    void parse(const char* begin, const char* end)
+    {
+        reset_matches();
+        parser_type::parse(begin, end);
+    }
+
+    void parse(string_view json)
+    {
+        reset_matches();
+        parser_type::parse(json);
+    }
+
+    // the first chunk starts a new document, the same way it does for parser
+    void feed(const char* begin, const char* end)
+    {
+        if (!feeding_)
+        {
+            reset_matches();
+            feeding_ = true;
+        }
+        parser_type::feed(begin, end);
+    }
+
+    void feed(string_view chunk)
+    {
+        feed(chunk.data(), chunk.data() + chunk.size());
+    }
+
+    void finish()
+    {
+        if (!feeding_)
+        {
+            reset_matches();
+        }
+        parser_type::finish();
+        feeding_ = false;
+    }
+
+protected:
+    using parser_type::terminate;
+
+private:
+    static constexpr detail::path_info paths_[] = {{detail::compiled_path<Paths>::steps.data(), detail::compiled_path<Paths>::length}...};
+
+    // ends_at_[N] is the mask of the paths having exactly N + 1 steps
+    static constexpr std::array<uint64_t, max_depth> make_ends_at()
+    {
+        std::array<uint64_t, max_depth> ret{};
+        for (size_t i = 0; i < sizeof...(Paths); ++i)
+        {
+            if (paths_[i].length <= max_depth)
+            {
+                ret[paths_[i].length - 1] |= uint64_t(1) << i;
+            }
+        }
+        return ret;
+    }
+
+    static constexpr std::array<uint64_t, max_depth> ends_at_ = make_ends_at();
+    static constexpr uint64_t all_paths_ = ~uint64_t{} >> (64 - sizeof...(Paths));
+
+    // the match state of whatever came before is dropped, be it a finished document or an abandoned one
+    void reset_matches() noexcept
+    {
+        depth_ = 0;
+        feeding_ = false;
+    }
+
+    // the paths matching the key at the given depth
+    static uint64_t match_key(uint64_t mask, size_t depth, string_view key) noexcept
+    {
+        uint64_t ret = 0;
+        for (; mask; mask &= mask - 1)
+        {
+            const auto i = __builtin_ctzll(mask);
+            ret |= uint64_t(paths_[i].steps[depth].matches_key(key)) << i;
+        }
+        return ret;
+    }
+
+    static uint64_t match_index(uint64_t mask, size_t depth, size_t index) noexcept
+    {
+        uint64_t ret = 0;
+        for (; mask; mask &= mask - 1)
+        {
+            const auto i = __builtin_ctzll(mask);
+            ret |= uint64_t(paths_[i].steps[depth].matches_index(index)) << i;
+        }
+        return ret;
+    }
+
+    frame& top() noexcept
+    {
+        return frames_[depth_ - 1];
+    }
+
+    // the paths matching the value which is about to come
+    uint64_t current() noexcept
+    {
+        if (depth_ == 0)
+        {
+            return 0;
+        }
+
+        auto& f = top();
+        return f.array ? match_index(f.paths, depth_ - 1, f.index++) : f.value;
+    }
+
+    void open(bool array)
+    {
+        if (depth_ == max_depth)
+        {
+            return; // the parser has already given up
+        }
+
+        const auto mask = depth_ == 0 ? all_paths_ : current() & ~ends_at_[depth_ - 1];
+        frames_[depth_++] = frame{mask, 0, 0, array};
+        if (!mask)
+        {
+            parser_type::skip();
+        }
+    }
+
+    void close() noexcept
+    {
+        if (depth_ > 0)
+        {
+            --depth_;
+        }
+    }
+
+    void on_new_object() { open(false); }
+    void on_new_array() { open(true); }
+    void on_object_end() { close(); }
+    void on_array_end() { close(); }
+
+    void on_key(string_literal key)
+    {
+        auto& f = top();
+        f.value = match_key(f.paths, depth_ - 1, key.view);
+        if (!f.value)
+        {
+            parser_type::skip();
+        }
+    }
+
+    template <typename Literal>
+    void on_scalar(Literal lit)
+    {
+        if (depth_ > 0)
+        {
+            if (const auto mask = current() & ends_at_[depth_ - 1])
+            {
+                deliver_matches(mask, lit, std::index_sequence_for<std::integral_constant<const char*, Paths>...>{});
+            }
+        }
+    }
+
+    void on_value(string_literal lit) { on_scalar(lit); }
+    void on_value(bool_literal lit) { on_scalar(lit); }
+    void on_value(null_literal lit) { on_scalar(lit); }
+    void on_value(numeric_literal lit) { on_scalar(lit); }
+    void on_array(string_literal lit) { on_scalar(lit); }
+    void on_array(bool_literal lit) { on_scalar(lit); }
+    void on_array(null_literal lit) { on_scalar(lit); }
+    void on_array(numeric_literal lit) { on_scalar(lit); }
+
+    // only if the derivee wants to know about errors, the parser validates a little more then
+    template <typename U = T, typename = decltype(&U::on_error)>
+    void on_error(error err)
+    {
+        static_cast<T*>(this)->on_error(err);
+    }
+
+    template <typename Literal, size_t... I>
+    void deliver_matches(uint64_t mask, const Literal& lit, std::index_sequence<I...>)
+    {
+        (((mask >> I) & 1 ? deliver<Paths>(lit) : void()), ...);
+    }
+
+    template <const char* P, typename Literal>
+    void deliver(const Literal& lit)
+    {
+        call_match(*static_cast<T*>(this), path<P>{}, lit, 0);
+    }
+
+    // the numbers are converted for the matches only
+    template <const char* P>
+    void deliver(const numeric_literal& lit)
+    {
+        auto& t = *static_cast<T*>(this);
+        const auto begin = lit.view.data();
+        const auto end = begin + lit.view.size();
+        detail::decimal num;
+        if constexpr (has_match_handler<P, int64_t>() || has_match_handler<P, uint64_t>() || has_match_handler<P, double>())
+        {
+            num.valid = detail::scan_number<true, true>(begin, end, num) == end && num.valid;
+        }
+
+        detail::deliver_number<has_match_handler<P, int64_t>(), has_match_handler<P, uint64_t>(), has_match_handler<P, double>()>(
+            lit.view, num, [&t](auto val) { call_match(t, path<P>{}, val, 0); });
+    }
+
+    template <const char* P, typename U>
+    static constexpr bool has_match_handler() noexcept
+    {
+        return !is_valid_expression<T>([](auto&& o) -> decltype(o.on_match(path<P>{}, detail::not_a_number{})) {})
+            && is_valid_expression<T>([](auto&& o) -> decltype(o.on_match(path<P>{}, detail::exactly<U>{})) {});
+    }
+
+    template <typename U, typename Path, typename Literal>
+    static auto call_match(U& t, Path p, Literal&& lit, int) -> decltype(t.on_match(p, std::forward<Literal>(lit)), void())
+    {
+        t.on_match(p, std::forward<Literal>(lit));
+    }
+
+    template <typename U, typename Path, typename Literal>
+    static void call_match(U&, Path, Literal&&, long) {}
+
+    std::array<frame, max_depth> frames_;
+    size_t depth_ = 0;
+    bool feeding_ = false;
+};
+
+} // namespace json
+} // namespace haisu
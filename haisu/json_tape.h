@@ -0,0 +1,704 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org/>
+*/
+
+// clang-format off
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "haisu/json.h"
+#include "haisu/json_parallel.h"
+
+namespace haisu
+{
+namespace json
+{
+
+// A compact read-only DOM: the document goes into a flat array of 64-bit words (the tape), the strings go into
+// a separate buffer. Every word has its type in the upper byte:
+//     '{' '['     an object/an array, the lower 32 bits hold the index of the word right after the matching close,
+//                 the next 24 bits hold the number of the members/items (saturated)
+//     '}' ']'     the end of the object/array, the lower 32 bits hold the index of its opening word
+//     '"'         a string (a key or a value), the lower 56 bits hold the offset of the string in the string buffer
+//     'l' 'u' 'd' int64_t, uint64_t, double, the value itself is in the next word
+//     'n' 't' 'f' null, true, false
+// An object is a sequence of key-value pairs, a sibling is always one hop away no matter how large the value is.
+// A string in the string buffer is its 32-bit length followed by the (decoded) characters and the null-terminator.
+namespace detail
+{
+
+enum tape_tag : uint8_t
+{
+    tag_object = '{',
+    tag_object_end = '}',
+    tag_array = '[',
+    tag_array_end = ']',
+    tag_string = '"',
+    tag_int64 = 'l',
+    tag_uint64 = 'u',
+    tag_double = 'd',
+    tag_null = 'n',
+    tag_true = 't',
+    tag_false = 'f'
+};
+
+enum : uint64_t
+{
+    tape_payload_mask = (uint64_t{1} << 56) - 1,
+    tape_index_mask = (uint64_t{1} << 32) - 1,
+    tape_count_shift = 32,
+    tape_count_max = (uint64_t{1} << 24) - 1
+};
+
+constexpr uint64_t tape_word(tape_tag tag, uint64_t payload) noexcept
+{
+    return uint64_t(tag) << 56 | payload;
+}
+
+class tape_view
+{
+public:
+    tape_view() = default;
+
+    tape_view(const uint64_t* tape, const char* strings, size_t index) noexcept
+        : tape_(tape)
+        , strings_(strings)
+        , index_(index)
+    {
+    }
+
+    bool has_key(const char* key) const noexcept
+    {
+        return find(key, std::strlen(key)) != npos;
+    }
+
+    tape_view child(const char* key) const noexcept
+    {
+        const auto index = find(key, std::strlen(key));
+        return index != npos ? tape_view{tape_, strings_, index} : tape_view{};
+    }
+
+    tape_view child(string_view key) const noexcept
+    {
+        const auto index = find(key.data(), key.size());
+        return index != npos ? tape_view{tape_, strings_, index} : tape_view{};
+    }
+
+    // an array item, O(index) hops
+    tape_view operator[](size_t index) const noexcept
+    {
+        if (is_array())
+        {
+            for (auto i = index_ + 1; tag(i) != tag_array_end; i = next(i))
+            {
+                if (!index--)
+                {
+                    return tape_view{tape_, strings_, i};
+                }
+            }
+        }
+        return tape_view{};
+    }
+
+    // the number of the object members or the array items
+    size_t count() const noexcept
+    {
+        if (!is_object() && !is_array())
+        {
+            return 0;
+        }
+
+        const auto count = (tape_[index_] >> tape_count_shift) & tape_count_max;
+        if (count < tape_count_max)
+        {
+            return count;
+        }
+
+        auto ret = size_t{};
+        foreach_child([&ret](auto&&){ ++ret; });
+        return ret;
+    }
+
+    size_t count_array() const noexcept
+    {
+        return is_array() ? count() : 0;
+    }
+
+    // f(tape_view) for every member value of the object or every item of the array
+    template <typename F>
+    void foreach_child(F&& f) const
+    {
+        if (is_object())
+        {
+            foreach_member([&f](string_view, tape_view value) { f(value); });
+        }
+        else if (is_array())
+        {
+            for (auto i = index_ + 1; tag(i) != tag_array_end; i = next(i))
+            {
+                f(tape_view{tape_, strings_, i});
+            }
+        }
+    }
+
+    // f(string_view, tape_view) for every member of the object
+    template <typename F>
+    void foreach_member(F&& f) const
+    {
+        if (is_object())
+        {
+            for (auto i = index_ + 1; tag(i) != tag_object_end; i = next(i + 1))
+            {
+                f(string_at(i), tape_view{tape_, strings_, i + 1});
+            }
+        }
+    }
+
+    bool empty() const noexcept
+    {
+        return !tape_;
+    }
+
+    bool is_object() const noexcept
+    {
+        return is(tag_object);
+    }
+
+    bool is_array() const noexcept
+    {
+        return is(tag_array);
+    }
+
+    bool is_literal() const noexcept
+    {
+        return !empty() && !is_object() && !is_array();
+    }
+
+    bool is_string() const noexcept
+    {
+        return is(tag_string);
+    }
+
+    bool is_number() const noexcept
+    {
+        return is(tag_int64) || is(tag_uint64) || is(tag_double);
+    }
+
+    bool is_bool() const noexcept
+    {
+        return is(tag_true) || is(tag_false);
+    }
+
+    bool is_null() const noexcept
+    {
+        return is(tag_null);
+    }
+
+    // the accessors below expect the value to be of the right type, there is an empty string/zero/false otherwise
+    string_view as_string() const noexcept
+    {
+        return is_string() ? string_at(index_) : string_view{};
+    }
+
+    bool as_bool() const noexcept
+    {
+        return is(tag_true);
+    }
+
+    int64_t as_int64() const noexcept
+    {
+        return number<int64_t>();
+    }
+
+    uint64_t as_uint64() const noexcept
+    {
+        return number<uint64_t>();
+    }
+
+    double as_double() const noexcept
+    {
+        return number<double>();
+    }
+
+private:
+    static constexpr size_t npos = ~size_t{};
+
+    tape_tag tag(size_t index) const noexcept
+    {
+        return static_cast<tape_tag>(tape_[index] >> 56);
+    }
+
+    bool is(tape_tag t) const noexcept
+    {
+        return !empty() && tag(index_) == t;
+    }
+
+    // the sibling of the value at the index
+    size_t next(size_t index) const noexcept
+    {
+        switch (tag(index))
+        {
+            case tag_object:
+            case tag_array:
+                return tape_[index] & tape_index_mask;
+            case tag_int64:
+            case tag_uint64:
+            case tag_double:
+                return index + 2;
+            default:
+                return index + 1;
+        }
+    }
+
+    string_view string_at(size_t index) const noexcept
+    {
+        const auto str = strings_ + (tape_[index] & tape_payload_mask);
+        uint32_t len;
+        std::memcpy(&len, str, sizeof(len));
+        return string_view(str + sizeof(len), len);
+    }
+
+    // the index of the value of the key
+    size_t find(const char* key, size_t len) const noexcept
+    {
+        if (is_object())
+        {
+            for (auto i = index_ + 1; tag(i) != tag_object_end; i = next(i + 1))
+            {
+                const auto str = strings_ + (tape_[i] & tape_payload_mask);
+                uint32_t size;
+                std::memcpy(&size, str, sizeof(size));
+                if (size == len && !std::memcmp(str + sizeof(size), key, len))
+                {
+                    return i + 1;
+                }
+            }
+        }
+        return npos;
+    }
+
+    template <typename U>
+    U number() const noexcept
+    {
+        if (empty())
+        {
+            return U{};
+        }
+
+        const auto word = tape_[index_ + 1];
+        switch (tag(index_))
+        {
+            case tag_int64:
+                return static_cast<U>(static_cast<int64_t>(word));
+            case tag_uint64:
+                return static_cast<U>(word);
+            case tag_double:
+                {
+                    double val;
+                    std::memcpy(&val, &word, sizeof(val));
+                    return static_cast<U>(val);
+                }
+            default:
+                return U{};
+        }
+    }
+
+    const uint64_t* tape_ = nullptr;
+    const char* strings_ = nullptr;
+    size_t index_{};
+};
+
+} // namespace detail
+
+// the tape DOM built by the SAX parser, the strings are decoded and copied, so the input may go away after parse();
+// the top-level value must be either an object or an array, the scalars are ignored by the parser
+class tape : private parser<tape, 63, unescape_strings>
+{
+    using parser_type = parser<tape, 63, unescape_strings>;
+    using tape_tag = detail::tape_tag;
+    using tape_view = detail::tape_view;
+
+public:
+    bool has_key(const char* key) const noexcept
+    {
+        return root().has_key(key);
+    }
+
+    tape_view child(const char* key) const noexcept
+    {
+        return root().child(key);
+    }
+
+    tape_view root() const noexcept
+    {
+        return tape_.empty() ? tape_view{} : tape_view{tape_.data(), strings_.data(), 0};
+    }
+
+    // the previous document is dropped, returns false and leaves the tape empty if the input is malformed
+    bool parse(const char* json_string)
+    {
+        begin_document();
+        parser_type::parse(json_string);
+        return end_document();
+    }
+
+    bool parse(string_view json)
+    {
+        begin_document();
+        parser_type::parse(json);
+        return end_document();
+    }
+
+    // same as parse(), but a large document is parsed on several threads (shards = 0 means one per hardware thread):
+    // an object/array is split into slices (see split_top_level), every slice goes to its own tape, and so does the
+    // document around the container split, with the container left empty; then the tapes are spliced. A document
+    // which cannot be split or which fails to parse in slices is parsed as usual
+    bool parse_parallel(string_view json, size_t shards = 0)
+    {
+        const auto slices = split_top_level(json, shards);
+        if (slices.empty())
+        {
+            return parse(json);
+        }
+
+        const auto head = string_view(json.data(), slices.front().data() - json.data());
+        const auto tail = json.substr(slices.back().data() + slices.back().size() - json.data());
+        std::vector<tape> parts(slices.size());
+        tape frame;
+        size_t at = 0;
+        std::atomic<bool> failed{false};
+        detail::run_parallel(parts.size() + 1, [&](size_t i) {
+            if (i == parts.size() ? !frame.parse_frame(head, tail, at) : !parts[i].parse_slice(head.back(), slices[i]))
+            {
+                failed.store(true, std::memory_order_relaxed);
+            }
+        });
+
+        if (failed.load(std::memory_order_relaxed))
+        {
+            return parse(json); // the usual parser reports the errors, and sorts out whatever the slices could not
+        }
+
+        splice(frame, at, parts);
+        return true;
+    }
+
+    // the number of the words on the tape
+    size_t size() const noexcept
+    {
+        return tape_.size();
+    }
+
+private:
+    // the members/items of an object/array, the document is the container they are wrapped into
+    bool parse_slice(char open, string_view items)
+    {
+        const char close = open == '{' ? '}' : ']';
+
+        begin_document();
+        parser_type::feed(&open, &open + 1);
+        parser_type::feed(items);
+        parser_type::feed(&close, &close + 1);
+        parser_type::finish();
+
+        // exactly one container, the slice has not closed it early
+        return end_document() && !tape_.empty() && (tape_[0] & detail::tape_index_mask) == tape_.size();
+    }
+
+    // the document around the container split into the slices, the container is left empty: head ends with its
+    // opening bracket, tail starts with its closing one; at is the word of the container
+    bool parse_frame(string_view head, string_view tail, size_t& at)
+    {
+        begin_document();
+        parser_type::feed(head);
+        at = tape_.size() - 1;
+        const auto opened = !failed_ && !stack_.empty() && stack_.top() == at;
+        parser_type::feed(tail);
+        parser_type::finish();
+
+        // the container has been closed right away, by the first byte of the tail
+        return end_document() && opened && tape_[at + 1] == detail::tape_word(
+            static_cast<tape_tag>(tape_[at] >> 56) == tape_tag::tag_object ? tape_tag::tag_object_end : tape_tag::tag_array_end, at);
+    }
+
+    // copies the words [first, last) of a tape to dest: the containers which point to from_word or past it point
+    // further by words, the strings are further by chars
+    static void relocate(const uint64_t* first, const uint64_t* last, uint64_t* dest, uint64_t from_word,
+        uint64_t words, uint64_t chars) noexcept
+    {
+        for (; first != last; ++first)
+        {
+            auto word = *first;
+            switch (static_cast<tape_tag>(word >> 56))
+            {
+            case tape_tag::tag_object:
+            case tape_tag::tag_object_end:
+            case tape_tag::tag_array:
+            case tape_tag::tag_array_end:
+                word += (word & detail::tape_index_mask) >= from_word ? words : 0;
+                break;
+            case tape_tag::tag_string:
+                word += chars;
+                break;
+            case tape_tag::tag_int64:
+            case tape_tag::tag_uint64:
+            case tape_tag::tag_double:
+                *dest++ = word;
+                word = *++first;
+                break;
+            default:
+                break;
+            }
+            *dest++ = word;
+        }
+    }
+
+    // the contents of the parts go one after another into the empty container at the word at of the frame, the
+    // offsets of the parts and of whatever in the frame comes after the container are moved along
+    void splice(const tape& frame, size_t at, const std::vector<tape>& parts)
+    {
+        begin_document();
+
+        std::vector<size_t> words(parts.size() + 1);
+        std::vector<size_t> chars(parts.size() + 1);
+        words[0] = at + 1;
+        chars[0] = frame.strings_.size();
+        uint64_t count = 0;
+        for (size_t i = 0; i < parts.size(); ++i)
+        {
+            words[i + 1] = words[i] + parts[i].tape_.size() - 2;
+            chars[i + 1] = chars[i] + parts[i].strings_.size();
+            count += (parts[i].tape_[0] >> detail::tape_count_shift) & detail::tape_count_max;
+        }
+
+        tape_.resize(frame.tape_.size() + words.back() - words[0]);
+        strings_.resize(chars.back());
+
+        detail::run_parallel(parts.size(), [&](size_t i) {
+            const auto& part = parts[i].tape_;
+            relocate(&part[1], &part[part.size() - 1], &tape_[words[i]], 0, words[i] - 1, chars[i]);
+            std::memcpy(&strings_[chars[i]], parts[i].strings_.data(), parts[i].strings_.size());
+        });
+
+        // the strings of the frame stay where they are, the ones of the parts go after them
+        const auto* source = frame.tape_.data();
+        relocate(source, source + at + 1, tape_.data(), at + 1, words.back() - words[0], 0);
+        relocate(source + at + 1, source + frame.tape_.size(), &tape_[words.back()], at + 1, words.back() - words[0], 0);
+        std::memcpy(&strings_[0], frame.strings_.data(), frame.strings_.size());
+
+        tape_[at] = (tape_[at] & ~(detail::tape_count_max << detail::tape_count_shift))
+            | std::min<uint64_t>(count, detail::tape_count_max) << detail::tape_count_shift;
+    }
+
+    void begin_document()
+    {
+        tape_.clear();
+        strings_.clear();
+        stack_.clear();
+        failed_ = false;
+    }
+
+    bool end_document()
+    {
+        if (failed_ || !stack_.empty())
+        {
+            tape_.clear();
+            strings_.clear();
+            return false;
+        }
+        return true;
+    }
+
+    void on_error(error)
+    {
+        failed_ = true;
+    }
+
+    void on_key(string_literal lit)
+    {
+        count_child();
+        push_string(lit.view);
+    }
+
+    void on_value(string_literal lit)
+    {
+        push_string(lit.view);
+    }
+
+    void on_array(string_literal lit)
+    {
+        count_child();
+        push_string(lit.view);
+    }
+
+    void on_value(null_literal)
+    {
+        push(tape_tag::tag_null, 0);
+    }
+
+    void on_array(null_literal)
+    {
+        count_child();
+        push(tape_tag::tag_null, 0);
+    }
+
+    void on_value(bool_literal lit)
+    {
+        push(lit.value ? tape_tag::tag_true : tape_tag::tag_false, 0);
+    }
+
+    void on_array(bool_literal lit)
+    {
+        count_child();
+        on_value(lit);
+    }
+
+    void on_value(int64_t val)
+    {
+        push_number(tape_tag::tag_int64, static_cast<uint64_t>(val));
+    }
+
+    void on_array(int64_t val)
+    {
+        count_child();
+        on_value(val);
+    }
+
+    void on_value(uint64_t val)
+    {
+        push_number(tape_tag::tag_uint64, val);
+    }
+
+    void on_array(uint64_t val)
+    {
+        count_child();
+        on_value(val);
+    }
+
+    void on_value(double val)
+    {
+        uint64_t word;
+        std::memcpy(&word, &val, sizeof(word));
+        push_number(tape_tag::tag_double, word);
+    }
+
+    void on_array(double val)
+    {
+        count_child();
+        on_value(val);
+    }
+
+    void on_new_object()
+    {
+        open(tape_tag::tag_object);
+    }
+
+    void on_object_end()
+    {
+        close(tape_tag::tag_object_end);
+    }
+
+    void on_new_array()
+    {
+        open(tape_tag::tag_array);
+    }
+
+    void on_array_end()
+    {
+        close(tape_tag::tag_array_end);
+    }
+
+    void open(tape_tag tag)
+    {
+        if (!stack_.empty() && static_cast<tape_tag>(tape_[stack_.top()] >> 56) == tape_tag::tag_array)
+        {
+            count_child(); // an object or an array inside of an array
+        }
+
+        stack_.push(static_cast<uint32_t>(tape_.size()));
+        push(tag, 0);
+    }
+
+    void close(tape_tag tag)
+    {
+        if (stack_.empty())
+        {
+            failed_ = true;
+            return;
+        }
+
+        const auto open = stack_.top();
+        stack_.pop();
+        push(tag, open);
+        tape_[open] |= tape_.size() & detail::tape_index_mask;
+    }
+
+    // one more member of the object or item of the array being built
+    void count_child()
+    {
+        auto& word = tape_[stack_.top()];
+        if (((word >> detail::tape_count_shift) & detail::tape_count_max) < detail::tape_count_max)
+        {
+            word += uint64_t{1} << detail::tape_count_shift;
+        }
+    }
+
+    void push(tape_tag tag, uint64_t payload)
+    {
+        tape_.push_back(detail::tape_word(tag, payload));
+    }
+
+    void push_number(tape_tag tag, uint64_t val)
+    {
+        push(tag, 0);
+        tape_.push_back(val);
+    }
+
+    void push_string(string_view str)
+    {
+        push(tape_tag::tag_string, strings_.size());
+
+        const auto len = static_cast<uint32_t>(str.size());
+        strings_.append(reinterpret_cast<const char*>(&len), sizeof(len));
+        strings_.append(str.data(), str.size());
+        strings_.push_back(0);
+    }
+
+    friend parser_type;
+
+    static_stack<uint32_t, parser_type::max_depth + 1> stack_; // the open objects and arrays
+    std::vector<uint64_t> tape_;
+    std::string strings_;
+    bool failed_ = false;
+};
+
+} // namespace json
+} // namespace haisu
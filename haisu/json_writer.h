@@ -0,0 +1,602 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org/>
+*/
+
+// clang-format off
+#pragma once
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+
+#include "haisu/json.h"
+#include "haisu/zbuf.h"
+
+namespace haisu
+{
+namespace json
+{
+
+// writes into a caller-supplied buffer, never allocates; once the buffer is full the rest of the output is dropped
+// and overflow() tells so
+class buffer_output
+{
+public:
+    buffer_output(char* buf, size_t size) noexcept
+        : begin_(buf)
+        , cur_(buf)
+        , end_(buf + size)
+    {
+    }
+
+    void write(const char* str, size_t len) noexcept
+    {
+        if (static_cast<size_t>(end_ - cur_) >= len)
+        {
+            memcpy(cur_, str, len);
+            cur_ += len;
+        }
+        else
+        {
+            overflow_ = true;
+            cur_ = end_;
+        }
+    }
+
+    void put(char ch) noexcept
+    {
+        if (cur_ != end_)
+        {
+            *cur_++ = ch;
+        }
+        else
+        {
+            overflow_ = true;
+        }
+    }
+
+    bool overflow() const noexcept
+    {
+        return overflow_;
+    }
+
+    // the number of bytes written so far
+    size_t size() const noexcept
+    {
+        return cur_ - begin_;
+    }
+
+    string_view view() const noexcept
+    {
+        return {begin_, size()};
+    }
+
+    void clear() noexcept
+    {
+        cur_ = begin_;
+        overflow_ = false;
+    }
+
+private:
+    char* begin_;
+    char* cur_;
+    char* end_;
+    bool overflow_ = false;
+};
+
+// appends to a zbuf, the zbuf is not null-terminated
+class zbuf_output
+{
+public:
+    explicit zbuf_output(zbuf& buf) noexcept
+        : buf_(buf)
+    {
+    }
+
+    void write(const char* str, size_t len)
+    {
+        buf_.append(str, len);
+    }
+
+    void put(char ch)
+    {
+        buf_.append(ch);
+    }
+
+    string_view view() const noexcept
+    {
+        return buf_.empty() ? string_view{} : string_view{buf_.ptr(0), buf_.size()};
+    }
+
+private:
+    zbuf& buf_;
+};
+
+// A streaming JSON writer, the counterpart of the parser: it has the very same callbacks, so a parser may be
+// piped straight into it (see pipe), and nothing else but the Output it writes to
+//     1) makes no memory allocations, the output does whatever it does (buffer_output never allocates)
+//     2) compact by default, pretty-printed with the given number of spaces per level otherwise
+//     3) on_key/on_value/on_array take the strings the way the parser gives them away: still escaped, the escape
+//        sequences are copied as they are, only the quotes, the control characters and \' are taken care of;
+//        key() and string() take the plain text and escape whatever is needed
+//     4) the numbers are either copied as they are (numeric_literal) or formatted with to_chars, the shortest text
+//        which reads back into the same double, the non-finite doubles go as null
+//     5) does no validation, the order of the calls is the caller's business, as is the nesting depth
+//     6) the top-level values go one per line
+template <typename Output>
+class writer
+{
+public:
+    explicit writer(Output out, int indent = 0)
+        : out_(std::forward<Output>(out))
+        , indent_(indent)
+    {
+    }
+
+    void on_key(string_literal lit)
+    {
+        before_key();
+        write_string<true>(lit.view);
+        after_key();
+    }
+
+    void on_value(string_literal lit)
+    {
+        before_value();
+        write_string<true>(lit.view);
+    }
+
+    void on_array(string_literal lit)
+    {
+        on_value(lit);
+    }
+
+    void on_value(null_literal)
+    {
+        before_value();
+        out_.write("null", 4);
+    }
+
+    void on_array(null_literal lit)
+    {
+        on_value(lit);
+    }
+
+    void on_value(bool_literal lit)
+    {
+        before_value();
+        lit.value ? out_.write("true", 4) : out_.write("false", 5);
+    }
+
+    void on_array(bool_literal lit)
+    {
+        on_value(lit);
+    }
+
+    void on_value(numeric_literal lit)
+    {
+        before_value();
+        out_.write(lit.view.data(), lit.view.size());
+    }
+
+    void on_array(numeric_literal lit)
+    {
+        on_value(lit);
+    }
+
+    void on_value(int64_t val)
+    {
+        before_value();
+        char buf[24];
+        const auto res = std::to_chars(buf, buf + sizeof(buf), val);
+        out_.write(buf, res.ptr - buf);
+    }
+
+    void on_array(int64_t val)
+    {
+        on_value(val);
+    }
+
+    void on_value(uint64_t val)
+    {
+        before_value();
+        char buf[24];
+        const auto res = std::to_chars(buf, buf + sizeof(buf), val);
+        out_.write(buf, res.ptr - buf);
+    }
+
+    void on_array(uint64_t val)
+    {
+        on_value(val);
+    }
+
+    void on_value(double val)
+    {
+        before_value();
+        if (!std::isfinite(val))
+        {
+            out_.write("null", 4);
+            return;
+        }
+
+        char buf[32];
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611
+        const auto len = std::to_chars(buf, buf + sizeof(buf), val).ptr - buf;
+#else
+        const auto len = snprintf(buf, sizeof(buf), "%.17g", val);
+#endif
+        out_.write(buf, len);
+    }
+
+    void on_array(double val)
+    {
+        on_value(val);
+    }
+
+    void on_new_object()
+    {
+        open('{');
+    }
+
+    void on_object_end()
+    {
+        close('}');
+    }
+
+    void on_new_array()
+    {
+        open('[');
+    }
+
+    void on_array_end()
+    {
+        close(']');
+    }
+
+    // the plain text key, escaped on the way
+    void key(string_view str)
+    {
+        before_key();
+        write_string<false>(str);
+        after_key();
+    }
+
+    // the plain text value (or an array item), escaped on the way
+    void string(string_view str)
+    {
+        before_value();
+        write_string<false>(str);
+    }
+
+    Output& output() noexcept
+    {
+        return out_;
+    }
+
+    const Output& output() const noexcept
+    {
+        return out_;
+    }
+
+    int depth() const noexcept
+    {
+        return depth_;
+    }
+
+private:
+    void open(char bracket)
+    {
+        before_value();
+        out_.put(bracket);
+        ++depth_;
+        has_items_ = false;
+    }
+
+    void close(char bracket)
+    {
+        assert(depth_ > 0);
+        --depth_;
+        if (has_items_)
+        {
+            new_line();
+        }
+        out_.put(bracket);
+        has_items_ = true;
+    }
+
+    void before_key()
+    {
+        if (has_items_)
+        {
+            out_.put(',');
+        }
+        new_line();
+    }
+
+    void after_key()
+    {
+        indent_ ? out_.write(": ", 2) : out_.put(':');
+        after_key_ = true;
+    }
+
+    void before_value()
+    {
+        if (after_key_)
+        {
+            after_key_ = false;
+        }
+        else if (depth_ == 0)
+        {
+            if (has_items_)
+            {
+                out_.put('\n');
+            }
+        }
+        else
+        {
+            if (has_items_)
+            {
+                out_.put(',');
+            }
+            new_line();
+        }
+        has_items_ = true;
+    }
+
+    void new_line()
+    {
+        static constexpr char spaces[] = "                                                                ";
+        if (indent_)
+        {
+            out_.put('\n');
+            for (auto n = depth_ * indent_; n > 0; n -= sizeof(spaces) - 1)
+            {
+                out_.write(spaces, std::min<size_t>(n, sizeof(spaces) - 1));
+            }
+        }
+    }
+
+    // Raw is the parser's text, the escape sequences are already there
+    template <bool Raw>
+    void write_string(string_view str)
+    {
+        auto begin = str.data();
+        const auto end = begin + str.size();
+
+        out_.put('"');
+        while (true)
+        {
+            const auto esc = simd::find_escape(begin, end);
+            out_.write(begin, esc - begin);
+            if (esc == end)
+            {
+                break;
+            }
+
+            begin = esc + 1;
+            if (Raw && *esc == '\\' && begin != end)
+            {
+                // \' comes from a single-quoted string and is not a json escape
+                *begin == '\'' ? out_.put('\'') : out_.write(esc, 2);
+                ++begin;
+            }
+            else
+            {
+                escape(*esc);
+            }
+        }
+        out_.put('"');
+    }
+
+    void escape(char ch)
+    {
+        switch (ch)
+        {
+        case '"': out_.write("\\\"", 2); break;
+        case '\\': out_.write("\\\\", 2); break;
+        case '\b': out_.write("\\b", 2); break;
+        case '\f': out_.write("\\f", 2); break;
+        case '\n': out_.write("\\n", 2); break;
+        case '\r': out_.write("\\r", 2); break;
+        case '\t': out_.write("\\t", 2); break;
+        default:
+        {
+            const char hex[] = "0123456789abcdef";
+            const char buf[] = {'\\', 'u', '0', '0', hex[(ch >> 4) & 0xf], hex[ch & 0xf]};
+            out_.write(buf, sizeof(buf));
+        }
+        }
+    }
+
+    Output out_;
+    int indent_ = 0;
+    int depth_ = 0;
+    bool has_items_ = false; // the current object/array (or the document) has got something in it already
+    bool after_key_ = false; // the next value goes right after the colon
+};
+
+template <typename Output> writer(Output) -> writer<Output>;
+template <typename Output> writer(Output, int) -> writer<Output>;
+
+// pipes the parser straight into a writer, e.g. minifies with a compact writer, pretty-prints with an indented one;
+// the strings go through as they are in the input, unless the unescape_strings policy decodes them first
+template <typename Writer, typename... Policies>
+class pipe : public parser<pipe<Writer, Policies...>, 63, Policies...>
+{
+    using parser_type = parser<pipe<Writer, Policies...>, 63, Policies...>;
+
+public:
+    explicit pipe(Writer& out) noexcept
+        : out_(out)
+    {
+    }
+
+    // an error has been seen since the pipe was made, the output is left half-written then
+    bool failed() const noexcept
+    {
+        return failed_;
+    }
+
+    error last_error() const noexcept
+    {
+        return error_;
+    }
+
+private:
+    static constexpr bool decoded() noexcept
+    {
+        return meta::one_of<unescape_strings, Policies...>::value;
+    }
+
+    void on_error(error err)
+    {
+        if (!failed_)
+        {
+            error_ = err;
+            failed_ = true;
+        }
+    }
+
+    void on_key(string_literal lit)
+    {
+        decoded() ? out_.key(lit.view) : out_.on_key(lit);
+    }
+
+    void on_value(string_literal lit)
+    {
+        decoded() ? out_.string(lit.view) : out_.on_value(lit);
+    }
+
+    void on_array(string_literal lit)
+    {
+        on_value(lit);
+    }
+
+    void on_value(null_literal lit)
+    {
+        out_.on_value(lit);
+    }
+
+    void on_array(null_literal lit)
+    {
+        out_.on_value(lit);
+    }
+
+    void on_value(bool_literal lit)
+    {
+        out_.on_value(lit);
+    }
+
+    void on_array(bool_literal lit)
+    {
+        out_.on_value(lit);
+    }
+
+    void on_value(numeric_literal lit)
+    {
+        out_.on_value(lit);
+    }
+
+    void on_array(numeric_literal lit)
+    {
+        out_.on_value(lit);
+    }
+
+    void on_new_object()
+    {
+        out_.on_new_object();
+    }
+
+    void on_object_end()
+    {
+        out_.on_object_end();
+    }
+
+    void on_new_array()
+    {
+        out_.on_new_array();
+    }
+
+    void on_array_end()
+    {
+        out_.on_array_end();
+    }
+
+    friend parser_type;
+
+    Writer& out_;
+    error error_{};
+    bool failed_ = false;
+};
+
+// minifies (indent = 0) or pretty-prints the json into the output, returns false if the input is malformed (the
+// strict grammar, see validating), the output is left half-written then
+template <typename Output>
+bool reformat(string_view json, Output& out, int indent = 0)
+{
+    writer<Output&> w{out, indent};
+    pipe<writer<Output&>, validating> p{w};
+    p.parse(json);
+    if (p.failed())
+    {
+        return false;
+    }
+
+    // the parser reports no top-level scalars, a document which is one goes as it is
+    const auto first = skip_blanks(json.data(), json.data() + json.size());
+    auto last = json.data() + json.size();
+    while (is_blank(last[-1]))
+    {
+        --last;
+    }
+
+    switch (*first)
+    {
+    case '{':
+    case '[':
+        break;
+    case '"':
+        w.on_value(string_literal{string_view(first + 1, last - first - 2)});
+        break;
+    case 't':
+    case 'f':
+        w.on_value(bool_literal{*first == 't'});
+        break;
+    case 'n':
+        w.on_value(null_literal{});
+        break;
+    default:
+        w.on_value(numeric_literal{string_view(first, last - first)});
+        break;
+    }
+    return true;
+}
+
+} // namespace json
+} // namespace haisu
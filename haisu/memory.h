@@ -28,6 +28,7 @@ For more information, please refer to <http://unlicense.org/>
 #pragma once
 
 #include <sys/mman.h>
+#include <sys/stat.h>
 #include "intrusive.h"
 
 namespace haisu
@@ -84,6 +85,27 @@ public:
         _size = size_bytes;
     }
 
+    // maps the whole file read-only, returns false if the file is empty or cannot be mapped
+    bool map_file(int fd)
+    {
+        assert(!created());
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size <= 0)
+        {
+            return false;
+        }
+
+        void* const ptr = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+        if (ptr == MAP_FAILED)
+        {
+            return false;
+        }
+
+        _ptr = ptr;
+        _size = size_t(st.st_size);
+        return true;
+    }
+
     void destroy()
     {
         assert(created());
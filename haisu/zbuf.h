@@ -27,48 +27,165 @@ For more information, please refer to <http://unlicense.org/>
 
 #pragma once
 
-#include <vector>
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
 #include <cstring>
+#include <new>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 namespace haisu
 {
 
+// a byte buffer for trivially copyable values
+// no memory is taken until the first append, then the first inline_capacity bytes are kept inside of the object,
+// a larger buffer goes to the heap or to an arena; the buffer grows geometrically and never initializes the memory
+// it grows by
+// the records are packed back to back by append(), load()/store() read and write them wherever they are;
+// append_aligned() pads a record to its alignment, then at_offset() hands out a reference to it;
+// open_file() moves the buffer into a memory-mapped file, see there
 class zbuf
 {
 public:
+    static constexpr size_t inline_capacity = 64;
+
+    zbuf() noexcept = default;
+
+    // the buffer is allocated from the arena, e.g. growbump: void* Arena::alloc(size_t) gives nullptr if it is out of
+    // memory, the memory is never given back, the arena must outlive the zbuf
+    template <typename Arena, typename = std::enable_if_t<!std::is_same<Arena, zbuf>{}>>
+    explicit zbuf(Arena& arena) noexcept
+        : arena_(&arena)
+        , arena_alloc_(&alloc_from<Arena>)
+    {
+    }
+
+    // a copy is made in the heap
+    zbuf(const zbuf& other)
+    {
+        append(other.data_, other.size_);
+    }
+
+    zbuf(zbuf&& other) noexcept
+        : arena_(other.arena_)
+        , arena_alloc_(other.arena_alloc_)
+    {
+        take(other);
+    }
+
+    zbuf& operator =(const zbuf& other)
+    {
+        if (this != &other)
+        {
+            size_ = 0;
+            append(other.data_, other.size_);
+        }
+        return *this;
+    }
+
+    zbuf& operator =(zbuf&& other) noexcept
+    {
+        if (this != &other)
+        {
+            release();
+            arena_ = other.arena_;
+            arena_alloc_ = other.arena_alloc_;
+            take(other);
+        }
+        return *this;
+    }
+
+    ~zbuf()
+    {
+        release();
+    }
+
     template <typename T, typename = std::enable_if_t<std::is_trivially_copyable<T>{}>> 
     void append(T t)
     {
-        const size_t prev = buf.size();
-        const size_t sz = sizeof(t);
-        buf.resize(prev + sz);
-        memcpy(&buf[prev], &t, sz);
+        memcpy(expand(sizeof(t)), &t, sizeof(t));
     }
 
+    // the value is zero-filled
     template <typename T, typename = std::enable_if_t<std::is_trivially_copyable<T>{}>> 
     T& append()
     {
-        const size_t prev = buf.size();
-        const size_t sz = sizeof(T);
-        buf.resize(prev + sz);
-        return *reinterpret_cast<T*>(&buf[prev]);
+        const auto ptr = expand(sizeof(T));
+        memset(ptr, 0, sizeof(T));
+        return *reinterpret_cast<T*>(ptr);
     }
 
     template <typename T, typename = std::enable_if_t<std::is_trivially_copyable<T>{}>> 
     T& append_modify(T t)
     {
-        const size_t prev = buf.size();
-        const size_t sz = sizeof(t);
-        buf.resize(prev + sz);
-        memcpy(&buf[prev], &t, sz);
-        return *reinterpret_cast<T*>(&buf[prev]);
+        const auto ptr = expand(sizeof(t));
+        memcpy(ptr, &t, sizeof(t));
+        return *reinterpret_cast<T*>(ptr);
+    }
+
+    // room for count values, left uninitialized
+    template <typename T, typename = std::enable_if_t<std::is_trivially_copyable<T>{}>> 
+    T* append_n(size_t count)
+    {
+        return reinterpret_cast<T*>(expand(count * sizeof(T)));
     }
 
     void append(const void* ptr, size_t len)
     {
-        const size_t prev = buf.size();
-        buf.resize(prev + len);
-        memcpy(&buf[prev], &ptr, len);
+        if (len)
+        {
+            memcpy(expand(len), ptr, len);
+        }
+    }
+
+    // pads the buffer with zeros up to a multiple of alignment (a power of two), returns the new size
+    size_t align(size_t alignment)
+    {
+        assert(alignment && !(alignment & (alignment - 1)));
+        const auto padding = (alignment - size_ % alignment) % alignment;
+        if (padding)
+        {
+            memset(expand(padding), 0, padding);
+        }
+        return size_;
+    }
+
+    // the aligned records: the value goes to the next offset aligned for T, the offset is returned, so that
+    // at_offset<T>() is safe to use; the memory of the buffer itself is aligned for any fundamental type,
+    // so the offset stays aligned when the buffer is reallocated
+    template <typename T, typename = std::enable_if_t<std::is_trivially_copyable<T>{}>> 
+    size_t append_aligned(T t)
+    {
+        static_assert(alignof(T) <= alignof(std::max_align_t), "over-aligned types are not supported");
+        const auto offset = align(alignof(T));
+        memcpy(expand(sizeof(t)), &t, sizeof(t));
+        return offset;
+    }
+
+    // the packed records: the value is copied out of the buffer, no matter how it is aligned
+    template <typename T, typename = std::enable_if_t<std::is_trivially_copyable<T>{}>> 
+    T load(size_t offset) const noexcept
+    {
+        assert(offset < size() && size() - offset >= sizeof(T));
+        T t;
+        memcpy(&t, data_ + offset, sizeof(T));
+        return t;
+    }
+
+    template <typename T, typename = std::enable_if_t<std::is_trivially_copyable<T>{}>> 
+    void store(size_t offset, T t) noexcept
+    {
+        assert(offset < size() && size() - offset >= sizeof(T));
+        memcpy(data_ + offset, &t, sizeof(T));
     }
 
     template <typename T>
@@ -83,28 +200,31 @@ public:
         return at_offset<T>(index * sizeof(T));
     }
 
+    // the value must be aligned, see append_aligned(), otherwise use load()/store()
     template <typename T>
     const T& at_offset(size_t offset) const noexcept
     {
         assert(offset < size() && size() - offset >= sizeof(T));
-        return *reinterpret_cast<const T*>(&buf[offset]);
+        assert(reinterpret_cast<uintptr_t>(data_ + offset) % alignof(T) == 0);
+        return *reinterpret_cast<const T*>(data_ + offset);
     }
 
     template <typename T>
     T& at_offset(size_t offset) noexcept
     {
         assert(offset < size() && size() - offset >= sizeof(T));
-        return *reinterpret_cast<T*>(&buf[offset]);
+        assert(reinterpret_cast<uintptr_t>(data_ + offset) % alignof(T) == 0);
+        return *reinterpret_cast<T*>(data_ + offset);
     }
 
     template <typename T>
     void insert(size_t index, T t)
     {
-        const size_t prev = buf.size();
         const size_t sz = sizeof(t);
-        buf.resize(prev + sz);
+        const size_t prev = size_;
+        expand(sz);
         
-        auto source = &buf[index * sz];
+        auto source = data_ + index * sz;
         auto dest = source + sz;
         memmove(dest, source, prev - index * sz);
         at<T>(index) = t;
@@ -115,83 +235,379 @@ public:
     {
         const auto dest = index * sizeof(T);
         const auto src = dest + sizeof(T);
-        const auto size = buf.size() - src;
         
-        auto destptr = &buf[dest];
-        auto sourceptr = destptr + sizeof(T);
+        memmove(data_ + dest, data_ + src, size_ - src);
+        size_ -= sizeof(T);
+    }
+
+    // the raw bytes go in at the offset, the tail of the buffer is moved
+    void insert(size_t offset, const void* ptr, size_t len)
+    {
+        assert(offset <= size_);
+        const size_t prev = size_;
+        expand(len);
 
-        memmove(destptr, sourceptr, size);
-        buf.resize(buf.size() - sizeof(T));
+        memmove(data_ + offset + len, data_ + offset, prev - offset);
+        memcpy(data_ + offset, ptr, len);
+    }
+
+    void erase(size_t offset, size_t len)
+    {
+        assert(offset <= size_ && size_ - offset >= len);
+        memmove(data_ + offset, data_ + offset + len, size_ - offset - len);
+        size_ -= len;
     }
 
     size_t size() const noexcept
     {
-        return buf.size();
+        return size_;
     }
 
     bool empty() const noexcept
     {
-        return buf.empty();
+        return !size_;
     }
 
     size_t capacity() const noexcept
     {
-        return buf.capacity();
+        return capacity_;
     }
 
     const char* ptr(size_t index) const
     {
-        return &buf[index];
+        return data_ + index;
+    }
+
+    // the new bytes are left uninitialized
+    void resize(size_t bytes)
+    {
+        reserve(bytes);
+        size_ = bytes;
     }
 
     void reserve(size_t bytes)
     {
-        buf.reserve(bytes);
+        if (bytes > capacity_)
+        {
+            reallocate(bytes);
+        }
     }
 
+    // makes room for delta more bytes, the capacity grows geometrically
     void grow(size_t delta)
     {
-        reserve(buf.size() + delta);
+        if (capacity_ - size_ < delta)
+        {
+            reallocate(std::max(size_ + delta, 2 * capacity_));
+        }
     }
 
     void clear() noexcept
     {
-        buf.clear();
+        size_ = 0;
+    }
+
+    // the buffer lives in the file from now on, mapped into memory and shared through the page cache: a file written
+    // by a zbuf before is reopened with its contents, which replace the ones of the buffer, an empty file gets the
+    // contents of the buffer; the file grows with ftruncate and mremap (a failing ftruncate throws system_error); the size of the buffer is written down on checkpoint() and close_file(), the contents go to the disk
+    // as the kernel sees fit, or at checkpoint(); there must be only one zbuf writing to the file at a time;
+    // returns false if the file cannot be opened or mapped, or it is not a zbuf file, the buffer is left as it was then
+    bool open_file(const char* path)
+    {
+        const int fd = ::open(path, O_RDWR | O_CREAT, 0644);
+        if (fd < 0)
+        {
+            return false;
+        }
+
+        const bool ret = open_file(fd);
+        ::close(fd);
+        return ret;
+    }
+
+    // the descriptor is duplicated, the caller keeps its own
+    bool open_file(int fd)
+    {
+        struct stat st;
+        if (fstat(fd, &st) != 0)
+        {
+            return false;
+        }
+
+        auto map_size = size_t(st.st_size);
+        const bool fresh = !map_size;
+        if (fresh)
+        {
+            const auto page = page_size();
+            map_size = (file_header_size + size_ + page - 1) / page * page;
+            if (ftruncate(fd, off_t(map_size)) != 0)
+            {
+                return false;
+            }
+        }
+        else if (map_size < file_header_size)
+        {
+            return false;
+        }
+
+        const auto map = static_cast<char*>(mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+        if (map == MAP_FAILED)
+        {
+            return false;
+        }
+
+        file_header header{};
+        if (fresh)
+        {
+            // the buffer goes to the file as it is
+            memcpy(header.magic, file_magic, sizeof(header.magic));
+            header.size = size_;
+            memcpy(map, &header, sizeof(header));
+            if (size_)
+            {
+                memcpy(map + file_header_size, data_, size_);
+            }
+        }
+        else
+        {
+            memcpy(&header, map, sizeof(header));
+        }
+
+        const int own_fd = memcmp(header.magic, file_magic, sizeof(header.magic)) == 0
+            && header.size <= map_size - file_header_size ? dup(fd) : -1;
+        if (own_fd < 0)
+        {
+            munmap(map, map_size);
+            return false;
+        }
+
+        release();
+        fd_ = own_fd;
+        map_ = map;
+        map_size_ = map_size;
+        data_ = map + file_header_size;
+        capacity_ = map_size - file_header_size;
+        size_ = size_t(header.size);
+        return true;
+    }
+
+    // writes the size of the buffer down and flushes the file to the disk
+    bool checkpoint()
+    {
+        if (fd_ < 0)
+        {
+            return false;
+        }
+
+        write_file_header();
+        return msync(map_, map_size_, MS_SYNC) == 0 && fsync(fd_) == 0;
+    }
+
+    // writes the size of the buffer down and unmaps the file, the buffer is back in memory, empty
+    void close_file() noexcept
+    {
+        if (fd_ >= 0)
+        {
+            release();
+            size_ = 0;
+        }
+    }
+
+    bool file_backed() const noexcept
+    {
+        return fd_ >= 0;
     }
 
 private:
-    std::vector<char> buf;
+    // the file starts with the header, the buffer goes right after it
+    struct file_header
+    {
+        char magic[8];
+        uint64_t size;
+    };
+
+    static constexpr char file_magic[8] = {'h', 'a', 'i', 's', 'u', 'z', 'b', '1'};
+    static constexpr size_t file_header_size = 64; // keeps the buffer aligned
+
+    static size_t page_size() noexcept
+    {
+        return size_t(sysconf(_SC_PAGESIZE));
+    }
+
+    void write_file_header() noexcept
+    {
+        file_header header{};
+        memcpy(header.magic, file_magic, sizeof(header.magic));
+        header.size = size_;
+        memcpy(map_, &header, sizeof(header));
+    }
+
+    // the file grows to hold at least bytes, rounded up to the page size
+    void remap_file(size_t bytes)
+    {
+        const auto page = page_size();
+        const auto map_size = (file_header_size + bytes + page - 1) / page * page;
+        if (ftruncate(fd_, off_t(map_size)) != 0)
+        {
+            throw std::system_error(errno, std::generic_category(), "zbuf: ftruncate");
+        }
+
+#ifdef __linux__
+        void* const map = mremap(map_, map_size_, map_size, MREMAP_MAYMOVE);
+#else
+        // the old mapping stays until the new one is there, the buffer is intact if mmap fails
+        void* const map = mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+        if (map != MAP_FAILED)
+        {
+            munmap(map_, map_size_);
+        }
+#endif
+        if (map == MAP_FAILED)
+        {
+            throw std::bad_alloc();
+        }
+
+        map_ = static_cast<char*>(map);
+        map_size_ = map_size;
+        data_ = map_ + file_header_size;
+        capacity_ = map_size - file_header_size;
+    }
+
+    template <typename Arena>
+    static void* alloc_from(void* arena, size_t size)
+    {
+        return static_cast<Arena*>(arena)->alloc(size);
+    }
+
+    // appends len uninitialized bytes, returns the pointer to them
+    char* expand(size_t len)
+    {
+        grow(len);
+        const auto ret = data_ + size_;
+        size_ += len;
+        return ret;
+    }
+
+    void reallocate(size_t bytes)
+    {
+        char* data = nullptr;
+        if (fd_ >= 0)
+        {
+            remap_file(bytes);
+            return;
+        }
+        else if (!data_ && bytes <= inline_capacity)
+        {
+            data_ = inline_;
+            capacity_ = inline_capacity;
+            return;
+        }
+        else if (arena_)
+        {
+            // the arena does not align the memory, the buffer does it itself
+            constexpr size_t alignment = alignof(std::max_align_t);
+            const auto mem = static_cast<char*>(arena_alloc_(arena_, bytes + alignment - 1));
+            if (!mem)
+            {
+                throw std::bad_alloc();
+            }
+            data = mem + (alignment - reinterpret_cast<uintptr_t>(mem) % alignment) % alignment;
+        }
+        else
+        {
+            data = static_cast<char*>(::operator new(bytes));
+        }
+
+        if (size_)
+        {
+            memcpy(data, data_, size_);
+        }
+        release();
+        data_ = data;
+        capacity_ = bytes;
+    }
+
+    // the heap memory is freed, the arena memory is abandoned, the file is unmapped
+    void release() noexcept
+    {
+        if (fd_ >= 0)
+        {
+            write_file_header();
+            munmap(map_, map_size_);
+            ::close(fd_);
+            fd_ = -1;
+            map_ = nullptr;
+            map_size_ = 0;
+        }
+        else if (data_ != inline_ && !arena_)
+        {
+            ::operator delete(data_);
+        }
+        data_ = nullptr;
+        capacity_ = 0;
+    }
+
+    // other's storage is taken over, unless it is inline, other is left empty
+    void take(zbuf& other) noexcept
+    {
+        if (other.data_ == other.inline_)
+        {
+            memcpy(inline_, other.inline_, other.size_);
+            data_ = inline_;
+            capacity_ = inline_capacity;
+        }
+        else
+        {
+            data_ = other.data_;
+            capacity_ = other.capacity_;
+            fd_ = other.fd_;
+            map_ = other.map_;
+            map_size_ = other.map_size_;
+            other.data_ = nullptr;
+            other.capacity_ = 0;
+            other.fd_ = -1;
+            other.map_ = nullptr;
+            other.map_size_ = 0;
+        }
+        size_ = other.size_;
+        other.size_ = 0;
+    }
+
+    char* data_ = nullptr;
+    size_t size_ = 0;
+    size_t capacity_ = 0;
+    void* arena_ = nullptr;
+    void* (*arena_alloc_)(void*, size_t) = nullptr;
+    int fd_ = -1; // the file the buffer lives in, if any
+    char* map_ = nullptr; // the whole file mapped, the header included
+    size_t map_size_ = 0;
+    alignas(std::max_align_t) char inline_[inline_capacity];
 };
 
 template <> inline
 void zbuf::append(const char* t)
 {
-    const size_t prev = buf.size();
-    const size_t sz = strlen(t) + 1;
-    buf.resize(prev + sz);
-    memcpy(&buf[prev], t, sz);
+    append(static_cast<const void*>(t), strlen(t) + 1);
 }
 
 template <> inline
 void zbuf::erase<const char*>(size_t index)
 {
-    const size_t sz = strlen(&buf[index]) + 1;
+    const size_t sz = strlen(data_ + index) + 1;
     const size_t from = index + sz;
     
-    auto dest = &buf[index];
-    auto source = dest + sz;
-    memmove(dest, source, buf.size() - from);
-    buf.resize(buf.size() - sz);
+    memmove(data_ + index, data_ + from, size_ - from);
+    size_ -= sz;
 }
 
 template <> inline
 void zbuf::insert<const char*>(size_t index, const char* t)
 {
-    const size_t prev = buf.size();
     const size_t sz = strlen(t) + 1;
-    buf.resize(prev + sz);
+    const size_t prev = size_;
+    expand(sz);
         
-    auto source = &buf[index];
+    auto source = data_ + index;
     auto dest = source + sz;
     memmove(dest, source, prev - index);
     memcpy(source, t, sz);
@@ -0,0 +1,511 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org/>
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <initializer_list>
+#include <iterator>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "zbuf.h"
+
+namespace haisu
+{
+
+// the sorted map of strings to trivially copyable values, laid out the way zset is: the table of offsets goes first,
+// then the records one after another, a record is the value followed by the null-terminated key;
+// the values are packed, they are copied in and out of the map, there are no references to them
+template <typename V>
+class zmap
+{
+    static_assert(std::is_trivially_copyable<V>{}, "the values are stored as raw bytes");
+
+public:
+    typedef const char* key_type;
+    typedef V mapped_type;
+    typedef std::pair<const char*, V> value_type;
+    typedef std::size_t size_type;
+    typedef int off_t;
+
+    class iterator
+    {
+    public:
+        typedef zmap::value_type value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const value_type* pointer;
+        typedef value_type reference;
+        typedef std::forward_iterator_tag iterator_category;
+
+        iterator() = default;
+
+        value_type operator *() const
+        {
+            return value_type(key(), value());
+        }
+
+        const char* key() const
+        {
+            return m->key_at(pos);
+        }
+
+        V value() const
+        {
+            return m->value_at(pos);
+        }
+
+        bool operator ==(const iterator& other) const noexcept
+        {
+            return m == other.m && pos == other.pos;
+        }
+
+        bool operator !=(const iterator& other) const noexcept
+        {
+            return !(*this == other);
+        }
+
+        iterator& operator ++()
+        {
+            ++pos;
+            return *this;
+        }
+
+        iterator operator ++(int)
+        {
+            iterator prev(*this);
+            ++(*this);
+            return prev;
+        }
+
+    private:
+        iterator(const zmap& m, size_t p) : m(&m), pos(p) { }
+
+        size_t index() const
+        {
+            return pos;
+        }
+
+        const zmap* m = nullptr;
+        size_t pos = 0;
+
+        friend zmap;
+    };
+
+    typedef iterator const_iterator;
+
+    zmap() = default;
+
+    zmap(std::initializer_list<value_type> ll)
+    {
+        assign(ll.begin(), ll.end());
+    }
+
+    template <typename It>
+    zmap(It first, It last)
+    {
+        assign(first, last);
+    }
+
+    // the map is built anew out of the key-value pairs (the keys convertible to std::string_view, no null characters
+    // inside): they are sorted once, the first one of the equal keys is kept, the records are written in a single pass
+    template <typename It>
+    void assign(It first, It last)
+    {
+        auto entries = collect(first, last);
+        std::stable_sort(entries.begin(), entries.end(), key_less());
+        assign_unique(entries);
+    }
+
+    // same as assign(), but the pairs are sorted by the key already
+    template <typename It>
+    void assign_sorted(It first, It last)
+    {
+        auto entries = collect(first, last);
+        assert(std::is_sorted(entries.begin(), entries.end(), key_less()));
+        assign_unique(entries);
+    }
+
+    bool empty() const noexcept
+    {
+        return 0 == _size;
+    }
+
+    size_t size() const noexcept
+    {
+        return _size;
+    }
+
+    size_t capacity() const noexcept
+    {
+        return _buf.capacity();
+    }
+
+    void reserve(size_t bytes)
+    {
+        _buf.reserve(bytes);
+    }
+
+    void clear() noexcept
+    {
+        _buf.clear();
+        _size = 0;
+    }
+
+    // the map is left as it is if the key is there already
+    std::pair<iterator, bool> insert(key_type key, V value)
+    {
+        const size_t pos = lower_pos(key);
+        if (pos < _size && 0 == strcmp(key_at(pos), key))
+        {
+            return {iterator(*this, pos), false};
+        }
+
+        insert_at(pos, key, value);
+        return {iterator(*this, pos), true};
+    }
+
+    std::pair<iterator, bool> insert_or_assign(key_type key, V value)
+    {
+        const size_t pos = lower_pos(key);
+        if (pos < _size && 0 == strcmp(key_at(pos), key))
+        {
+            _buf.store<V>(offset_at(pos), value);
+            return {iterator(*this, pos), false};
+        }
+
+        insert_at(pos, key, value);
+        return {iterator(*this, pos), true};
+    }
+
+    // the pairs are sorted, then merged with the map in a single pass; the keys already in the map keep their values
+    template <typename It>
+    void insert(It first, It last)
+    {
+        auto entries = collect(first, last);
+        std::stable_sort(entries.begin(), entries.end(), key_less());
+        entries.erase(std::unique(entries.begin(), entries.end(), key_equal()), entries.end());
+
+        std::vector<entry> merged;
+        merged.reserve(_size + entries.size());
+        size_t i = 0;
+        for (auto& e : entries)
+        {
+            for (; i < _size && view_at(i) < e.first; ++i)
+            {
+                merged.emplace_back(view_at(i), value_at(i));
+            }
+
+            if (i == _size || view_at(i) != e.first)
+            {
+                merged.push_back(e);
+            }
+        }
+
+        for (; i < _size; ++i)
+        {
+            merged.emplace_back(view_at(i), value_at(i));
+        }
+
+        if (merged.size() != _size)
+        {
+            // the keys being merged may be in the buffer, the buffer is overwritten only after the merge is done
+            zbuf buf;
+            write(buf, merged);
+            _buf = buf;
+            _size = merged.size();
+        }
+    }
+
+    size_t erase(key_type key)
+    {
+        const size_t pos = find_pos(key);
+        if (pos == npos())
+        {
+            return 0;
+        }
+
+        const size_t off = offset_at(pos);
+        const size_t rec = record_size(pos);
+        _buf.erase(off, rec);
+
+        for (size_t i = 0; i < pos; ++i)
+        {
+            _buf.at<off_t>(i) -= sizeof(off_t);
+        }
+
+        for (size_t i = pos + 1; i < _size; ++i)
+        {
+            _buf.at<off_t>(i) -= rec + sizeof(off_t);
+        }
+
+        _buf.erase<off_t>(pos);
+        --_size;
+        return 1;
+    }
+
+    // the value of the key or the default one if there is no such key
+    V get(key_type key, V def = V()) const
+    {
+        const size_t pos = find_pos(key);
+        return pos == npos() ? def : value_at(pos);
+    }
+
+    const char* key_at(size_t index) const
+    {
+        return _buf.ptr(offset_at(index) + sizeof(V));
+    }
+
+    V value_at(size_t index) const
+    {
+        return _buf.load<V>(offset_at(index));
+    }
+
+    size_t count(key_type key) const
+    {
+        return find_pos(key) == npos() ? 0 : 1;
+    }
+
+    const_iterator find(key_type key) const noexcept
+    {
+        const size_t pos = find_pos(key);
+        return pos == npos() ? end() : iterator(*this, pos);
+    }
+
+    const_iterator lower_bound(key_type key) const noexcept
+    {
+        return iterator(*this, lower_pos(key));
+    }
+
+    const_iterator upper_bound(key_type key) const noexcept
+    {
+        return iterator(*this, upper_pos(key));
+    }
+
+    std::pair<const_iterator, const_iterator> equal_range(key_type key) const noexcept
+    {
+        const size_t pos = lower_pos(key);
+        const bool found = pos < _size && 0 == strcmp(key_at(pos), key);
+        return {iterator(*this, pos), iterator(*this, found ? pos + 1 : pos)};
+    }
+
+    const_iterator begin() const noexcept
+    {
+        return iterator(*this, 0);
+    }
+
+    const_iterator end() const noexcept
+    {
+        return iterator(*this, _size);
+    }
+
+    const_iterator cbegin() const noexcept
+    {
+        return begin();
+    }
+
+    const_iterator cend() const noexcept
+    {
+        return end();
+    }
+
+private:
+    typedef std::pair<std::string_view, V> entry;
+
+    struct key_less
+    {
+        bool operator ()(const entry& lhs, const entry& rhs) const noexcept
+        {
+            return lhs.first < rhs.first;
+        }
+    };
+
+    struct key_equal
+    {
+        bool operator ()(const entry& lhs, const entry& rhs) const noexcept
+        {
+            return lhs.first == rhs.first;
+        }
+    };
+
+    template <typename It>
+    static std::vector<entry> collect(It first, It last)
+    {
+        std::vector<entry> ret;
+        if constexpr (std::is_base_of<std::forward_iterator_tag, typename std::iterator_traits<It>::iterator_category>{})
+        {
+            ret.reserve(std::distance(first, last));
+        }
+
+        for (; first != last; ++first)
+        {
+            const auto& e = *first;
+            ret.emplace_back(std::string_view(e.first), V(e.second));
+        }
+        return ret;
+    }
+
+    // the entries are sorted, the equal keys are next to each other
+    void assign_unique(std::vector<entry>& entries)
+    {
+        entries.erase(std::unique(entries.begin(), entries.end(), key_equal()), entries.end());
+        write(_buf, entries);
+        _size = entries.size();
+    }
+
+    // the offset table goes first, then the records one after another
+    static void write(zbuf& buf, const std::vector<entry>& entries)
+    {
+        size_t total = entries.size() * sizeof(off_t);
+        for (auto& e : entries)
+        {
+            total += sizeof(V) + e.first.size() + 1;
+        }
+        assert(total <= size_t(std::numeric_limits<off_t>::max()));
+
+        buf.clear();
+        buf.resize(total);
+
+        auto offset = entries.size() * sizeof(off_t);
+        for (size_t i = 0; i < entries.size(); ++i)
+        {
+            const auto& key = entries[i].first;
+            buf.at<off_t>(i) = static_cast<off_t>(offset);
+            buf.store<V>(offset, entries[i].second);
+
+            auto str = &buf.at<char>(offset + sizeof(V));
+            memcpy(str, key.data(), key.size());
+            str[key.size()] = 0;
+            offset += sizeof(V) + key.size() + 1;
+        }
+    }
+
+    void insert_at(size_t pos, key_type key, V value)
+    {
+        // the key may be in the buffer, which is about to move
+        const bool own = key >= _buf.ptr(0) && key < _buf.ptr(0) + _buf.size();
+        const std::string copy = own ? std::string(key) : std::string();
+        key = own ? copy.c_str() : key;
+
+        const size_t len = strlen(key) + 1;
+        const size_t rec = sizeof(V) + len;
+        const size_t off = pos < _size ? offset_at(pos) : _buf.size();
+
+        _buf.grow(rec + sizeof(off_t));
+        _buf.insert(off, key, len);
+        _buf.insert(off, &value, sizeof(V));
+
+        for (size_t i = 0; i < pos; ++i)
+        {
+            _buf.at<off_t>(i) += sizeof(off_t);
+        }
+
+        for (size_t i = pos; i < _size; ++i)
+        {
+            _buf.at<off_t>(i) += rec + sizeof(off_t);
+        }
+
+        _buf.insert(pos, static_cast<off_t>(off + sizeof(off_t)));
+        ++_size;
+    }
+
+    size_t offset_at(size_t index) const
+    {
+        return _buf.at<off_t>(index);
+    }
+
+    size_t record_size(size_t index) const
+    {
+        const size_t next = index + 1 < _size ? offset_at(index + 1) : _buf.size();
+        return next - offset_at(index);
+    }
+
+    std::string_view view_at(size_t index) const
+    {
+        return std::string_view(key_at(index), record_size(index) - sizeof(V) - 1);
+    }
+
+    size_t lower_pos(key_type key) const
+    {
+        size_t head = 0;
+        size_t count = _size;
+        while (count > 0)
+        {
+            const size_t step = count / 2;
+            if (strcmp(key_at(head + step), key) < 0)
+            {
+                head += step + 1;
+                count -= step + 1;
+            }
+            else
+            {
+                count = step;
+            }
+        }
+        return head;
+    }
+
+    size_t upper_pos(key_type key) const
+    {
+        size_t head = 0;
+        size_t count = _size;
+        while (count > 0)
+        {
+            const size_t step = count / 2;
+            if (strcmp(key_at(head + step), key) <= 0)
+            {
+                head += step + 1;
+                count -= step + 1;
+            }
+            else
+            {
+                count = step;
+            }
+        }
+        return head;
+    }
+
+    size_t find_pos(key_type key) const
+    {
+        const size_t pos = lower_pos(key);
+        return pos < _size && 0 == strcmp(key_at(pos), key) ? pos : npos();
+    }
+
+    static size_t npos()
+    {
+        return std::numeric_limits<size_t>::max();
+    }
+
+    zbuf _buf;
+    size_t _size = 0;
+};
+
+}
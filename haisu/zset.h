@@ -28,6 +28,8 @@ For more information, please refer to <http://unlicense.org/>
 #pragma once
 
 #include <algorithm>
+#include <string_view>
+#include <vector>
 #include "algo.h"
 #include "zbuf.h"
 
@@ -108,10 +110,32 @@ public:
 
     zset(std::initializer_list<key_type> ll)
     {
-        for (auto l : ll)
-        {
-            insert(l);
-        }
+        assign(ll.begin(), ll.end());
+    }
+
+    template <typename It>
+    zset(It first, It last)
+    {
+        assign(first, last);
+    }
+
+    // the set is built anew out of the strings (anything convertible to std::string_view, no null characters inside):
+    // they are sorted and deduplicated once, then the offsets and the strings are written in a single pass
+    template <typename It>
+    void assign(It first, It last)
+    {
+        auto keys = collect(first, last);
+        std::sort(keys.begin(), keys.end());
+        assign_unique(keys);
+    }
+
+    // same as assign(), but the strings are known to be sorted already, the adjacent duplicates are dropped
+    template <typename It>
+    void assign_sorted(It first, It last)
+    {
+        auto keys = collect(first, last);
+        assert(std::is_sorted(keys.begin(), keys.end()));
+        assign_unique(keys);
     }
 
     bool empty() const noexcept
@@ -152,6 +176,7 @@ public:
 
             _buf.insert(_size, static_cast<off_t>(_buf.size() + sizeof(off_t)));
             _buf.append(value);
+            thaw();
 
             ++_size;
         }
@@ -177,6 +202,47 @@ public:
 
             _buf.insert(idx, off + static_cast<off_t>(sizeof(off_t)));
             ++_size;
+            thaw();
+        }
+    }
+
+    // the strings are sorted, then merged with the set in a single pass
+    template <typename It>
+    void insert(It first, It last)
+    {
+        auto keys = collect(first, last);
+        std::sort(keys.begin(), keys.end());
+        keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+        std::vector<std::string_view> merged;
+        merged.reserve(_size + keys.size());
+        size_t i = 0;
+        for (auto key : keys)
+        {
+            for (; i < _size && view_at(i) < key; ++i)
+            {
+                merged.push_back(view_at(i));
+            }
+
+            if (i == _size || view_at(i) != key)
+            {
+                merged.push_back(key);
+            }
+        }
+
+        for (; i < _size; ++i)
+        {
+            merged.push_back(view_at(i));
+        }
+
+        if (merged.size() != _size)
+        {
+            // the strings being merged may be in the buffer, the buffer is overwritten only after the merge is done
+            zbuf buf;
+            write(buf, merged);
+            _buf = buf;
+            _size = merged.size();
+            thaw();
         }
     }
 
@@ -189,6 +255,34 @@ public:
     {
         _buf.clear();
         _size = 0;
+        thaw();
+    }
+
+    // the set lives in the file from now on, an existing one is reopened with its strings (the strings of the set are
+    // dropped then), an empty one gets the strings of the set, see zbuf::open_file()
+    bool open_file(const char* path)
+    {
+        if (!_buf.open_file(path))
+        {
+            return false;
+        }
+
+        // the offset table goes first, the first string follows it
+        _size = _buf.empty() ? 0 : _buf.at<off_t>(0) / sizeof(off_t);
+        thaw();
+        return true;
+    }
+
+    bool checkpoint()
+    {
+        return _buf.checkpoint();
+    }
+
+    void close_file() noexcept
+    {
+        _buf.close_file();
+        _size = 0;
+        thaw();
     }
 
     void erase(value_type value)
@@ -214,6 +308,7 @@ public:
 
             _buf.erase<off_t>(found);
             --_size;
+            thaw();
         }
     }
 
@@ -224,14 +319,35 @@ public:
 
     const_iterator lower_bound(key_type key) const noexcept
     {
-        return std::lower_bound(begin(), end(), key, 
-            [](auto lhs, auto rhs){return strcmp(lhs, rhs) < 0;});
+        if (frozen())
+        {
+            return frozen_bound<false>(key);
+        }
+
+        return iterator_at(bound_pos<false>(key));
     }
 
     const_iterator upper_bound(key_type key) const noexcept
     {
-        return std::upper_bound(begin(), end(), key, 
-            [](auto lhs, auto rhs){return strcmp(lhs, rhs) < 0;});
+        if (frozen())
+        {
+            return frozen_bound<true>(key);
+        }
+
+        return iterator_at(bound_pos<true>(key));
+    }
+
+    // the strings starting with the prefix, an empty prefix makes the whole set
+    std::pair<const_iterator, const_iterator> prefix_range(key_type prefix) const
+    {
+        const auto last = algo::prefix_successor(prefix);
+        return {lower_bound(prefix), last.empty() ? end() : lower_bound(last.c_str())};
+    }
+
+    bool starts_with(key_type prefix) const
+    {
+        const auto found = lower_bound(prefix);
+        return found != end() && 0 == strncmp(*found, prefix, strlen(prefix));
     }
 
     const_iterator end() const noexcept
@@ -261,6 +377,13 @@ public:
 
     std::pair<const_iterator, const_iterator> equal_range(key_type key) const noexcept
     {
+        if (frozen())
+        {
+            auto lower = frozen_bound<false>(key);
+            auto upper = lower;
+            return {lower, lower != end() && strcmp(*lower, key) == 0 ? ++upper : upper};
+        }
+
         return std::equal_range(begin(), end(), key, 
             [](auto lhs, auto rhs){return strcmp(lhs, rhs) < 0;});
     }
@@ -276,18 +399,254 @@ public:
         return end();
     }
 
+    // builds a read-optimized search index, the lookups use it until the set is modified next time;
+    // the index is an eytzinger-ordered (breadth-first) array of 8-byte key prefixes with the string positions next to them,
+    // so that most of the comparisons are integer ones, only the equal prefixes make a trip to the strings
+    void freeze()
+    {
+        _index.clear();
+        _index.append_n<index_entry>(_size + 1);
+        _index.at<index_entry>(0) = index_entry{};
+
+        size_t pos = 0;
+        place_index(pos, 1);
+        prefix_index(1, npos(), npos());
+    }
+
+    // drops the search index, any modification of the set does that as well
+    void thaw() noexcept
+    {
+        _index.clear();
+    }
+
+    bool frozen() const noexcept
+    {
+        return !_index.empty();
+    }
+
 private:
 
+    struct index_entry
+    {
+        uint64_t prefix;
+        off_t pos;
+        off_t depth;
+    };
+
+    // 8 characters starting at the depth packed big-endian style (zero-padded),
+    // the integers compare the same way the strings do
+    static uint64_t key_prefix(const char* key, size_t len, size_t depth) noexcept
+    {
+        uint64_t ret = 0;
+        if (len >= depth + 8)
+        {
+            memcpy(&ret, key + depth, sizeof(ret));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+            ret = __builtin_bswap64(ret);
+#endif
+        }
+        else
+        {
+            for (size_t i = depth; i < len; ++i)
+            {
+                ret |= uint64_t(uint8_t(key[i])) << (56 - 8 * (i - depth));
+            }
+        }
+        return ret;
+    }
+
+    // in-order traversal of the implicit tree puts the sorted strings into breadth-first order
+    void place_index(size_t& pos, size_t k)
+    {
+        if (k <= _size)
+        {
+            place_index(pos, 2 * k);
+            _index.at<index_entry>(k).pos = static_cast<off_t>(pos++);
+            place_index(pos, 2 * k + 1);
+        }
+    }
+
+    // a key reaching a node lies between the strings the descent turned at last (lower and upper),
+    // so it shares their common prefix with every string of the subtree, the node compares the characters past it
+    void prefix_index(size_t k, size_t lower, size_t upper)
+    {
+        if (k <= _size)
+        {
+            auto& entry = _index.at<index_entry>(k);
+            const auto str = view_at(entry.pos);
+
+            size_t depth = 0;
+            if (lower != npos() && upper != npos())
+            {
+                const auto lo = view_at(lower);
+                const auto hi = view_at(upper);
+                const size_t len = std::min(lo.size(), hi.size());
+                while (depth < len && lo[depth] == hi[depth])
+                {
+                    ++depth;
+                }
+            }
+
+            entry.depth = static_cast<off_t>(depth);
+            entry.prefix = key_prefix(str.data(), str.size(), depth);
+
+            prefix_index(2 * k, lower, entry.pos);
+            prefix_index(2 * k + 1, entry.pos, upper);
+        }
+    }
+
+    // the three-way comparison of the indexed string and the key, the prefixes being equal;
+    // a prefix shorter than 8 characters ends the string, both of the strings are equal then
+    int compare_tail(const index_entry& entry, const char* key) const noexcept
+    {
+        if ((entry.prefix & 0xff) == 0)
+        {
+            return 0;
+        }
+
+        const size_t skip = entry.depth + 8;
+        return strcmp(at(entry.pos) + skip, key + skip);
+    }
+
+    // descends the eytzinger tree, the lower bound is the last node the key went left at (upper bound if Upper)
+    template <bool Upper>
+    const_iterator frozen_bound(key_type key) const noexcept
+    {
+        const size_t len = strlen(key);
+        const index_entry* index = &_index.at<index_entry>(0);
+
+        size_t k = 1;
+        while (k <= _size)
+        {
+            // the grandchildren of a node sit next to each other, 4 entries make a cache line
+            __builtin_prefetch(index + 4 * k);
+
+            const auto& entry = index[k];
+            const uint64_t prefix = key_prefix(key, len, entry.depth);
+            bool less = entry.prefix < prefix;
+            if (entry.prefix == prefix)
+            {
+                const int cmp = compare_tail(entry, key);
+                less = Upper ? cmp <= 0 : cmp < 0;
+            }
+
+            k = 2 * k + less;
+        }
+
+        // drops the trailing right turns and the last left one
+        k >>= __builtin_ctzll(~k) + 1;
+        return k == 0 ? end() : iterator(*this, index[k].pos);
+    }
+
+    size_t frozen_find(key_type key) const noexcept
+    {
+        auto found = frozen_bound<false>(key);
+        if (found != end() && strcmp(*found, key) == 0)
+        {
+            return found.index();
+        }
+
+        return npos();
+    }
+
+    template <typename It>
+    static std::vector<std::string_view> collect(It first, It last)
+    {
+        std::vector<std::string_view> ret;
+        if constexpr (std::is_base_of<std::forward_iterator_tag, typename std::iterator_traits<It>::iterator_category>{})
+        {
+            ret.reserve(std::distance(first, last));
+        }
+
+        for (; first != last; ++first)
+        {
+            ret.emplace_back(*first);
+        }
+        return ret;
+    }
+
+    // the keys are sorted, the duplicates are next to each other
+    void assign_unique(std::vector<std::string_view>& keys)
+    {
+        keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+        write(_buf, keys);
+        _size = keys.size();
+        thaw();
+    }
+
+    // the offset table goes first, then the strings one after another, all null-terminated
+    static void write(zbuf& buf, const std::vector<std::string_view>& keys)
+    {
+        size_t total = keys.size() * sizeof(off_t);
+        for (auto key : keys)
+        {
+            total += key.size() + 1;
+        }
+        assert(total <= size_t(std::numeric_limits<off_t>::max()));
+
+        buf.clear();
+        buf.resize(total);
+
+        auto offset = keys.size() * sizeof(off_t);
+        for (size_t i = 0; i < keys.size(); ++i)
+        {
+            buf.at<off_t>(i) = static_cast<off_t>(offset);
+            auto str = &buf.at<char>(offset);
+            memcpy(str, keys[i].data(), keys[i].size());
+            str[keys[i].size()] = 0;
+            offset += keys[i].size() + 1;
+        }
+    }
+
+    std::string_view view_at(size_t index) const
+    {
+        return std::string_view(at(index), size_at(index));
+    }
+
+    const_iterator iterator_at(size_t pos) const noexcept
+    {
+        return pos < _size ? iterator(*this, pos) : end();
+    }
+
+    // the first string not less than the key (greater than if Upper)
+    template <bool Upper>
+    size_t bound_pos(key_type key) const noexcept
+    {
+        size_t head = 0;
+        size_t count = _size;
+        while (count > 0)
+        {
+            const size_t step = count / 2;
+            const int cmp = strcmp(at(head + step), key);
+            if (Upper ? cmp <= 0 : cmp < 0)
+            {
+                head += step + 1;
+                count -= step + 1;
+            }
+            else
+            {
+                count = step;
+            }
+        }
+        return head;
+    }
+
     size_t find_pos(key_type key) const
     {
+        if (frozen())
+        {
+            return frozen_find(key);
+        }
+
         return algo::binary_search(*this, key);
     }
 
+    // the length of the string, the null-terminator is not counted
     size_t size_at(size_t pos) const
     {
         if (pos != _size - 1)
         {
-            return _buf.at<off_t>(pos + 1) - _buf.at<off_t>(pos);
+            return _buf.at<off_t>(pos + 1) - _buf.at<off_t>(pos) - 1;
         }
         else
         {
@@ -302,6 +661,7 @@ private:
 
     zbuf _buf;
     size_t _size = 0;
+    zbuf _index;
 };
 
 }
@@ -0,0 +1,164 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+#include "haisu/fcset.h"
+#include "haisu/zset.h"
+
+struct fcset_test: ::testing::Test
+{
+    haisu::fcset s;
+
+    static std::vector<std::string> urls()
+    {
+        std::vector<std::string> ret;
+        for (int i = 0; i < 300; ++i)
+        {
+            ret.push_back("http://example.com/path/" + std::to_string(i % 7) + "/item" + std::to_string(i));
+        }
+        ret.push_back("");
+        ret.push_back("http://example.com");
+        ret.push_back("http://example.org/");
+        ret.push_back("\xff");
+        ret.push_back("\xff\xff" "a");
+        return ret;
+    }
+
+    template <typename Range>
+    static std::vector<std::string> collect(Range range)
+    {
+        std::vector<std::string> ret;
+        for (auto i = range.first; i != range.second; ++i)
+        {
+            ret.push_back(*i);
+        }
+        return ret;
+    }
+};
+
+TEST_F(fcset_test, newly_created_set_is_empty)
+{
+    EXPECT_TRUE(s.empty());
+    EXPECT_EQ(0u, s.size());
+    EXPECT_EQ(s.end(), s.begin());
+    EXPECT_EQ(s.end(), s.lower_bound("a"));
+    EXPECT_FALSE(s.starts_with(""));
+}
+
+TEST_F(fcset_test, iterates_sorted_unique_strings)
+{
+    s = {"abd", "abc", "b", "abc", "", "a"};
+
+    std::vector<std::string> items(s.begin(), s.end());
+    const std::vector<std::string> expected{"", "a", "abc", "abd", "b"};
+    EXPECT_EQ(expected, items);
+}
+
+TEST_F(fcset_test, finds_strings_across_blocks)
+{
+    auto keys = urls();
+    s.assign(keys.begin(), keys.end());
+    EXPECT_EQ(keys.size(), s.size());
+
+    for (auto& k : keys)
+    {
+        auto found = s.find(k.c_str());
+        ASSERT_NE(s.end(), found) << k;
+        EXPECT_EQ(k, *found);
+    }
+
+    EXPECT_EQ(0u, s.count("http://example.com/path/1/item"));
+    EXPECT_EQ(0u, s.count("http://example.com/path/1/item10000"));
+    EXPECT_EQ(0u, s.count("a"));
+}
+
+TEST_F(fcset_test, bounds_match_zset)
+{
+    auto keys = urls();
+    haisu::zset z(keys.begin(), keys.end());
+    s.assign_sorted(z.begin(), z.end());
+
+    auto probes = keys;
+    for (auto& k : keys)
+    {
+        probes.push_back(k + "0");
+        probes.push_back(k.substr(0, k.size() / 2));
+        probes.push_back(k.substr(0, k.size() - k.size() / 4));
+    }
+
+    const auto str = [](auto i, auto end) { return i == end ? std::string("end") : std::string(*i); };
+    for (auto& p : probes)
+    {
+        const char* key = p.c_str();
+        ASSERT_EQ(str(z.lower_bound(key), z.end()), str(s.lower_bound(key), s.end())) << p;
+        ASSERT_EQ(str(z.upper_bound(key), z.end()), str(s.upper_bound(key), s.end())) << p;
+        ASSERT_EQ(str(z.equal_range(key).second, z.end()), str(s.equal_range(key).second, s.end())) << p;
+        ASSERT_EQ(collect(z.prefix_range(key)), collect(s.prefix_range(key))) << p;
+        ASSERT_EQ(z.starts_with(key), s.starts_with(key)) << p;
+    }
+}
+
+TEST_F(fcset_test, returns_prefix_range)
+{
+    s = {"http://a.com/", "http://a.com/x", "http://a.com/y", "http://b.com/", "ftp://a.com/"};
+
+    const std::vector<std::string> a{"http://a.com/", "http://a.com/x", "http://a.com/y"};
+    EXPECT_EQ(a, collect(s.prefix_range("http://a.com/")));
+    EXPECT_EQ(4u, collect(s.prefix_range("http://")).size());
+    EXPECT_EQ(5u, collect(s.prefix_range("")).size());
+    EXPECT_TRUE(collect(s.prefix_range("http://c")).empty());
+
+    EXPECT_TRUE(s.starts_with("ftp:"));
+    EXPECT_TRUE(s.starts_with("http://a.com/x"));
+    EXPECT_FALSE(s.starts_with("http://a.com/xy"));
+    EXPECT_FALSE(s.starts_with("https"));
+}
+
+TEST_F(fcset_test, takes_less_memory_than_zset_for_shared_prefixes)
+{
+    std::vector<std::string> keys;
+    for (int i = 0; i < 10000; ++i)
+    {
+        keys.push_back("https://cdn.example.org/static/images/thumbnails/" + std::to_string(i));
+    }
+
+    haisu::zset z(keys.begin(), keys.end());
+    s.assign_sorted(z.begin(), z.end());
+
+    EXPECT_LT(3 * s.capacity(), z.capacity());
+}
+
+TEST_F(fcset_test, stores_long_strings)
+{
+    const std::string a(1000, 'a');
+    const std::string b = a + std::string(300, 'b');
+    s = {a.c_str(), b.c_str(), "c"};
+
+    ASSERT_EQ(3u, s.size());
+    EXPECT_EQ(1u, s.count(b.c_str()));
+    EXPECT_EQ(b, *s.upper_bound(a.c_str()));
+}
@@ -120,3 +120,78 @@ TEST_F(json_bitstack_test, bitstack_63_specialization)
     }
 }
 
+
+TEST_F(json_bitstack_test, packed_stack_keeps_two_bits_per_level)
+{
+    haisu::json::packed_stack<64> stack;
+    EXPECT_TRUE(stack.empty());
+
+    for (int i = 0; i < 1000; ++i)
+    {
+        stack.push(i % 4);
+        EXPECT_EQ(i % 4, stack.top());
+    }
+    EXPECT_EQ(1000u, stack.size());
+
+    for (int i = 999; i >= 0; --i)
+    {
+        EXPECT_EQ(i % 4, stack.top());
+        stack.pop();
+    }
+    EXPECT_TRUE(stack.empty());
+}
+
+TEST_F(json_bitstack_test, packed_stack_replaces_top)
+{
+    haisu::json::packed_stack<64> stack;
+    for (int i = 0; i < 33; ++i)
+    {
+        stack.push(3);
+    }
+
+    stack.replace_top(1);
+    EXPECT_EQ(1, stack.top());
+    stack.pop();
+    EXPECT_EQ(3, stack.top());
+}
+
+TEST_F(json_bitstack_test, packed_stack_goes_up_and_down_word_boundary)
+{
+    haisu::json::packed_stack<1> stack;
+    for (int i = 0; i < 32; ++i)
+    {
+        stack.push(2);
+    }
+
+    for (int i = 0; i < 10; ++i)
+    {
+        stack.push(1);
+        EXPECT_EQ(1, stack.top());
+        stack.pop();
+        EXPECT_EQ(2, stack.top());
+        EXPECT_EQ(32u, stack.size());
+    }
+}
+
+TEST_F(json_bitstack_test, packed_stack_is_reused_after_clear)
+{
+    haisu::json::packed_stack<64> stack;
+    for (int round = 0; round < 2; ++round)
+    {
+        for (int i = 0; i < 500; ++i)
+        {
+            stack.push((i + round) % 4);
+        }
+
+        for (int i = 499; i >= 0; --i)
+        {
+            ASSERT_EQ((i + round) % 4, stack.top());
+            stack.pop();
+        }
+
+        stack.push(1);
+        stack.clear();
+        EXPECT_TRUE(stack.empty());
+        EXPECT_EQ(0u, stack.size());
+    }
+}
@@ -24,6 +24,10 @@ OTHER DEALINGS IN THE SOFTWARE.
 */
 #include <gtest/gtest.h>
 
+#include <cstdio>
+#include <string>
+#include <vector>
+
 #include "haisu/json_model.h"
 
 struct json_model_test : ::testing::Test
@@ -85,3 +89,251 @@ TEST_F(json_model_test, counts_array_items)
     model.parse("['a','b','c']");
     EXPECT_EQ(3, model.root().count_array());
 }
+
+TEST_F(json_model_test, gets_child_of_large_object)
+{
+    std::string doc = "{";
+    for (int i = 0; i < 100; ++i)
+    {
+        doc += (i ? ", '" : "'") + std::to_string(i) + "' : {'v' : 'x'}";
+    }
+    doc += ", 'last' : {'v' : 'y'}}";
+
+    model.parse(doc.c_str());
+    for (int i = 0; i < 100; ++i)
+    {
+        const auto key = std::to_string(i);
+        EXPECT_TRUE(model.has_key(key.c_str()));
+        EXPECT_TRUE(model.child(key.c_str()).has_key("v"));
+    }
+    EXPECT_TRUE(model.has_key("last"));
+    EXPECT_FALSE(model.has_key("100"));
+    EXPECT_FALSE(model.has_key(""));
+    EXPECT_EQ(101, model.root().count());
+}
+
+TEST_F(json_model_test, looks_up_precomputed_keys)
+{
+    static constexpr haisu::json::key a{"a"};
+    static constexpr haisu::json::key b{"b"};
+    static_assert(a.hash != b.hash, "");
+
+    model.parse("{'a':{'b':'c'}}");
+    EXPECT_TRUE(model.has_key(a));
+    EXPECT_FALSE(model.has_key(b));
+    EXPECT_TRUE(model.child(a).has_key(b));
+}
+
+TEST(json_model_index_test, indexed_and_linear_lookups_agree)
+{
+    // duplicate keys and a few more keys than the threshold
+    std::string doc = "{'dup' : {'first' : 1}";
+    for (int i = 0; i < 20; ++i)
+    {
+        doc += ", 'k" + std::to_string(i) + "' : {'i' : " + std::to_string(i) + "}";
+    }
+    doc += ", 'dup' : {'second' : 2}, 'nested' : {'a' : {'x' : 1}, 'b' : {'y' : 2}}}";
+
+    haisu::json::model indexed(4);
+    haisu::json::model linear(1000);
+    indexed.parse(doc.c_str());
+    linear.parse(doc.c_str());
+
+    for (const char* key : {"dup", "k0", "k19", "k20", "nested", "i", ""})
+    {
+        EXPECT_EQ(linear.has_key(key), indexed.has_key(key)) << key;
+        EXPECT_EQ(linear.child(key).count(), indexed.child(key).count()) << key;
+    }
+    EXPECT_TRUE(indexed.child("dup").has_key("first"));
+    EXPECT_TRUE(indexed.child("nested").child("b").has_key("y"));
+}
+
+TEST_F(json_model_test, indexes_array_items)
+{
+    model.parse("['a', 1.5, null, -7, 'e']");
+    const auto root = model.root();
+    ASSERT_EQ(5, root.count_array());
+    EXPECT_EQ("a", root[0].literal());
+    EXPECT_TRUE(root[0].is_string());
+    EXPECT_EQ(1.5, root[1].as_double());
+    EXPECT_TRUE(root[2].is_null());
+    EXPECT_EQ(-7, root[3].as_int64());
+    EXPECT_EQ("-7", root[3].literal());
+    EXPECT_EQ("e", root[4].literal());
+    EXPECT_TRUE(root[5].empty());
+}
+
+TEST_F(json_model_test, iterates_over_array_items)
+{
+    std::string doc = "{'series' : [0";
+    for (int i = 1; i < 10000; ++i)
+    {
+        doc += ", " + std::to_string(i);
+    }
+    doc += "], 'empty' : []}";
+    model.parse(doc.c_str());
+
+    const auto series = model.root().child("series");
+    ASSERT_EQ(10000, series.count_array());
+    EXPECT_EQ(5000, series[5000].as_int64());
+
+    int64_t expected = 0;
+    for (auto item : series)
+    {
+        EXPECT_EQ(expected++, item.as_int64());
+    }
+    EXPECT_EQ(10000, expected);
+
+    const auto empty = model.root().child("empty");
+    EXPECT_EQ(0, empty.count_array());
+    EXPECT_TRUE(empty.begin() == empty.end());
+}
+
+TEST_F(json_model_test, indexes_nested_arrays)
+{
+    model.parse("{'a' : ['x', ['y', 'z'], 'w']}");
+    const auto a = model.root().child("a");
+    ASSERT_EQ(3, a.count_array());
+    EXPECT_EQ("x", a[0].literal());
+    ASSERT_TRUE(a[1].is_array());
+    EXPECT_EQ(2, a[1].count_array());
+    EXPECT_EQ("z", a[1][1].literal());
+    EXPECT_EQ("w", a[2].literal());
+}
+
+TEST_F(json_model_test, indexes_mixed_array_items)
+{
+    model.parse("[1, true, 3, [4], 5, {'k' : false}, {}, null, false, []]");
+    const auto root = model.root();
+    ASSERT_EQ(10, root.count_array());
+    EXPECT_EQ(1, root[0].as_int64());
+    EXPECT_TRUE(root[1].is_bool());
+    EXPECT_TRUE(root[1].as_bool());
+    EXPECT_EQ(3, root[2].as_int64());
+    EXPECT_EQ(4, root[3][0].as_int64());
+    EXPECT_EQ(5, root[4].as_int64());
+    EXPECT_TRUE(root[5].is_object());
+    EXPECT_TRUE(root[5].child("k").is_bool());
+    EXPECT_FALSE(root[5].child("k").as_bool());
+    EXPECT_TRUE(root[6].is_object());
+    EXPECT_EQ(0, root[6].count());
+    EXPECT_TRUE(root[7].is_null());
+    EXPECT_TRUE(root[8].is_bool());
+    EXPECT_FALSE(root[8].as_bool());
+    EXPECT_TRUE(root[9].is_array());
+    EXPECT_EQ(0, root[9].count_array());
+
+    int items = 0;
+    for (auto item : root)
+    {
+        EXPECT_FALSE(item.empty());
+        ++items;
+    }
+    EXPECT_EQ(10, items);
+}
+
+TEST_F(json_model_test, gets_scalar_members)
+{
+    model.parse("{'a' : 1, 'b' : 'x', 'c' : true, 'd' : null, 'e' : {}, 'f' : -2.5, 'g' : false}");
+    const auto root = model.root();
+
+    EXPECT_TRUE(root.child("a").is_number());
+    EXPECT_FALSE(root.child("a").is_object());
+    EXPECT_EQ(1, root.child("a").as_int64());
+    EXPECT_EQ("x", root.child("b").literal());
+    EXPECT_TRUE(root.child("c").as_bool());
+    EXPECT_TRUE(root.child("d").is_null());
+    EXPECT_TRUE(root.child("e").is_object());
+    EXPECT_EQ(0, root.child("e").count());
+    EXPECT_FALSE(root.child("e").has_key("f"));
+    EXPECT_EQ(-2.5, root.child("f").as_double());
+    EXPECT_TRUE(root.child("g").is_bool());
+    EXPECT_EQ(7, root.count());
+}
+
+static std::string snapshot_json()
+{
+    std::string doc = "{'name' : 'config', 'ports' : [80, 443, 8080], 'limits' : {";
+    for (int i = 0; i < 50; ++i)
+    {
+        doc += (i ? ", 'l" : "'l") + std::to_string(i) + "' : {'max' : 'v" + std::to_string(i) + "'}";
+    }
+    return doc + "}}";
+}
+
+static void expect_snapshot_json(const haisu::json::model_snapshot& snapshot)
+{
+    EXPECT_TRUE(snapshot.has_key("name"));
+    EXPECT_FALSE(snapshot.has_key("nope"));
+    EXPECT_EQ("config", snapshot.child("name").literal());
+
+    const auto ports = snapshot.child("ports");
+    ASSERT_EQ(3, ports.count_array());
+    EXPECT_EQ(443, ports[1].as_int64());
+
+    int64_t sum = 0;
+    for (auto port : ports)
+    {
+        sum += port.as_int64();
+    }
+    EXPECT_EQ(80 + 443 + 8080, sum);
+
+    const auto limits = snapshot.child("limits");
+    EXPECT_EQ(50, limits.count());
+    EXPECT_EQ("v42", limits.child("l42").child("max").literal());
+    static constexpr haisu::json::key l7{"l7"};
+    EXPECT_EQ("v7", limits.child(l7).child("max").literal());
+}
+
+TEST(json_model_snapshot_test, maps_snapshot_file)
+{
+    FILE* file = std::tmpfile();
+    ASSERT_TRUE(file);
+
+    {
+        auto doc = snapshot_json();
+        haisu::json::model model;
+        model.parse(doc.c_str());
+        ASSERT_TRUE(model.write(fileno(file)));
+        doc.assign(doc.size(), 'x'); // the snapshot does not refer to the json text
+    }
+
+    haisu::json::model_snapshot snapshot;
+    ASSERT_TRUE(snapshot.open(fileno(file)));
+    expect_snapshot_json(snapshot);
+    std::fclose(file);
+}
+
+TEST(json_model_snapshot_test, reads_snapshot_from_memory)
+{
+    FILE* file = std::tmpfile();
+    ASSERT_TRUE(file);
+
+    const auto doc = snapshot_json();
+    haisu::json::model model;
+    model.parse(doc.c_str());
+    ASSERT_TRUE(model.write(fileno(file)));
+
+    const auto size = std::ftell(file);
+    std::vector<uint64_t> mem(size / sizeof(uint64_t) + 1);
+    std::rewind(file);
+    ASSERT_EQ(size_t(size), std::fread(mem.data(), 1, size, file));
+    std::fclose(file);
+
+    haisu::json::model_snapshot snapshot;
+    ASSERT_TRUE(snapshot.assign(mem.data(), size));
+    expect_snapshot_json(snapshot);
+
+    EXPECT_FALSE(snapshot.assign(mem.data(), size - 1));
+    EXPECT_TRUE(snapshot.root().empty());
+
+    reinterpret_cast<char*>(mem.data())[0] ^= 1;
+    EXPECT_FALSE(snapshot.assign(mem.data(), size));
+}
+
+TEST(json_model_snapshot_test, rejects_missing_file)
+{
+    haisu::json::model_snapshot snapshot;
+    EXPECT_FALSE(snapshot.open("/nonexistent/snapshot"));
+    EXPECT_TRUE(snapshot.root().empty());
+}
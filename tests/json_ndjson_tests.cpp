@@ -0,0 +1,318 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org/>
+*/
+
+// clang-format off
+
+#include <gtest/gtest.h>
+#include <random>
+
+#include "haisu/json_ndjson.h"
+
+using string_view = std::string_view;
+
+struct ndjson_test : ::testing::Test
+{
+    std::vector<std::string> split(const std::string& buf)
+    {
+        std::vector<std::string> ret;
+        for (auto rec : haisu::json::split_records(buf))
+        {
+            ret.emplace_back(rec);
+        }
+        return ret;
+    }
+};
+
+struct counter : haisu::json::parser<counter>
+{
+    void on_new_object()
+    {
+        ++objects;
+    }
+
+    void on_value(haisu::json::numeric_literal lit)
+    {
+        sum += std::stol(std::string(lit.view));
+    }
+
+    void on_error(haisu::json::error)
+    {
+        ++errors;
+    }
+
+    size_t objects = 0;
+    long sum = 0;
+    size_t errors = 0;
+};
+
+TEST_F(ndjson_test, splits_lines)
+{
+    using v = std::vector<std::string>;
+    EXPECT_EQ((v{"{}", "[]"}), split("{}\n[]"));
+    EXPECT_EQ((v{"{}", "[]"}), split("{}\n[]\n"));
+    EXPECT_EQ((v{"{}", "[]"}), split("\n\n{}\n  \n\t\n[]\n\n"));
+    EXPECT_EQ((v{"{}\r", "[]\r"}), split("{}\r\n[]\r\n"));
+    EXPECT_EQ(v{}, split(""));
+    EXPECT_EQ(v{}, split("\n \n"));
+}
+
+TEST_F(ndjson_test, ends_record_at_every_newline)
+{
+    using v = std::vector<std::string>;
+    EXPECT_EQ((v{"{\"a", "\":\"b", "c\"}", "[]"}), split("{\"a\n\":\"b\nc\"}\n[]"));
+    EXPECT_EQ((v{"[\"\\\"", "\"]", "[]"}), split("[\"\\\"\n\"]\n[]"));
+    EXPECT_EQ((v{"[\"\\\\\"]", "[\"\\\\\\\\\"]"}), split("[\"\\\\\"]\n[\"\\\\\\\\\"]"));
+}
+
+TEST_F(ndjson_test, isolates_record_with_unbalanced_quote)
+{
+    using v = std::vector<std::string>;
+    EXPECT_EQ((v{"{\"a\":1}", "{\"a\":\"x}", "{\"a\":2}", "{\"a\":3}"}),
+        split("{\"a\":1}\n{\"a\":\"x}\n{\"a\":2}\n{\"a\":3}"));
+
+    std::string buf;
+    for (int i = 0; i < 1000; ++i)
+    {
+        buf += i == 500 ? "{\"a\":\"unterminated}\n" : "{\"a\":" + std::to_string(i) + "}\n";
+    }
+
+    for (size_t shards : {1, 3})
+    {
+        const auto handlers = haisu::json::parse_records<counter>(buf, shards, 100);
+
+        size_t objects = 0;
+        long sum = 0;
+        size_t errors = 0;
+        for (auto& h : handlers)
+        {
+            objects += h.objects;
+            sum += h.sum;
+            errors += h.errors;
+        }
+
+        EXPECT_EQ(1000u, objects);
+        EXPECT_EQ(1000l * 999 / 2 - 500, sum);
+        EXPECT_EQ(1u, errors);
+    }
+}
+
+TEST_F(ndjson_test, computes_escaped_characters)
+{
+    std::mt19937 rnd(7);
+    std::string buf(64 * 64, ' ');
+    for (auto& ch : buf)
+    {
+        ch = rnd() % 3 ? '\\' : 'a';
+    }
+
+    // reference: a backslash escapes the next character unless it is escaped itself
+    std::vector<bool> expected(buf.size());
+    for (size_t i = 0; i < buf.size(); ++i)
+    {
+        if (buf[i] == '\\' && !expected[i] && i + 1 < buf.size())
+        {
+            expected[i + 1] = true;
+        }
+    }
+
+    haisu::json::simd::string_scanner scanner;
+    for (size_t block = 0; block < buf.size(); block += 64)
+    {
+        uint64_t backslash = 0;
+        for (int i = 0; i < 64; ++i)
+        {
+            backslash |= uint64_t(buf[block + i] == '\\') << i;
+        }
+
+        const auto escaped = scanner.escaped(backslash);
+        for (int i = 0; i < 64; ++i)
+        {
+            ASSERT_EQ(expected[block + i], !!(escaped & (uint64_t{1} << i))) << block + i;
+        }
+    }
+}
+
+TEST_F(ndjson_test, parses_records_on_many_threads)
+{
+    std::string buf;
+    for (int i = 0; i < 10000; ++i)
+    {
+        buf += "{\"a\":" + std::to_string(i) + ",\"s\":\"x\\\"y\"}\n";
+    }
+
+    for (size_t shards : {1, 2, 4, 7})
+    {
+        const auto handlers = haisu::json::parse_records<counter>(buf, shards, 16);
+        ASSERT_EQ(shards, handlers.size());
+
+        size_t objects = 0;
+        long sum = 0;
+        size_t errors = 0;
+        for (auto& h : handlers)
+        {
+            objects += h.objects;
+            sum += h.sum;
+            errors += h.errors;
+        }
+
+        EXPECT_EQ(10000u, objects);
+        EXPECT_EQ(10000l * 9999 / 2, sum);
+        EXPECT_EQ(0u, errors);
+    }
+}
+
+TEST_F(ndjson_test, does_not_start_more_shards_than_needed)
+{
+    const auto handlers = haisu::json::parse_records<counter>("{}\n{}", 8, 64);
+    ASSERT_EQ(1u, handlers.size());
+    EXPECT_EQ(2u, handlers[0].objects);
+}
+
+template <typename... Policies>
+struct recovering_counter : haisu::json::parser<recovering_counter<Policies...>, 63, haisu::json::recovering, Policies...>
+{
+    void on_new_object()
+    {
+        ++objects;
+    }
+
+    void on_value(haisu::json::numeric_literal lit)
+    {
+        sum += std::stol(std::string(lit.view));
+    }
+
+    void on_error(haisu::json::error err)
+    {
+        errors.push_back({err.position - begin, err.record - begin});
+    }
+
+    void parse(const std::string& buf)
+    {
+        begin = buf.data();
+        recovering_counter::parser::parse(buf);
+    }
+
+    void parse(const char* str)
+    {
+        begin = str;
+        recovering_counter::parser::parse(str);
+    }
+
+    const char* begin = nullptr;
+    size_t objects = 0;
+    long sum = 0;
+    std::vector<std::pair<long, long>> errors; // the offsets of the error and of the record
+};
+
+TEST_F(ndjson_test, recovers_from_malformed_records)
+{
+    const std::string buf = "{\"a\":1}\n{\"a\":2]}\n{\"a\":4}\n{\"a\":[8\n{\"a\":16} x\n{\"a\":32}";
+
+    recovering_counter<> p;
+    p.parse(buf);
+    EXPECT_EQ(1 + 2 + 4 + 16 + 32, p.sum); // 8 is cut short before it gets delivered
+    EXPECT_EQ(6u, p.objects);
+    EXPECT_EQ(3u, p.malformed_records());
+
+    // the lenient parser takes ']' for the end of the object, the extra '}' is an error
+    EXPECT_EQ((std::vector<std::pair<long, long>>{{15, 8}, {32, 25}, {42, 33}}), p.errors);
+}
+
+TEST_F(ndjson_test, recovers_from_malformed_records_while_validating)
+{
+    const std::string buf = "{\"a\":1}\n{\"a\":2]}\n{\"a\":4} {\"a\":8}\n{\"a\":01}\r\n\n  {\"a\":\"\\x\"}\n[16]\n{\"a\":32}\n";
+
+    recovering_counter<haisu::json::validating> p;
+    p.parse(buf);
+    EXPECT_EQ(1 + 2 + 4 + 8 + 32, p.sum);
+    EXPECT_EQ((std::vector<std::pair<long, long>>{{14, 8}, {38, 33}, {52, 46}}), p.errors);
+}
+
+TEST_F(ndjson_test, reports_record_cut_by_end_of_input)
+{
+    for (const std::string buf : {"{\"a\":1}\n{\"a\":[2", "{\"a\":1}\n{\"a\":[2\n"})
+    {
+        recovering_counter<> p;
+        p.parse(buf);
+        EXPECT_EQ(1, p.sum); // 2 is cut short before it gets delivered
+        EXPECT_EQ(1u, p.malformed_records());
+        ASSERT_EQ(1u, p.errors.size());
+        EXPECT_EQ(8, p.errors[0].second);
+    }
+}
+
+TEST_F(ndjson_test, recovers_null_terminated_input)
+{
+    recovering_counter<> p;
+    p.parse("{\"a\":1}\n{\"a\":2}}\n{\"a\":4}\n{\n");
+    EXPECT_EQ(7, p.sum);
+    EXPECT_EQ(2u, p.malformed_records());
+    EXPECT_EQ(4u, p.objects);
+}
+
+TEST_F(ndjson_test, counts_malformed_records)
+{
+    std::string buf;
+    size_t malformed = 0;
+    long sum = 0;
+    for (int i = 0; i < 10000; ++i)
+    {
+        if (i % 7 == 3)
+        {
+            buf += "{\"a\":" + std::to_string(i) + ",\"b\":[1,}}\n";
+            ++malformed;
+        }
+        else
+        {
+            buf += "{\"a\":" + std::to_string(i) + ",\"b\":[\"x\"]}\n";
+            sum += i;
+        }
+    }
+
+    recovering_counter<haisu::json::validating> p;
+    p.parse(buf);
+    p.parse(buf);
+    EXPECT_EQ(2 * malformed, p.malformed_records());
+    EXPECT_EQ(2 * malformed, p.errors.size());
+}
+
+TEST_F(ndjson_test, steals_work_from_other_workers)
+{
+    haisu::json::detail::work_ranges work(10, 2, 3);
+
+    size_t first = 0;
+    size_t last = 0;
+    std::vector<size_t> taken;
+    while (work.pop(0, first, last))
+    {
+        for (; first != last; ++first) taken.push_back(first);
+    }
+
+    std::sort(taken.begin(), taken.end());
+    EXPECT_EQ((std::vector<size_t>{0, 1, 2, 3, 4, 5, 6, 7, 8, 9}), taken);
+    EXPECT_FALSE(work.pop(1, first, last));
+}
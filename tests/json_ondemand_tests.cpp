@@ -0,0 +1,197 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "haisu/json_ondemand.h"
+#include "data/large-file.json"
+
+namespace json = haisu::json;
+
+struct json_ondemand_test : ::testing::Test
+{
+    const std::string request = R"( {
+        "route" : "/users",
+        "payload" : {"items" : [[1, 2, {"id" : -1}], "}", {"a" : "]"}]},
+        "user" : {"id" : 42, "name" : "jo\"hn", "admin" : true, "quota" : 2.5, "manager" : null},
+        "tags" : ["a", "b\\n", "c"]
+    } )";
+};
+
+TEST_F(json_ondemand_test, finds_fields)
+{
+    json::ondemand_cursor doc{request};
+    EXPECT_EQ("/users", doc.find_field("route").get_raw_string());
+    EXPECT_EQ(42, doc.find_field("user").find_field("id").get_int64());
+}
+
+TEST_F(json_ondemand_test, reads_fields_in_order)
+{
+    json::ondemand_cursor doc{request};
+    auto user = doc.find_field("user");
+    EXPECT_EQ(42, user.find_field("id").get_int64());
+    EXPECT_EQ(R"(jo\"hn)", user.find_field("name").get_raw_string());
+    EXPECT_TRUE(user.find_field("admin").get_bool());
+    EXPECT_DOUBLE_EQ(2.5, user.find_field("quota").get_double());
+    EXPECT_TRUE(user.find_field("manager").is_null());
+}
+
+TEST_F(json_ondemand_test, does_not_look_back)
+{
+    json::ondemand_cursor doc{request};
+    auto user = doc.find_field("user");
+    EXPECT_FALSE(user.find_field("name").empty());
+    EXPECT_TRUE(user.find_field("id").empty());
+    EXPECT_FALSE(doc.find_field("tags").empty());
+    EXPECT_TRUE(doc.find_field("route").empty());
+}
+
+TEST_F(json_ondemand_test, misses_fields)
+{
+    json::ondemand_cursor doc{request};
+    EXPECT_TRUE(doc.find_field("nope").empty());
+    EXPECT_EQ(0, doc.find_field("nope").get_int64());
+    EXPECT_TRUE(doc.find_field("route").empty());
+}
+
+TEST_F(json_ondemand_test, skips_nested_containers)
+{
+    json::ondemand_cursor doc{request};
+    EXPECT_EQ("a", doc.find_field("tags").next_item().get_raw_string());
+}
+
+TEST_F(json_ondemand_test, iterates_over_array)
+{
+    json::ondemand_cursor doc{request};
+    auto tags = doc.find_field("tags");
+    EXPECT_EQ("a", tags.next_item().get_string());
+    EXPECT_EQ("b\\n", tags.next_item().get_string());
+    EXPECT_EQ("c", tags.next_item().get_string());
+    EXPECT_TRUE(tags.next_item().empty());
+    EXPECT_TRUE(tags.next_item().empty());
+}
+
+TEST_F(json_ondemand_test, accesses_array_by_index)
+{
+    json::ondemand_cursor doc{request};
+    auto items = doc.find_field("payload").find_field("items");
+    EXPECT_EQ(-1, items.at(0).at(2).find_field("id").get_int64());
+    EXPECT_EQ("}", items.at(1).get_raw_string());
+    EXPECT_EQ("]", items.at(2).find_field("a").get_raw_string());
+    EXPECT_TRUE(items.at(3).empty());
+}
+
+TEST_F(json_ondemand_test, tells_value_types)
+{
+    json::ondemand_cursor doc{request};
+    auto user = doc.find_field("user");
+    EXPECT_TRUE(user.is_object());
+    auto id = user.find_field("id");
+    EXPECT_TRUE(id.is_number());
+    EXPECT_FALSE(id.is_string());
+    EXPECT_TRUE(user.find_field("name").is_string());
+    EXPECT_TRUE(user.find_field("admin").is_bool());
+    EXPECT_TRUE(doc.find_field("tags").is_array());
+}
+
+TEST_F(json_ondemand_test, returns_zero_for_wrong_types)
+{
+    json::ondemand_cursor doc{request};
+    auto route = doc.find_field("route");
+    EXPECT_EQ(0, route.get_int64());
+    EXPECT_EQ(0.0, route.get_double());
+    EXPECT_FALSE(route.get_bool());
+    EXPECT_TRUE(doc.find_field("user").find_field("id").get_raw_string().empty());
+}
+
+TEST_F(json_ondemand_test, reads_numbers)
+{
+    json::ondemand_cursor doc{R"({"a" : 18446744073709551615, "b" : -9223372036854775808, "c" : 1e3, "d" : 12x})"};
+    auto a = doc.find_field("a");
+    EXPECT_EQ(18446744073709551615u, a.get_uint64());
+    EXPECT_EQ(0, a.get_int64());
+    EXPECT_EQ(INT64_MIN, doc.find_field("b").get_int64());
+    EXPECT_DOUBLE_EQ(1000.0, doc.find_field("c").get_double());
+    EXPECT_EQ(0, doc.find_field("d").get_int64());
+}
+
+TEST_F(json_ondemand_test, returns_raw_value)
+{
+    json::ondemand_cursor doc{request};
+    EXPECT_EQ(R"({"items" : [[1, 2, {"id" : -1}], "}", {"a" : "]"}]})", doc.find_field("payload").raw());
+}
+
+TEST_F(json_ondemand_test, matches_escaped_keys)
+{
+    json::ondemand_cursor doc{R"({"a\"b" : 1, 'c' : 2})"};
+    EXPECT_EQ(1, doc.find_field("a\"b").get_int64());
+    EXPECT_EQ(2, doc.find_field("c").get_int64());
+}
+
+TEST_F(json_ondemand_test, matches_keys_as_they_decode)
+{
+    const char* doc = R"({"a\u00e9\ud83d\ude00" : 1, "\n\t" : 2, "x\\" : 3, "y\u0041z" : 4})";
+    static_assert(noexcept(json::ondemand_cursor{doc}.find_field("a")), "find_field does not throw");
+    EXPECT_EQ(1, json::ondemand_cursor{doc}.find_field("a\xc3\xa9\xf0\x9f\x98\x80").get_int64());
+    EXPECT_EQ(2, json::ondemand_cursor{doc}.find_field("\n\t").get_int64());
+    EXPECT_EQ(3, json::ondemand_cursor{doc}.find_field("x\\").get_int64());
+    EXPECT_EQ(4, json::ondemand_cursor{doc}["yAz"].get_int64());
+
+    EXPECT_TRUE(json::ondemand_cursor{doc}.find_field("a\xc3\xa9").empty());
+    EXPECT_TRUE(json::ondemand_cursor{doc}.find_field("a\xc3\xa9\xf0\x9f\x98\x80!").empty());
+    EXPECT_TRUE(json::ondemand_cursor{doc}.find_field("x").empty());
+    EXPECT_TRUE(json::ondemand_cursor{doc}.find_field("x\\\\").empty());
+    EXPECT_TRUE(json::ondemand_cursor{doc}.find_field("yaz").empty());
+}
+
+TEST_F(json_ondemand_test, does_not_need_null_terminator)
+{
+    const std::string doc = R"({"a" : 12, "b" : 3})";
+    json::ondemand_cursor cursor{doc.data(), doc.data() + 8};
+    EXPECT_EQ(1, cursor.find_field("a").get_int64());
+    EXPECT_TRUE(cursor.find_field("b").empty());
+}
+
+TEST_F(json_ondemand_test, survives_malformed_json)
+{
+    for (const char* doc : {"", "{", "{\"a\"", "{\"a\" 1}", "{\"a\" :", "[1, ", "{\"a\" : \"x", "nul"})
+    {
+        json::ondemand_cursor cursor{doc};
+        EXPECT_TRUE(cursor.find_field("a").get_raw_string().empty()) << doc;
+        EXPECT_TRUE(cursor.at(1).empty()) << doc;
+    }
+}
+
+TEST_F(json_ondemand_test, reads_large_file)
+{
+    json::ondemand_cursor doc{TEST_JSON};
+    auto items = doc.find_field("items");
+    EXPECT_EQ(0, items.next_item().find_field("id").get_int64());
+    EXPECT_EQ(1, items.next_item().find_field("id").get_int64());
+    EXPECT_EQ(299, items.at(299).find_field("id").get_int64());
+    EXPECT_EQ("user_299", items.at(299).find_field("name").get_raw_string());
+    EXPECT_TRUE(items.at(300).empty());
+}
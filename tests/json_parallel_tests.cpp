@@ -0,0 +1,150 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "haisu/json_parallel.h"
+
+namespace json = haisu::json;
+
+struct json_parallel_test : ::testing::Test
+{
+    // n items, every one of them about 1k long
+    static std::string items(size_t n, const std::string& payload = "abc")
+    {
+        std::string ret;
+        for (size_t i = 0; i < n; ++i)
+        {
+            ret += i ? ", " : "";
+            ret += "{\"id\" : " + std::to_string(i) + ", \"text\" : \"" + payload + std::string(1000, 'x') + "\"}";
+        }
+        return ret;
+    }
+
+    static std::string join(const std::vector<std::string_view>& slices)
+    {
+        std::string ret;
+        for (auto slice : slices)
+        {
+            ret += ret.empty() ? "" : ",";
+            ret += slice;
+        }
+        return ret;
+    }
+};
+
+TEST_F(json_parallel_test, splits_array_at_top_level_commas)
+{
+    const auto contents = items(1000);
+    const auto doc = "  [" + contents + "]\n";
+    const auto slices = json::split_top_level(doc, 8);
+
+    ASSERT_EQ(8u, slices.size());
+    EXPECT_EQ(contents, join(slices));
+    for (auto slice : slices)
+    {
+        EXPECT_NE(std::string_view::npos, slice.find("\"id\""));
+    }
+}
+
+TEST_F(json_parallel_test, splits_object_into_members)
+{
+    std::string contents;
+    for (int i = 0; i < 1000; ++i)
+    {
+        contents += (i ? ",\"" : "\"") + std::to_string(i) + "\":[" + items(1) + "]";
+    }
+
+    const auto doc = "{" + contents + "}";
+    const auto slices = json::split_top_level(doc, 4);
+    ASSERT_EQ(4u, slices.size());
+    EXPECT_EQ(contents, join(slices));
+    for (auto slice : slices)
+    {
+        EXPECT_EQ('"', slice.front());
+    }
+}
+
+TEST_F(json_parallel_test, ignores_commas_inside_of_strings)
+{
+    const auto contents = items(1000, std::string(500, ',') + "\\\"[,]\\\\");
+    const auto doc = "[" + contents + "]";
+    const auto slices = json::split_top_level(doc, 16);
+
+    ASSERT_FALSE(slices.empty());
+    EXPECT_EQ(contents, join(slices));
+    for (auto slice : slices)
+    {
+        EXPECT_EQ('{', slice.substr(slice.find_first_not_of(' ')).front());
+        EXPECT_EQ('}', slice.back());
+    }
+}
+
+TEST_F(json_parallel_test, does_not_split_small_documents)
+{
+    EXPECT_TRUE(json::split_top_level("[1, 2, 3]", 4).empty());
+}
+
+TEST_F(json_parallel_test, descends_into_single_member)
+{
+    const auto contents = items(1000);
+    for (const std::string head : {"[[", "{\"items\" : [", "{\"count\" : 1000, \"all\" : {\"items\" : ["})
+    {
+        const auto doc = head + contents + "]" + std::string(head.size() > 20 ? "}}" : head == "[[" ? "]" : "}");
+        for (size_t shards : {2, 4})
+        {
+            const auto slices = json::split_top_level(doc, shards);
+            ASSERT_EQ(shards, slices.size()) << head;
+            EXPECT_EQ(contents, join(slices));
+            EXPECT_EQ(head, std::string(doc.data(), slices.front().data()));
+        }
+    }
+}
+
+TEST_F(json_parallel_test, splits_sibling_containers_at_their_parent)
+{
+    const auto doc = "{\"a\" : [" + items(500) + "], \"b\" : [" + items(500) + "]}";
+    const auto slices = json::split_top_level(doc, 4);
+
+    ASSERT_EQ(2u, slices.size());
+    EXPECT_EQ("\"a\"", slices[0].substr(0, 3));
+    EXPECT_EQ(" \"b\"", slices[1].substr(0, 4));
+    EXPECT_EQ(doc.data() + doc.size() - 1, slices[1].data() + slices[1].size());
+}
+
+TEST_F(json_parallel_test, does_not_split_scalars_and_broken_documents)
+{
+    const auto contents = items(1000);
+    EXPECT_TRUE(json::split_top_level("\"" + contents + "\"", 4).empty());
+    EXPECT_TRUE(json::split_top_level("[" + contents, 4).empty());
+    EXPECT_TRUE(json::split_top_level("[" + contents + "]]", 4).empty());
+    EXPECT_TRUE(json::split_top_level("[" + contents + ", \"]", 4).empty());
+}
+
+TEST_F(json_parallel_test, does_not_split_single_quoted_strings)
+{
+    EXPECT_TRUE(json::split_top_level("[" + items(1000) + ", 'a']", 4).empty());
+}
@@ -0,0 +1,183 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+
+For more information, please refer to <http://unlicense.org/>
+*/// clang-format off
+
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+#include "haisu/json_projector.h"
+
+namespace json = haisu::json;
+
+static constexpr char user_id[] = "$.user.id";
+static constexpr char user_name[] = "$.user.name";
+static constexpr char event_ts[] = "$.events[*].ts";
+static constexpr char second_tag[] = "$.tags[1]";
+static constexpr char any_value[] = "$.*.v";
+static constexpr char whole_user[] = "$.user";
+
+struct user_projector : json::projector<user_projector, user_id, user_name, event_ts>
+{
+    void on_match(json::path<user_id>, int64_t id) { ids.push_back(id); }
+    void on_match(json::path<user_name>, json::string_literal name) { names.emplace_back(name.view); }
+    void on_match(json::path<event_ts>, double ts) { timestamps.push_back(ts); }
+
+    std::vector<int64_t> ids;
+    std::vector<std::string> names;
+    std::vector<double> timestamps;
+};
+
+struct recording_projector : json::projector<recording_projector, second_tag, any_value, whole_user>
+{
+    template <const char* P>
+    void on_match(json::path<P>, json::string_literal lit) { out.append(P).append("=").append(lit.view).append(" "); }
+
+    template <const char* P>
+    void on_match(json::path<P>, json::numeric_literal lit) { out.append(P).append("=").append(lit.view).append(" "); }
+
+    template <const char* P>
+    void on_match(json::path<P>, json::bool_literal lit) { out.append(P).append(lit.value ? "=true " : "=false "); }
+
+    template <const char* P>
+    void on_match(json::path<P>, json::null_literal) { out.append(P).append("=null "); }
+
+    void on_error(json::error) { out.append("error "); }
+
+    std::string out;
+};
+
+const std::string document = R"({
+    "skip" : {"a" : "}]{[", "b" : [1, {"c" : "\"}"}], "user" : {"id" : 13}},
+    "user" : {"id" : 42, "name" : "bob", "friends" : [{"id" : 1}]},
+    "events" : [{"ts" : 1.5, "id" : 7}, {"x" : [{"ts" : 9}]}, {"ts" : 2e3}],
+    "tags" : ["a", "b", "c"],
+    "p" : {"v" : true},
+    "q" : {"v" : null, "w" : {"v" : 1}}
+})";
+
+TEST(json_projector_test, calls_handlers_for_matches_only) {
+    user_projector p;
+    p.parse(document.c_str());
+
+    EXPECT_EQ(std::vector<int64_t>({42}), p.ids);
+    EXPECT_EQ(std::vector<std::string>({"bob"}), p.names);
+    EXPECT_EQ(std::vector<double>({1.5, 2000.0}), p.timestamps);
+}
+
+TEST(json_projector_test, projects_bounded_and_chunked_input) {
+    user_projector bounded;
+    bounded.parse(std::string_view(document));
+
+    EXPECT_EQ(std::vector<int64_t>({42}), bounded.ids);
+    EXPECT_EQ(std::vector<double>({1.5, 2000.0}), bounded.timestamps);
+
+    for (size_t i = 0; i < document.size(); i += 7)
+    {
+        user_projector chunked;
+        chunked.feed(std::string_view(document).substr(0, i));
+        chunked.feed(std::string_view(document).substr(i));
+        chunked.finish();
+
+        EXPECT_EQ(std::vector<int64_t>({42}), chunked.ids) << "split at " << i;
+        EXPECT_EQ(std::vector<std::string>({"bob"}), chunked.names) << "split at " << i;
+        EXPECT_EQ(std::vector<double>({1.5, 2000.0}), chunked.timestamps) << "split at " << i;
+    }
+}
+
+TEST(json_projector_test, matches_escaped_keys_as_decoded) {
+    user_projector p;
+    p.parse(R"({"\u0075ser" : {"id" : 5, "n\u0061me" : "x", "i\\d" : 6}, "\/user" : {"id" : 7}})");
+
+    EXPECT_EQ(std::vector<int64_t>({5}), p.ids);
+    EXPECT_EQ(std::vector<std::string>({"x"}), p.names);
+}
+
+TEST(json_projector_test, starts_every_document_from_the_top) {
+    const std::string second = R"({"user" : {"id" : 7}})";
+    user_projector p;
+    p.feed(R"({"skip" : {"user" : {"id" : [)");
+    p.finish();
+    p.feed(std::string_view(second).substr(0, 5));
+    p.feed(std::string_view(second).substr(5));
+    p.finish();
+    EXPECT_EQ(std::vector<int64_t>({7}), p.ids);
+
+    p.feed(R"({"user" : {"x" : {"y" : [)");
+    p.parse(second.c_str());
+    p.feed(second);
+    p.finish();
+    EXPECT_EQ(std::vector<int64_t>({7, 7, 7}), p.ids);
+}
+
+TEST(json_projector_test, matches_indices_and_wildcards) {
+    recording_projector p;
+    p.parse(document.c_str());
+
+    EXPECT_EQ("$.tags[1]=b $.*.v=true $.*.v=null ", p.out);
+}
+
+TEST(json_projector_test, reports_errors) {
+    recording_projector p;
+    p.parse(R"({"tags" : ["a", "b")");
+    EXPECT_EQ("$.tags[1]=b error ", p.out);
+}
+
+TEST(json_projector_test, is_reusable) {
+    user_projector p;
+    p.parse(R"({"user" : {"id" : 1}})");
+    p.parse(R"({"user" : {"id" : 2, "name" : "x"}})");
+    p.parse(R"([{"user" : {"id" : 3}}])");
+
+    EXPECT_EQ(std::vector<int64_t>({1, 2}), p.ids);
+}
+
+TEST(json_projector_test, keeps_number_text_without_typed_handler) {
+    recording_projector p;
+    p.parse(R"({"a" : {"v" : -1.50e+2}, "tags" : [0, 12345678901234567890123]})");
+    EXPECT_EQ("$.*.v=-1.50e+2 $.tags[1]=12345678901234567890123 ", p.out);
+}
+
+TEST(json_projector_test, terminates) {
+    struct projector : json::projector<projector, event_ts>
+    {
+        void on_match(json::path<event_ts>, double ts)
+        {
+            timestamps.push_back(ts);
+            terminate();
+        }
+
+        void on_error(json::error) { ++errors; }
+
+        std::vector<double> timestamps;
+        int errors = 0;
+    };
+
+    projector p;
+    p.parse(document.c_str());
+    EXPECT_EQ(std::vector<double>({1.5}), p.timestamps);
+    EXPECT_EQ(0, p.errors);
+}
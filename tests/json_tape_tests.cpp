@@ -0,0 +1,322 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "haisu/json_tape.h"
+#include "haisu/json_writer.h"
+#include "data/large-file.json"
+
+struct json_tape_test : ::testing::Test
+{
+    haisu::json::tape tape;
+
+    // the tape written back as json, so that two tapes can be compared
+    static std::string dump(const haisu::json::tape& t)
+    {
+        haisu::zbuf buf;
+        haisu::json::writer<haisu::json::zbuf_output> out{haisu::json::zbuf_output{buf}};
+        dump(t.root(), out);
+        return std::string(out.output().view());
+    }
+
+    template <typename Writer>
+    static void dump(haisu::json::detail::tape_view view, Writer& out)
+    {
+        if (view.is_object())
+        {
+            out.on_new_object();
+            view.foreach_member([&out](std::string_view key, auto value) {
+                out.key(key);
+                dump(value, out);
+            });
+            out.on_object_end();
+        }
+        else if (view.is_array())
+        {
+            out.on_new_array();
+            view.foreach_child([&out](auto item) { dump(item, out); });
+            out.on_array_end();
+        }
+        else if (view.is_string())
+        {
+            out.string(view.as_string());
+        }
+        else if (view.is_number())
+        {
+            out.on_value(view.as_double());
+        }
+        else if (view.is_bool())
+        {
+            out.on_value(haisu::json::bool_literal{view.as_bool()});
+        }
+        else
+        {
+            out.on_value(haisu::json::null_literal{});
+        }
+    }
+
+    static std::string repeat(const std::string& item, size_t times, char open = '[', char close = ']')
+    {
+        std::string ret(1, open);
+        for (size_t i = 0; i < times; ++i)
+        {
+            ret += i ? ",\n" : "";
+            ret += item;
+        }
+        return ret + close;
+    }
+};
+
+TEST_F(json_tape_test, parses_json_having_one_pair)
+{
+    ASSERT_TRUE(tape.parse("{'a':'b'}"));
+    EXPECT_TRUE(tape.has_key("a"));
+    EXPECT_FALSE(tape.has_key("b"));
+    EXPECT_EQ("b", tape.child("a").as_string());
+}
+
+TEST_F(json_tape_test, gets_nested_children)
+{
+    ASSERT_TRUE(tape.parse(R"({"a" : {"b" : {"c" : "d"}}, "e" : "f"})"));
+    EXPECT_TRUE(tape.child("a").child("b").is_object());
+    EXPECT_EQ("d", tape.child("a").child("b").child("c").as_string());
+    EXPECT_EQ("f", tape.child("e").as_string());
+    EXPECT_TRUE(tape.child("a").child("x").empty());
+    EXPECT_TRUE(tape.child("e").child("x").empty());
+}
+
+TEST_F(json_tape_test, reads_scalars)
+{
+    ASSERT_TRUE(tape.parse(R"({"i" : -42, "u" : 18446744073709551615, "d" : 2.5, "t" : true, "f" : false, "n" : null})"));
+    EXPECT_EQ(-42, tape.child("i").as_int64());
+    EXPECT_EQ(18446744073709551615ull, tape.child("u").as_uint64());
+    EXPECT_EQ(2.5, tape.child("d").as_double());
+    EXPECT_EQ(-42.0, tape.child("i").as_double());
+    EXPECT_TRUE(tape.child("t").is_bool());
+    EXPECT_TRUE(tape.child("t").as_bool());
+    EXPECT_FALSE(tape.child("f").as_bool());
+    EXPECT_TRUE(tape.child("n").is_null());
+    EXPECT_TRUE(tape.child("d").is_number());
+    EXPECT_TRUE(tape.child("n").is_literal());
+    EXPECT_FALSE(tape.child("n").is_string());
+}
+
+TEST_F(json_tape_test, counts_children)
+{
+    ASSERT_TRUE(tape.parse("{'a':{'b':'c'}, 'd':{'e':'f', 'g' : [1, [2, 3], {}, 'x']}}"));
+    EXPECT_EQ(2, tape.root().count());
+    EXPECT_EQ(1, tape.child("a").count());
+    EXPECT_EQ(0, tape.child("a").child("b").count());
+    EXPECT_EQ(2, tape.child("d").count());
+    EXPECT_EQ(4, tape.child("d").child("g").count_array());
+    EXPECT_EQ(0, tape.child("d").count_array());
+}
+
+TEST_F(json_tape_test, indexes_arrays)
+{
+    ASSERT_TRUE(tape.parse(R"([1, {"a" : [2, 3]}, "s", [], 4.5])"));
+    const auto root = tape.root();
+    EXPECT_TRUE(root.is_array());
+    EXPECT_EQ(1, root[0].as_int64());
+    EXPECT_EQ(3, root[1].child("a")[1].as_int64());
+    EXPECT_EQ("s", root[2].as_string());
+    EXPECT_TRUE(root[3].is_array());
+    EXPECT_EQ(4.5, root[4].as_double());
+    EXPECT_TRUE(root[5].empty());
+}
+
+TEST_F(json_tape_test, iterates_over_children)
+{
+    ASSERT_TRUE(tape.parse(R"({"a" : 1, "b" : [1, 2, 3], "c" : {"d" : 4}})"));
+
+    std::string keys;
+    tape.root().foreach_member([&keys](auto key, auto value) {
+        keys += std::string(key) + ":" + std::to_string(value.count()) + " ";
+    });
+    EXPECT_EQ("a:0 b:3 c:1 ", keys);
+
+    int64_t sum = 0;
+    tape.child("b").foreach_child([&sum](auto item) { sum += item.as_int64(); });
+    EXPECT_EQ(6, sum);
+}
+
+TEST_F(json_tape_test, decodes_strings)
+{
+    ASSERT_TRUE(tape.parse(R"({"a\"b" : "c𝄞d"})"));
+    EXPECT_EQ("c\xf0\x9d\x84\x9e" "d", tape.child("a\"b").as_string());
+}
+
+TEST_F(json_tape_test, outlives_the_input)
+{
+    {
+        std::string doc = R"({"key" : "value"})";
+        ASSERT_TRUE(tape.parse(doc));
+        doc.assign(doc.size(), 'x');
+    }
+    EXPECT_EQ("value", tape.child("key").as_string());
+}
+
+TEST_F(json_tape_test, rejects_malformed_input)
+{
+    EXPECT_FALSE(tape.parse(R"({"a" : [1, 2)"));
+    EXPECT_TRUE(tape.root().empty());
+    EXPECT_FALSE(tape.parse("{}}"));
+    EXPECT_TRUE(tape.parse("{}"));
+    EXPECT_TRUE(tape.root().is_object());
+}
+
+TEST_F(json_tape_test, is_reusable)
+{
+    ASSERT_TRUE(tape.parse(R"({"a" : 1})"));
+    ASSERT_TRUE(tape.parse(R"({"b" : 2})"));
+    EXPECT_FALSE(tape.has_key("a"));
+    EXPECT_EQ(2, tape.child("b").as_int64());
+}
+
+TEST_F(json_tape_test, counts_large_arrays)
+{
+    std::string doc = "[0";
+    for (int i = 1; i < 100000; ++i)
+    {
+        doc += "," + std::to_string(i);
+    }
+    doc += "]";
+
+    ASSERT_TRUE(tape.parse(doc));
+    EXPECT_EQ(100000, tape.root().count_array());
+    EXPECT_EQ(99999, tape.root()[99999].as_int64());
+}
+
+TEST_F(json_tape_test, skips_whole_subtrees)
+{
+    const auto doc = R"({"big" : )" + std::string(TEST_JSON) + R"(, "small" : 1})";
+    ASSERT_TRUE(tape.parse(doc));
+    EXPECT_EQ(1, tape.child("small").as_int64());
+    EXPECT_EQ(2, tape.root().count());
+}
+
+TEST_F(json_tape_test, parses_large_array_in_parallel)
+{
+    const auto doc = repeat(TEST_JSON, 12);
+
+    haisu::json::tape serial;
+    ASSERT_TRUE(serial.parse(doc));
+    for (size_t shards : {2, 3, 7})
+    {
+        ASSERT_TRUE(tape.parse_parallel(doc, shards));
+        EXPECT_EQ(serial.size(), tape.size());
+        EXPECT_EQ(12u, tape.root().count_array());
+        EXPECT_EQ(dump(serial), dump(tape)) << shards;
+    }
+}
+
+TEST_F(json_tape_test, parses_large_object_in_parallel)
+{
+    std::string doc = "{";
+    for (int i = 0; i < 12; ++i)
+    {
+        doc += (i ? ", \"key" : "\"key") + std::to_string(i) + "\" : " + TEST_JSON;
+    }
+    doc += "}";
+
+    haisu::json::tape serial;
+    ASSERT_TRUE(serial.parse(doc));
+    ASSERT_TRUE(tape.parse_parallel(doc, 4));
+    EXPECT_EQ(12u, tape.root().count());
+    EXPECT_TRUE(tape.has_key("key11"));
+    EXPECT_EQ(dump(serial), dump(tape));
+}
+
+TEST_F(json_tape_test, parses_nested_array_in_parallel)
+{
+    std::string items;
+    for (int i = 0; i < 12; ++i)
+    {
+        items += (i ? ", " : "") + std::string(TEST_JSON);
+    }
+    const auto doc = R"({"meta" : {"name" : "all", "tags" : [1, 2.5, "x"]}, "items" : [)" + items
+        + R"(], "tail" : [null, {"last" : true}]})";
+
+    haisu::json::tape serial;
+    ASSERT_TRUE(serial.parse(doc));
+    for (size_t shards : {2, 4, 7})
+    {
+        ASSERT_FALSE(haisu::json::split_top_level(doc, shards).empty());
+        ASSERT_TRUE(tape.parse_parallel(doc, shards));
+        EXPECT_EQ(serial.size(), tape.size());
+        EXPECT_EQ(3u, tape.root().count());
+        EXPECT_EQ(12u, tape.child("items").count_array());
+        EXPECT_TRUE(tape.child("tail")[1].child("last").as_bool());
+        EXPECT_EQ(dump(serial), dump(tape)) << shards;
+    }
+}
+
+TEST_F(json_tape_test, parallel_parsing_follows_strings_over_chunks)
+{
+    // commas, brackets, quotes and backslash runs inside of strings, a chunk may start anywhere in them
+    std::string item = "[";
+    for (int i = 0; i < 2000; ++i)
+    {
+        item += i ? "," : "";
+        item += "\"" + std::string(i % 7, '\\') + std::string(i % 7, '\\') + "],[{\\\"" + std::to_string(i) + "\", 1";
+    }
+    item += "]";
+    const auto doc = repeat(item, 12);
+
+    haisu::json::tape serial;
+    ASSERT_TRUE(serial.parse(doc));
+    for (size_t shards : {2, 5, 13})
+    {
+        ASSERT_TRUE(tape.parse_parallel(doc, shards));
+        EXPECT_EQ(dump(serial), dump(tape)) << shards;
+    }
+}
+
+TEST_F(json_tape_test, parses_small_document_as_usual)
+{
+    ASSERT_TRUE(tape.parse_parallel("[1, 2, 3]", 4));
+    EXPECT_EQ(3u, tape.root().count_array());
+}
+
+TEST_F(json_tape_test, parallel_parsing_falls_back_on_single_quoted_strings)
+{
+    const auto doc = repeat("{'a\"b' : 'c]'}", 20000);
+
+    haisu::json::tape serial;
+    ASSERT_TRUE(serial.parse(doc));
+    ASSERT_TRUE(tape.parse_parallel(doc, 4));
+    EXPECT_EQ(dump(serial), dump(tape));
+}
+
+TEST_F(json_tape_test, parallel_parsing_fails_on_malformed_json)
+{
+    auto doc = repeat(TEST_JSON, 20);
+    doc[doc.find("\"tags\":[", doc.size() / 2) + 7] = ']';
+
+    EXPECT_FALSE(tape.parse_parallel(doc, 4));
+    EXPECT_EQ(0u, tape.size());
+}
@@ -26,7 +26,10 @@ OTHER DEALINGS IN THE SOFTWARE.
 // clang-format off
 
 #include <gtest/gtest.h>
+#include <cmath>
 #include <list>
+#include <memory>
+#include <vector>
 
 #include "haisu/json.h"
 #include "haisu/tree.h"
@@ -415,6 +418,147 @@ TEST_F(json_test, object_array_mix_is_too_deep_to_parse)
     EXPECT_TRUE(err.has_errors());
 }
 
+struct deep_counter : haisu::json::parser<deep_counter, 3, haisu::json::dynamic_depth>
+{
+    void on_error(haisu::json::error err)
+    {
+        errors.push_back(err.err);
+    }
+
+    void on_new_array() { ++arrays; }
+    void on_array_end() { --arrays; }
+    void on_new_object() { ++objects; }
+    void on_object_end() { --objects; }
+    void on_value(haisu::json::numeric_literal) { ++values; }
+    void on_array(haisu::json::numeric_literal) { ++values; }
+
+    std::vector<haisu::json::error_code> errors;
+    int arrays = 0;
+    int objects = 0;
+    int values = 0;
+};
+
+TEST_F(json_test, dynamic_depth_parser_is_not_limited_by_max_depth)
+{
+    const int depth = 100000;
+    const auto doc = std::string(depth, '[') + "1" + std::string(depth, ']');
+
+    deep_counter p;
+    p.parse(doc);
+    EXPECT_TRUE(p.errors.empty());
+    EXPECT_EQ(0, p.arrays);
+    EXPECT_EQ(1, p.values);
+}
+
+TEST_F(json_test, dynamic_depth_parser_goes_deep_into_objects_and_arrays)
+{
+    std::string doc;
+    for (int i = 0; i < 1000; ++i)
+    {
+        doc += i % 2 ? "[0, " : "{\"a\" : 1, \"b\" : ";
+    }
+    doc += "2";
+    for (int i = 999; i >= 0; --i)
+    {
+        doc += i % 2 ? "]" : "}";
+    }
+
+    deep_counter p;
+    for (int round = 0; round < 2; ++round)
+    {
+        p.parse(doc);
+        EXPECT_TRUE(p.errors.empty());
+        EXPECT_EQ(0, p.arrays);
+        EXPECT_EQ(0, p.objects);
+        EXPECT_EQ(1001 * (round + 1), p.values);
+    }
+}
+
+TEST_F(json_test, dynamic_depth_parser_reports_unbalanced_brackets)
+{
+    deep_counter p;
+    p.parse(std::string(1000, '[') + std::string(999, ']'));
+    EXPECT_EQ(1u, p.errors.size());
+
+    deep_counter q;
+    q.parse(std::string(1000, '[') + std::string(1001, ']'));
+    ASSERT_EQ(1u, q.errors.size());
+    EXPECT_EQ(haisu::json::error_code::malformed_json, q.errors[0]);
+}
+
+static constexpr char id_key[] = "id";
+static constexpr char ts_key[] = "ts";
+static constexpr char user_key[] = "user";
+static constexpr char long_a_key[] = "timestamp_a";
+static constexpr char long_b_key[] = "timestamp_b";
+static constexpr char mid_a_key[] = "abcdefgh_a_12345678"; // the same length, head and tail
+static constexpr char mid_b_key[] = "abcdefgh_b_12345678";
+static constexpr char empty_key[] = "";
+
+struct keyset_handler : haisu::json::parser<keyset_handler, 63,
+    haisu::json::keyset<id_key, ts_key, user_key, long_a_key, long_b_key, mid_a_key, mid_b_key>,
+    haisu::json::unescape_strings>
+{
+    void on_key(haisu::json::known_key<id_key>) { keys += "[id]"; }
+    void on_key(haisu::json::known_key<ts_key>) { keys += "[ts]"; }
+    void on_key(haisu::json::known_key<long_a_key>) { keys += "[a]"; }
+    void on_key(haisu::json::known_key<long_b_key>) { keys += "[b]"; }
+    void on_key(haisu::json::known_key<mid_a_key>) { keys += "[mid_a]"; }
+    void on_key(haisu::json::known_key<mid_b_key>) { keys += "[mid_b]"; }
+
+    void on_key(string_literal lit)
+    {
+        keys += "<";
+        keys += lit.view;
+        keys += ">";
+    }
+
+    std::string keys;
+};
+
+TEST_F(json_test, dispatches_keys_of_keyset)
+{
+    keyset_handler p;
+    p.parse(R"({"id" : 1, "user" : {"ts" : 2, "name" : 3}, "i" : 4, "idx" : 5, "" : 6, "timestamp_b" : 7,
+        "timestamp_a" : 8, "timestamp_c" : 9, "abcdefgh_b_12345678" : 10, "abcdefgh_a_12345678" : 11,
+        "abcdefgh_c_12345678" : 12, "id" : 13, "t\"s" : 14})");
+    EXPECT_EQ("[id]<user>[ts]<name><i><idx><>[b][a]<timestamp_c>[mid_b][mid_a]<abcdefgh_c_12345678>[id]<t\"s>", p.keys);
+}
+
+TEST_F(json_test, finds_key_in_keyset)
+{
+    using keys = haisu::json::keyset<id_key, ts_key, user_key, long_a_key, long_b_key, mid_a_key, mid_b_key, empty_key>;
+    EXPECT_EQ(8u, keys::size);
+    EXPECT_EQ(0u, keys::find("id"));
+    EXPECT_EQ(1u, keys::find("ts"));
+    EXPECT_EQ(2u, keys::find("user"));
+    EXPECT_EQ(3u, keys::find("timestamp_a"));
+    EXPECT_EQ(4u, keys::find("timestamp_b"));
+    EXPECT_EQ(5u, keys::find("abcdefgh_a_12345678"));
+    EXPECT_EQ(6u, keys::find("abcdefgh_b_12345678"));
+    EXPECT_EQ(7u, keys::find(""));
+    EXPECT_EQ(keys::size, keys::find("Id"));
+    EXPECT_EQ(keys::size, keys::find("use"));
+    EXPECT_EQ(keys::size, keys::find(std::string_view("id\0", 3)));
+    EXPECT_EQ(keys::size, keys::find("timestamp_"));
+    EXPECT_EQ(keys::size, keys::find("abcdefgh_a_12345679"));
+    EXPECT_EQ(keys::size, keys::find("abcdefgh_a_123456789"));
+
+    // a key at the very end of a page
+    alignas(4096) static char page[8192];
+    std::memcpy(page + 4094, "ts", 2);
+    EXPECT_EQ(1u, keys::find(std::string_view(page + 4094, 2)));
+}
+
+TEST_F(json_test, visits_key_of_keyset)
+{
+    using keys = haisu::json::keyset<id_key, ts_key>;
+    std::string visited;
+    EXPECT_TRUE(keys::visit(1, [&](auto k) { visited = decltype(k)::value; }));
+    EXPECT_EQ("ts", visited);
+    EXPECT_FALSE(keys::visit(2, [&](auto k) { visited = decltype(k)::value; }));
+}
+
 TEST_F(json_test, terminates_json_parser_middle_way)
 {
     struct parser : public haisu::json::parser<parser>
@@ -723,3 +867,906 @@ TEST_F(json_test, parsing_errors) {
     err.parse(json.c_str());
     ASSERT_FALSE(err.has_errors());
 }
+
+TEST_F(json_test, simd_block_masks_match_characters) {
+    using namespace haisu::json;
+
+    alignas(simd::block_size) char buf[simd::block_size * 2] = {};
+    const char* text = R"({"a\"b": [1, 2,	"c"],
+  "d" : null})";
+    strcpy(buf + 3, text);
+
+    for (int off = 0; off < 2 * simd::block_size; off += simd::block_size)
+    {
+        const simd::block b(buf + off);
+        const auto quote = b.eq<'"'>();
+        const auto backslash = b.eq<'\\'>();
+        const auto blank = b.eq<' ', '\t', '\r', '\n'>();
+        const auto stops = b.string_stops();
+        for (int i = 0; i < simd::block_size; ++i)
+        {
+            const char ch = buf[off + i];
+            const auto bit = uint64_t{1} << i;
+            EXPECT_EQ(ch == '"', !!(quote & bit));
+            EXPECT_EQ(ch == '\\', !!(backslash & bit));
+            EXPECT_EQ(is_blank(ch), !!(blank & bit));
+            EXPECT_EQ(ch == '"' || ch == '\\' || static_cast<unsigned char>(ch) < 0x20, !!(stops & bit));
+        }
+    }
+}
+
+TEST_F(json_test, simd_block_classes_match_characters) {
+    using namespace haisu::json::simd;
+
+    alignas(block_size) char buf[256];
+    for (int i = 0; i < 256; ++i)
+    {
+        buf[i] = static_cast<char>(i);
+    }
+
+    for (int off = 0; off < 256; off += block_size)
+    {
+        const block b(buf + off);
+        EXPECT_EQ((b.eq<'{', '}', '[', ']'>()), b.in<class_bracket>());
+        EXPECT_EQ((b.eq<',', ':'>()), (b.in<class_comma | class_colon>()));
+        EXPECT_EQ((b.eq<' ', '\t', '\n', '\r'>()), (b.in<class_space | class_control_blank>()));
+        EXPECT_EQ(b.eq<'\n'>(), b.in<class_newline>());
+        EXPECT_EQ((b.eq<'"', '\\'>()), (b.in<class_quote | class_backslash>()));
+    }
+}
+
+TEST_F(json_test, skips_strings_spanning_multiple_blocks) {
+    for (size_t len = 0; len < 300; len += 7)
+    {
+        const auto val = std::string(len, 'x') + "\\\"" + std::string(len % 70, 'y') + "\\\\";
+        json.parse(("{\"a\":\"" + val + "\",\"b\":\"c\"}").c_str());
+        ASSERT_EQ(val, json["a"]);
+        ASSERT_EQ("c", json["b"]);
+    }
+}
+
+TEST_F(json_test, skips_long_runs_of_blanks) {
+    const auto blanks = std::string(150, ' ') + "\n\t\r" + std::string(70, ' ');
+    json.parse(("{" + blanks + "\"a\"" + blanks + ":" + blanks + "\"b\"" + blanks + "}" + blanks).c_str());
+    EXPECT_EQ("b", json["a"]);
+}
+
+TEST_F(json_test, string_ending_with_backslash_is_incomplete) {
+    err.parse("[\"abc\\");
+    EXPECT_TRUE(err.has_errors());
+}
+
+TEST_F(json_test, parses_single_quoted_keys_and_values) {
+    json.parse("{'a':'b', \"c\":'d\"'}");
+    EXPECT_EQ("b", json["a"]);
+    EXPECT_EQ("d\"", json["c"]);
+}
+
+TEST_F(json_test, parses_string_view) {
+    const std::string buf = R"({"a":"b"}{"c":"d"})";
+    json.parse(std::string_view(buf).substr(0, 9));
+
+    EXPECT_EQ("b", json["a"]);
+}
+
+TEST_F(json_test, parses_buffer_without_null_terminator) {
+    const auto test = [&](std::string str) {
+        // an exact-sized heap block, address sanitizer catches anyone looking past the end
+        std::unique_ptr<char[]> buf(new char[str.size()]);
+        memcpy(buf.get(), str.data(), str.size());
+        arr = {};
+        arr.parse(buf.get(), buf.get() + str.size());
+    };
+
+    test("[\"a\",\"b\"]");
+    ASSERT_EQ(2, arr.size());
+    EXPECT_EQ("b", arr[1]);
+
+    test("[null,true,false,12]");
+    ASSERT_EQ(4, arr.size());
+    EXPECT_EQ("null literal", arr[0]);
+    EXPECT_EQ("boolean false", arr[2]);
+    EXPECT_EQ("12", arr[3]);
+
+    test("[1,  \"" + std::string(100, 'x') + "\"   \n  ]");
+    ASSERT_EQ(2, arr.size());
+    EXPECT_EQ(std::string(100, 'x'), arr[1]);
+
+    test("[\"a\\\"\"");
+    test("[\"a\\");
+    test("[12");
+    test("[tru");
+    test("[nul");
+    test("[fals");
+    test("[   ");
+}
+
+TEST_F(json_test, literals_at_the_end_of_buffer) {
+    const std::string buf = "[true[false[null[123";
+    arr.parse(buf.data(), buf.data() + 5);
+    arr.parse(buf.data() + 5, buf.data() + 11);
+    arr.parse(buf.data() + 11, buf.data() + 16);
+    arr.parse(buf.data() + 16, buf.data() + 19);
+
+    ASSERT_EQ(4, arr.size());
+    EXPECT_EQ("boolean true", arr[0]);
+    EXPECT_EQ("boolean false", arr[1]);
+    EXPECT_EQ("null literal", arr[2]);
+    EXPECT_EQ("12", arr[3]);
+}
+
+TEST_F(json_test, does_not_read_literal_past_the_end_of_buffer) {
+    const std::string buf = "[true]";
+
+    err.parse(buf.data(), buf.data() + 3);
+    EXPECT_TRUE(err.has_errors());
+
+    err = {};
+    err.parse(buf.data(), buf.data() + 6);
+    EXPECT_FALSE(err.has_errors());
+}
+
+TEST_F(json_test, signals_error_on_null_character_inside_of_buffer) {
+    const std::string buf("[1,\0 2]", 7);
+
+    err.parse(buf.data(), buf.data() + buf.size());
+    EXPECT_TRUE(err.has_errors());
+}
+
+TEST_F(json_test, terminates_bounded_parser_middle_way) {
+    struct parser : public haisu::json::parser<parser>
+    {
+        void on_array(null_literal)
+        {
+            ++array_size;
+            terminate();
+        }
+
+        int array_size = 0;
+    };
+
+    const std::string buf = "[null, null]";
+    parser p;
+    p.parse(std::string_view(buf));
+
+    EXPECT_EQ(1, p.array_size);
+}
+
+struct event_recorder : haisu::json::parser<event_recorder>
+{
+    template <typename Literal>
+    void on_key(Literal lit) { out.append("k:").append(lit.view).append(1, ' '); }
+
+    void on_value(string_literal lit) { out.append("s:").append(lit.view).append(1, ' '); }
+    void on_value(numeric_literal lit) { out.append("n:").append(lit.view).append(1, ' '); }
+    void on_value(bool_literal lit) { out.append(lit.value ? "true " : "false "); }
+    void on_value(null_literal) { out.append("null "); }
+
+    void on_array(string_literal lit) { out.append("s:").append(lit.view).append(1, ' '); }
+    void on_array(numeric_literal lit) { out.append("n:").append(lit.view).append(1, ' '); }
+    void on_array(bool_literal lit) { out.append(lit.value ? "true " : "false "); }
+    void on_array(null_literal) { out.append("null "); }
+
+    void on_new_object() { out.append("{ "); }
+    void on_object_end() { out.append("} "); }
+    void on_new_array() { out.append("[ "); }
+    void on_array_end() { out.append("] "); }
+
+    void on_error(haisu::json::error) { out.append("error "); }
+
+    std::string out;
+};
+
+TEST_F(json_test, parses_document_split_in_two_chunks) {
+    const std::string doc = R"( {"a\\\"b" : [1, -2.5e3, true, false, null, "x\"y"],  "c":{"d":"e"}, "f":12345} )";
+
+    event_recorder whole;
+    whole.parse(doc.c_str());
+    ASSERT_EQ(std::string::npos, whole.out.find("error"));
+
+    for (size_t i = 0; i <= doc.size(); ++i)
+    {
+        event_recorder chunked;
+        chunked.feed(std::string_view(doc).substr(0, i));
+        chunked.feed(std::string_view(doc).substr(i));
+        chunked.finish();
+        ASSERT_EQ(whole.out, chunked.out) << "split at " << i;
+    }
+}
+
+TEST_F(json_test, follows_tokens_through_many_blocks) {
+    // long strings and runs of blanks put the tokens far apart, the commas and the colons come both right after
+    // a value and after blanks
+    std::string doc = "{";
+    for (int i = 0; i < 60; ++i)
+    {
+        const auto pad = std::string(i * 7 % 90, ' ');
+        doc += (i ? "," : "") + pad + "\"k" + std::to_string(i) + "\"" + pad + ":[" + std::string(i % 3, '\n')
+            + "\"" + std::string(i * 13 % 150, 'x') + "\\\"\"" + pad + "," + std::to_string(i) + ",true" + pad + "]";
+    }
+    doc += "}";
+
+    event_recorder whole;
+    whole.parse(doc.c_str());
+    EXPECT_EQ(std::string::npos, whole.out.find("error"));
+    EXPECT_NE(std::string::npos, whole.out.find("k:k59 [ s:" + std::string(59 * 13 % 150, 'x') + "\\\" n:59 true ]"));
+
+    event_recorder bounded;
+    bounded.parse(std::string_view(doc));
+    EXPECT_EQ(whole.out, bounded.out);
+
+    event_recorder chunked;
+    for (size_t i = 0; i < doc.size(); i += 100)
+    {
+        chunked.feed(std::string_view(doc).substr(i, 100));
+    }
+    chunked.finish();
+    EXPECT_EQ(whole.out, chunked.out);
+}
+
+TEST_F(json_test, parses_document_byte_by_byte) {
+    std::string doc = TEST_JSON;
+
+    event_recorder whole;
+    whole.parse(doc.c_str());
+
+    for (size_t step : {1, 3, 64, 1000})
+    {
+        event_recorder chunked;
+        for (size_t i = 0; i < doc.size(); i += step)
+        {
+            chunked.feed(std::string_view(doc).substr(i, step));
+        }
+        chunked.finish();
+        ASSERT_EQ(whole.out, chunked.out);
+    }
+}
+
+TEST_F(json_test, chunked_parser_reports_incomplete_document) {
+    event_recorder p;
+    p.feed("[\"ab");
+    p.finish();
+    EXPECT_NE(std::string::npos, p.out.find("error"));
+
+    p.out.clear();
+    p.feed("[tr");
+    p.feed("ue]");
+    p.finish();
+    EXPECT_EQ("[ true ] ", p.out);
+
+    p.out.clear();
+    p.feed("[tr");
+    p.feed("uex]");
+    p.finish();
+    EXPECT_NE(std::string::npos, p.out.find("error"));
+}
+
+TEST_F(json_test, chunked_parser_is_reusable) {
+    event_recorder p;
+    p.feed("[1");
+    p.finish();
+    p.feed("[2");
+    p.feed("]");
+    p.finish();
+    EXPECT_EQ("[ n:1 error [ n:2 ] ", p.out);
+}
+
+TEST_F(json_test, terminates_chunked_parser) {
+    struct parser : public haisu::json::parser<parser>
+    {
+        void on_array(numeric_literal)
+        {
+            ++array_size;
+            terminate();
+        }
+
+        int array_size = 0;
+    };
+
+    parser p;
+    p.feed("[1");
+    p.feed("2, 3, ");
+    p.feed("4]");
+    p.finish();
+
+    EXPECT_EQ(1, p.array_size);
+}
+
+struct number_recorder : haisu::json::parser<number_recorder>
+{
+    void on_value(int64_t val) { ints.push_back(val); }
+    void on_value(uint64_t val) { uints.push_back(val); }
+    void on_value(double val) { doubles.push_back(val); }
+
+    void on_array(int64_t val) { ints.push_back(val); }
+    void on_array(uint64_t val) { uints.push_back(val); }
+    void on_array(double val) { doubles.push_back(val); }
+
+    void on_error(haisu::json::error) { ++errors; }
+
+    std::vector<int64_t> ints;
+    std::vector<uint64_t> uints;
+    std::vector<double> doubles;
+    int errors = 0;
+};
+
+TEST_F(json_test, delivers_typed_numbers) {
+    number_recorder p;
+    p.parse("[0, -0, 1, -1, 123456789012, 9223372036854775807, -9223372036854775808]");
+
+    EXPECT_EQ(0, p.errors);
+    EXPECT_EQ(std::vector<int64_t>({0, 0, 1, -1, 123456789012, INT64_MAX, INT64_MIN}), p.ints);
+    EXPECT_TRUE(p.uints.empty());
+    EXPECT_TRUE(p.doubles.empty());
+}
+
+TEST_F(json_test, delivers_large_integers_as_unsigned_or_double) {
+    number_recorder p;
+    p.parse(R"({"a" : 9223372036854775808, "b" : 18446744073709551615, "c" : 18446744073709551616, "d" : -9223372036854775809})");
+
+    EXPECT_EQ(0, p.errors);
+    EXPECT_EQ(std::vector<uint64_t>({9223372036854775808ull, UINT64_MAX}), p.uints);
+    EXPECT_EQ(std::vector<double>({18446744073709551616.0, -9223372036854775809.0}), p.doubles);
+}
+
+TEST_F(json_test, delivers_doubles) {
+    number_recorder p;
+    p.parse("[0.5, -2.5e3, 1E+5, 1e-5, 3.141592653589793, 1.7976931348623157e308, 4.9406564584124654e-324, 1e400, -0.0]");
+
+    EXPECT_EQ(0, p.errors);
+    ASSERT_EQ(9u, p.doubles.size());
+    EXPECT_EQ(0.5, p.doubles[0]);
+    EXPECT_EQ(-2500.0, p.doubles[1]);
+    EXPECT_EQ(100000.0, p.doubles[2]);
+    EXPECT_EQ(1e-5, p.doubles[3]);
+    EXPECT_EQ(3.141592653589793, p.doubles[4]);
+    EXPECT_EQ(1.7976931348623157e308, p.doubles[5]);
+    EXPECT_EQ(4.9406564584124654e-324, p.doubles[6]);
+    EXPECT_EQ(HUGE_VAL, p.doubles[7]);
+    EXPECT_TRUE(std::signbit(p.doubles[8]));
+}
+
+TEST_F(json_test, converts_doubles_same_as_strtod) {
+    const char* numbers[] = {
+        "2.2250738585072011e-308", "2.4703282292062327e-324", "2.4703282292062328e-324", "9007199254740993.0",
+        "123456789012345678901234567890", "0.000000000000000000000000000001234567890123456789", "7.2057594037927933e16",
+        "1.00000000000000011102230246251565404236316680908203125", "12345678.87654321e-3", "4.35679e-400"};
+
+    for (auto num : numbers)
+    {
+        number_recorder p;
+        p.parse(("[" + std::string(num) + "]").c_str());
+        ASSERT_EQ(1u, p.doubles.size()) << num;
+        EXPECT_EQ(std::strtod(num, nullptr), p.doubles[0]) << num;
+    }
+}
+
+TEST_F(json_test, delivers_integers_as_double_if_asked) {
+    struct parser : public haisu::json::parser<parser>
+    {
+        void on_array(double val) { sum += val; }
+        double sum = 0;
+    };
+
+    parser p;
+    p.parse(std::string_view("[1, 2, 3.5, 12345678901234567890123]"));
+    EXPECT_EQ(6.5 + 12345678901234567890123.0, p.sum);
+}
+
+struct catch_all_parser : haisu::json::parser<catch_all_parser>
+{
+    template <typename Literal>
+    void on_array(Literal&& lit)
+    {
+        if constexpr (std::is_same_v<std::decay_t<Literal>, numeric_literal>)
+        {
+            out.append(lit.view).append(1, ' ');
+        }
+    }
+
+    std::string out;
+};
+
+TEST_F(json_test, keeps_numeric_literals_for_catch_all_handlers) {
+    catch_all_parser p;
+    p.parse("[1, 2.5, -3e+2]");
+    EXPECT_EQ("1 2.5 -3e+2 ", p.out);
+}
+
+TEST_F(json_test, follows_number_grammar) {
+    for (auto doc : {"[1E+5]", "[1e-5]", "[-0.5E5]", "[10]"})
+    {
+        event_recorder p;
+        p.parse(doc);
+        EXPECT_EQ(std::string::npos, p.out.find("error")) << doc;
+    }
+
+    for (auto doc : {"[1e]", "[1e+]", "[1.]", "[-]", "[-x]", "[1.2.3]", "[1ee5]", "[1.e5]"})
+    {
+        event_recorder p;
+        p.parse(doc);
+        EXPECT_NE(std::string::npos, p.out.find("error")) << doc;
+
+        number_recorder n;
+        n.parse(std::string_view(doc));
+        EXPECT_EQ(1, n.errors) << doc;
+    }
+}
+
+TEST_F(json_test, delivers_typed_numbers_at_buffer_end) {
+    for (std::string num : {"1", "12345678", "123456789012345678", "1.25", "1.2345678901234567", "-1e5"})
+    {
+        auto buf = std::make_unique<char[]>(num.size());
+        memcpy(buf.get(), num.data(), num.size());
+
+        number_recorder p;
+        p.feed(buf.get(), buf.get() + num.size());
+        p.finish();
+        EXPECT_EQ(0, p.errors);
+    }
+
+    const std::string doc = "[12345678901234, 0.123456789012345, -42]";
+    auto buf = std::make_unique<char[]>(doc.size());
+    memcpy(buf.get(), doc.data(), doc.size());
+
+    number_recorder p;
+    p.parse(buf.get(), buf.get() + doc.size());
+    EXPECT_EQ(0, p.errors);
+    EXPECT_EQ(std::vector<int64_t>({12345678901234, -42}), p.ints);
+    EXPECT_EQ(std::vector<double>({0.123456789012345}), p.doubles);
+}
+
+TEST_F(json_test, delivers_typed_numbers_split_between_chunks) {
+    const std::string doc = "[12345678901234567, 2.5e-3, -7]";
+    for (size_t i = 0; i <= doc.size(); ++i)
+    {
+        number_recorder p;
+        p.feed(std::string_view(doc).substr(0, i));
+        p.feed(std::string_view(doc).substr(i));
+        p.finish();
+        EXPECT_EQ(0, p.errors);
+        EXPECT_EQ(std::vector<int64_t>({12345678901234567, -7}), p.ints) << "split at " << i;
+        EXPECT_EQ(std::vector<double>({2.5e-3}), p.doubles) << "split at " << i;
+    }
+}
+
+struct unescaping_recorder : haisu::json::parser<unescaping_recorder, 63, haisu::json::unescape_strings>
+{
+    void on_key(string_literal lit) { strings.emplace_back(lit.view); views.push_back(lit.view); }
+    void on_value(string_literal lit) { strings.emplace_back(lit.view); views.push_back(lit.view); }
+    void on_array(string_literal lit) { strings.emplace_back(lit.view); views.push_back(lit.view); }
+
+    std::vector<std::string> strings;
+    std::vector<std::string_view> views;
+};
+
+std::string unescape(std::string str)
+{
+    auto end = haisu::json::unescape(str.data(), str.data() + str.size(), &str[0]);
+    str.resize(end - str.data());
+    return str;
+}
+
+TEST_F(json_test, unescapes_simple_escape_sequences) {
+    EXPECT_EQ("", unescape(""));
+    EXPECT_EQ("abc", unescape("abc"));
+    EXPECT_EQ("a\"b\\c/d'e", unescape(R"(a\"b\\c\/d\'e)"));
+    EXPECT_EQ("\b\f\n\r\t", unescape(R"(\b\f\n\r\t)"));
+    EXPECT_EQ("\\x\\", unescape(R"(\x\)"));
+}
+
+TEST_F(json_test, unescapes_unicode_escape_sequences) {
+    EXPECT_EQ("A", unescape(R"(A)"));
+    EXPECT_EQ("\xc3\xa9", unescape(R"(é)"));
+    EXPECT_EQ("\xe2\x82\xac", unescape(R"(€)"));
+    EXPECT_EQ("\xf0\x9f\x98\x80", unescape(R"(😀)"));
+    EXPECT_EQ("\xef\xbf\xbd" "x", unescape(R"(\ud83dx)"));
+    EXPECT_EQ("\xef\xbf\xbd", unescape(R"(\ude00)"));
+    EXPECT_EQ("\\u12", unescape(R"(\u12)"));
+    EXPECT_EQ("\\uzzzz", unescape(R"(\uzzzz)"));
+}
+
+TEST_F(json_test, unescapes_long_strings) {
+    std::string str;
+    std::string expected;
+    for (int i = 0; i < 100; ++i)
+    {
+        str += std::string(i, 'a') + "\\n";
+        expected += std::string(i, 'a') + "\n";
+    }
+
+    EXPECT_EQ(expected, unescape(str));
+}
+
+TEST_F(json_test, unescapes_strings_in_situ) {
+    char buf[] = R"({"k\"ey" : "va\nlue", "plain" : ["aA", 'b\'c']})";
+    const auto begin = buf;
+    const auto end = buf + sizeof(buf);
+
+    unescaping_recorder p;
+    p.parse_in_situ(buf);
+
+    EXPECT_EQ(std::vector<std::string>({"k\"ey", "va\nlue", "plain", "aA", "b'c"}), p.strings);
+    for (auto view : p.views)
+    {
+        EXPECT_TRUE(view.data() >= begin && view.data() + view.size() <= end);
+    }
+}
+
+TEST_F(json_test, unescapes_bounded_buffer_in_situ) {
+    std::string doc = R"(["x\ty", "\\"])";
+    unescaping_recorder p;
+    p.parse_in_situ(&doc[0], &doc[0] + doc.size());
+
+    EXPECT_EQ(std::vector<std::string>({"x\ty", "\\"}), p.strings);
+}
+
+TEST_F(json_test, unescapes_strings_leaving_input_intact) {
+    const std::string doc = R"({"a" : "b\/c", "de" : "plain"})";
+    unescaping_recorder p;
+    p.parse(doc.c_str());
+    p.parse(std::string_view(doc));
+
+    EXPECT_EQ(std::vector<std::string>({"a", "b/c", "de", "plain", "a", "b/c", "de", "plain"}), p.strings);
+    EXPECT_EQ(R"({"a" : "b\/c", "de" : "plain"})", doc);
+
+    // escape-free strings are not copied
+    EXPECT_EQ(doc.data() + 2, p.views[0].data());
+    EXPECT_EQ(doc.data() + doc.find("plain"), p.views[3].data());
+}
+
+struct arena_unescaper : haisu::json::parser<arena_unescaper, 63, haisu::json::unescape_strings>
+{
+    char* unescape_buffer(size_t size)
+    {
+        arena.emplace_back(size, '\0');
+        return &arena.back()[0];
+    }
+
+    void on_array(string_literal lit) { views.push_back(lit.view); }
+
+    std::list<std::string> arena;
+    std::vector<std::string_view> views;
+};
+
+TEST_F(json_test, unescapes_strings_into_derivee_buffer) {
+    arena_unescaper p;
+    p.parse(R"(["a\nb", "c", "d\"e"])");
+
+    ASSERT_EQ(3u, p.views.size());
+    EXPECT_EQ(2u, p.arena.size());
+    EXPECT_EQ("a\nb", p.views[0]); // the views outlive the callbacks
+    EXPECT_EQ("c", p.views[1]);
+    EXPECT_EQ("d\"e", p.views[2]);
+}
+
+TEST_F(json_test, unescapes_strings_split_between_chunks) {
+    const std::string doc = R"(["a\\b", "cd\"e", "😀"])";
+    for (size_t i = 0; i <= doc.size(); ++i)
+    {
+        unescaping_recorder p;
+        p.feed(std::string_view(doc).substr(0, i));
+        p.feed(std::string_view(doc).substr(i));
+        p.finish();
+        EXPECT_EQ(std::vector<std::string>({"a\\b", "cd\"e", "\xf0\x9f\x98\x80"}), p.strings) << "split at " << i;
+    }
+}
+
+// skips the values of "skip" keys and the contents of the second array
+struct skipping_recorder : haisu::json::parser<skipping_recorder>
+{
+    void on_key(string_literal lit)
+    {
+        out.append("k:").append(lit.view).append(1, ' ');
+        if (lit.view == "skip")
+        {
+            skip();
+        }
+    }
+
+    template <typename Literal>
+    void on_value(Literal) { out.append("v "); }
+
+    template <typename Literal>
+    void on_array(Literal) { out.append("v "); }
+
+    void on_new_object() { out.append("{ "); }
+    void on_object_end() { out.append("} "); }
+    void on_array_end() { out.append("] "); }
+
+    void on_new_array()
+    {
+        out.append("[ ");
+        if (++arrays == 2)
+        {
+            skip();
+        }
+    }
+
+    std::string out;
+    int arrays = 0;
+};
+
+TEST_F(json_test, skips_values_without_callbacks) {
+    const std::string doc = R"({"a" : 1, "skip" : {"b" : [1, "]}"], "c" : {}}, "d" : [true, [1, [2]], 3], "skip" : "x", "e" : null})";
+
+    skipping_recorder p;
+    p.parse(doc.c_str());
+    EXPECT_EQ("{ k:a v k:skip k:d [ v [ ] v ] k:skip k:e v } ", p.out);
+
+    skipping_recorder bounded;
+    bounded.parse(std::string_view(doc));
+    EXPECT_EQ(p.out, bounded.out);
+}
+
+TEST_F(json_test, does_not_skip_chunked_input) {
+    skipping_recorder p;
+    p.feed(R"({"skip" : [1], "a" : 2})");
+    p.finish();
+    EXPECT_EQ("{ k:skip [ v ] k:a v } ", p.out);
+}
+
+TEST_F(json_test, skips_large_containers) {
+    const std::string values[] = {
+        TEST_JSON,
+        R"({"x" : "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa", "y" : 'it"s ]}', "z" : ["\\\"]", [[[{}]]]], "w" : "\\"})",
+        "[" + std::string(200, ' ') + "\"}\"" + std::string(100, ' ') + "]"};
+
+    for (const auto& value : values)
+    {
+        for (size_t shift = 0; shift < 70; shift += 3)
+        {
+            const auto doc = std::string(shift, ' ') + R"({"skip" : )" + value + R"(, "a" : 1})";
+
+            skipping_recorder p;
+            p.parse(doc.c_str());
+            EXPECT_EQ("{ k:skip k:a v } ", p.out) << "shift " << shift;
+
+            skipping_recorder bounded;
+            bounded.parse(std::string_view(doc));
+            EXPECT_EQ("{ k:skip k:a v } ", bounded.out) << "shift " << shift;
+        }
+    }
+}
+
+TEST_F(json_test, skips_unterminated_containers) {
+    for (std::string doc : {R"({"skip" : [[1, 2], "]")", R"({"skip" : {"a" : "b}})", R"({"skip" : [')"})
+    {
+        doc += std::string(100, ' ');
+
+        skipping_recorder p;
+        p.parse(doc.c_str());
+        EXPECT_EQ("{ k:skip ", p.out);
+
+        skipping_recorder bounded;
+        bounded.parse(std::string_view(doc));
+        EXPECT_EQ("{ k:skip ", bounded.out);
+    }
+}
+
+struct validating_parser : haisu::json::parser<validating_parser, 63, haisu::json::validating>
+{
+    void on_error(haisu::json::error err)
+    {
+        ++error_count;
+        code = err.err;
+        position = err.position;
+    }
+
+    void on_key(haisu::json::string_literal)
+    {
+        ++events;
+    }
+
+    template <typename Literal>
+    void on_value(Literal)
+    {
+        ++events;
+    }
+
+    template <typename Literal>
+    void on_array(Literal)
+    {
+        ++events;
+    }
+
+    int error_count{};
+    int events{};
+    haisu::json::error_code code{};
+    const char* position{};
+};
+
+// parses the document null-terminated, bounded and byte by byte, returns the number of modes which found it invalid
+static int validation_errors(const std::string& doc)
+{
+    validating_parser p;
+    p.parse(doc.c_str());
+
+    validating_parser bounded;
+    bounded.parse(std::string_view(doc));
+
+    validating_parser chunked;
+    for (const auto& ch : doc)
+    {
+        chunked.feed(&ch, &ch + 1);
+    }
+    chunked.finish();
+
+    return (p.error_count > 0) + (bounded.error_count > 0) + (chunked.error_count > 0);
+}
+
+TEST_F(json_test, validating_parser_accepts_valid_documents) {
+    const std::string docs[] = {
+        TEST_JSON,
+        "{}",
+        " [ ] ",
+        "[[], {}, [{}]]",
+        R"({"a" : {"b" : [1, -0, 0.5, -1.25e+3, 1E-2, true, false, null, "c"]}, "d" : ""})",
+        R"(["\" \\ \/ \b \f \n \r \t é 𝄞"])",
+        "[\"caf\xc3\xa9 \xe2\x82\xac \xf0\x9d\x84\x9e \xed\x9f\xbf \xf4\x8f\xbf\xbf\"]",
+        "[\"" + std::string(200, 'a') + "\xc3\xa9" + std::string(100, 'b') + "\"]",
+        "{\"a\"" + std::string(100, ' ') + ":" + std::string(100, '\n') + "[1" + std::string(70, ' ') + ",2]}",
+        "\"a string\"",
+        "42",
+        "\n\ttrue\r\n",
+        "true",
+        "false",
+        "null"};
+
+    for (const auto& doc : docs)
+    {
+        EXPECT_EQ(0, validation_errors(doc)) << doc;
+    }
+}
+
+TEST_F(json_test, validating_parser_rejects_grammar_violations) {
+    const std::string docs[] = {
+        "",
+        "   ",
+        "[1,]",
+        R"({"a" : 1,})",
+        R"({"a" 1})",
+        R"({"a" :: 1})",
+        R"(["a" : 1])",
+        R"({1 : 2})",
+        R"({"a" : 1 "b" : 2})",
+        R"({"a"})",
+        R"({,})",
+        "[,1]",
+        "[1 2]",
+        "[1,,2]",
+        "[1" + std::string(100, ' ') + ",,2]",
+        "[1," + std::string(70, ' ') + ",2]",
+        "{\"a\"" + std::string(100, ' ') + "::1}",
+        "[}",
+        "{]",
+        "{}}",
+        "{} {}",
+        "[1] x",
+        ":",
+        "{'a' : 1}",
+        "[01]",
+        "[-01.5]",
+        R"(["\x"])",
+        R"(["\u12G4"])",
+        "[\"a\tb\"]",
+        R"(["unterminated)",
+        "[tru]",
+        "tru",
+        "nulll",
+        "falsey",
+        "[1.]"};
+
+    for (const auto& doc : docs)
+    {
+        EXPECT_EQ(3, validation_errors(doc)) << doc;
+    }
+}
+
+TEST_F(json_test, validating_parser_accepts_bare_literals) {
+    for (const char* doc : {"true", "false", "null"})
+    {
+        validating_parser p;
+        p.parse(doc);
+        EXPECT_EQ(0, p.error_count) << doc;
+        EXPECT_EQ(haisu::json::error_code{}, p.code) << doc;
+    }
+}
+
+TEST_F(json_test, validating_parser_rejects_ill_formed_utf8) {
+    const std::string sequences[] = {
+        "\x80",             // a stray continuation byte
+        "\xc0\x80",         // overlong
+        "\xc1\xbf",         // overlong
+        "\xe0\x80\x80",     // overlong
+        "\xed\xa0\x80",     // a surrogate
+        "\xf0\x80\x80\x80", // overlong
+        "\xf4\x90\x80\x80", // past U+10FFFF
+        "\xf5\x80\x80\x80",
+        "\xe2\x82",         // cut short
+        "\xff"};
+
+    for (const auto& seq : sequences)
+    {
+        for (const size_t prefix : {0, 20, 70})
+        {
+            const auto doc = "{\"k\" : \"" + std::string(prefix, 'a') + seq + "z\"}";
+            EXPECT_EQ(3, validation_errors(doc)) << prefix;
+
+            validating_parser p;
+            p.parse(doc.c_str());
+            EXPECT_EQ(haisu::json::error_code::invalid_utf8, p.code);
+            EXPECT_EQ(doc.find(seq), size_t(p.position - doc.c_str()));
+        }
+    }
+}
+
+TEST_F(json_test, validating_parser_rejects_utf8_cut_by_closing_quote) {
+    for (const std::string seq : {"\xe4", "\xe2\x82", "\xf0\x9d\x84", "\xc3", "\x80"})
+    {
+        for (const size_t prefix : {0, 20, 70})
+        {
+            const auto doc = "{\"k\" : \"" + std::string(prefix, 'a') + seq + "\"}";
+            const auto pos = doc.find(seq);
+
+            validating_parser p;
+            p.parse(doc.c_str());
+            EXPECT_EQ(haisu::json::error_code::invalid_utf8, p.code) << prefix;
+            EXPECT_EQ(pos, size_t(p.position - doc.c_str()));
+
+            validating_parser bounded;
+            bounded.parse(std::string_view(doc));
+            EXPECT_EQ(haisu::json::error_code::invalid_utf8, bounded.code) << prefix;
+            EXPECT_EQ(pos, size_t(bounded.position - doc.c_str()));
+
+            validating_parser chunked;
+            for (const auto& ch : doc)
+            {
+                chunked.feed(&ch, &ch + 1);
+            }
+            chunked.finish();
+            EXPECT_EQ(haisu::json::error_code::invalid_utf8, chunked.code) << prefix;
+        }
+    }
+}
+
+TEST_F(json_test, validating_parser_reports_first_violation) {
+    const std::string doc = R"({"a" : [1, 2, ], "b" : x})";
+
+    validating_parser p;
+    p.parse(doc.c_str());
+    EXPECT_EQ(1, p.error_count);
+    EXPECT_EQ(haisu::json::error_code::malformed_json, p.code);
+    EXPECT_EQ(doc.find(']'), size_t(p.position - doc.c_str()));
+    EXPECT_EQ(3, p.events);
+}
+
+TEST_F(json_test, lenient_parser_is_still_lenient) {
+    error_counter p;
+    p.parse(R"({'a' : [1, 2,], "b" : 01})");
+    EXPECT_FALSE(p.has_errors());
+}
+
+struct validating_unescaper : haisu::json::parser<validating_unescaper, 63, haisu::json::validating, haisu::json::unescape_strings>
+{
+    void on_error(haisu::json::error)
+    {
+        ++error_count;
+    }
+
+    void on_array(haisu::json::string_literal lit)
+    {
+        out += lit.view;
+        out += '|';
+    }
+
+    std::string out;
+    int error_count{};
+};
+
+TEST_F(json_test, validating_parser_unescapes_strings) {
+    validating_unescaper p;
+    p.parse(R"(["plain", "a\tb", "é𝄞"])");
+    EXPECT_EQ(0, p.error_count);
+    EXPECT_EQ("plain|a\tb|\xc3\xa9\xf0\x9d\x84\x9e|", p.out);
+}
@@ -0,0 +1,259 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <limits>
+#include <string>
+
+#include "haisu/json_writer.h"
+#include "haisu/json_tape.h"
+#include "data/large-file.json"
+
+namespace json = haisu::json;
+
+struct json_writer_test : ::testing::Test
+{
+    char buf[1024];
+    json::writer<json::buffer_output> compact{json::buffer_output{buf, sizeof(buf)}};
+
+    std::string text() const
+    {
+        return std::string(compact.output().view());
+    }
+
+    static std::string minify(std::string_view in, int indent = 0)
+    {
+        haisu::zbuf out;
+        json::zbuf_output zout{out};
+        EXPECT_TRUE(json::reformat(in, zout, indent));
+        return std::string(zout.view());
+    }
+};
+
+TEST_F(json_writer_test, writes_compact_object)
+{
+    compact.on_new_object();
+    compact.key("a");
+    compact.on_value(int64_t{1});
+    compact.key("b");
+    compact.on_new_array();
+    compact.on_array(json::bool_literal{true});
+    compact.on_array(json::null_literal{});
+    compact.string("c");
+    compact.on_array_end();
+    compact.on_object_end();
+
+    EXPECT_EQ(R"({"a":1,"b":[true,null,"c"]})", text());
+    EXPECT_FALSE(compact.output().overflow());
+}
+
+TEST_F(json_writer_test, writes_empty_containers)
+{
+    compact.on_new_array();
+    compact.on_new_object();
+    compact.on_object_end();
+    compact.on_new_array();
+    compact.on_array_end();
+    compact.on_array_end();
+
+    EXPECT_EQ("[{},[]]", text());
+}
+
+TEST_F(json_writer_test, pretty_prints)
+{
+    EXPECT_EQ("{\n  \"a\": [\n    1,\n    {}\n  ],\n  \"b\": {\n    \"c\": null\n  }\n}",
+        minify(R"({"a":[1,{}],"b":{"c":null}})", 2));
+}
+
+TEST_F(json_writer_test, puts_top_level_values_one_per_line)
+{
+    compact.on_new_object();
+    compact.on_object_end();
+    compact.on_new_array();
+    compact.on_array_end();
+
+    EXPECT_EQ("{}\n[]", text());
+}
+
+TEST_F(json_writer_test, escapes_plain_text)
+{
+    compact.on_new_array();
+    compact.string("a\"b\\c\n\t\x01 \xc3\xa9");
+    compact.on_array_end();
+
+    EXPECT_EQ(R"(["a\"b\\c\n\t\u0001 )" "\xc3\xa9" R"("])", text());
+}
+
+TEST_F(json_writer_test, escapes_long_text)
+{
+    const std::string tail(100, 'x');
+    for (size_t i = 0; i < 80; ++i)
+    {
+        json::writer w{json::buffer_output{buf, sizeof(buf)}};
+        w.on_new_array();
+        w.string(std::string(i, 'x') + '"' + tail);
+        w.on_array_end();
+
+        EXPECT_EQ("[\"" + std::string(i, 'x') + "\\\"" + tail + "\"]", w.output().view()) << i;
+    }
+}
+
+TEST_F(json_writer_test, keeps_escape_sequences_of_parsed_strings)
+{
+    compact.on_new_object();
+    compact.on_key(json::string_literal{R"(a\"b)"});
+    compact.on_value(json::string_literal{R"(é\\\n)"});
+    compact.on_object_end();
+
+    EXPECT_EQ(R"({"a\"b":"é\\\n"})", text());
+}
+
+TEST_F(json_writer_test, converts_single_quoted_strings)
+{
+    haisu::zbuf out;
+    json::zbuf_output zout{out};
+    json::writer w{zout};
+    json::pipe<decltype(w)> p{w};
+    p.parse(R"({'a"b':'it\'s'})");
+
+    EXPECT_FALSE(p.failed());
+    EXPECT_EQ(R"({"a\"b":"it's"})", zout.view());
+}
+
+TEST_F(json_writer_test, formats_numbers)
+{
+    compact.on_new_array();
+    compact.on_array(std::numeric_limits<int64_t>::min());
+    compact.on_array(std::numeric_limits<uint64_t>::max());
+    compact.on_array(0.1);
+    compact.on_array(-2.5e-300);
+    compact.on_array(std::numeric_limits<double>::infinity());
+    compact.on_array(json::numeric_literal{"1.50"});
+    compact.on_array_end();
+
+    EXPECT_EQ("[-9223372036854775808,18446744073709551615,0.1,-2.5e-300,null,1.50]", text());
+}
+
+TEST_F(json_writer_test, stops_at_the_end_of_buffer)
+{
+    char small[8];
+    json::writer w{json::buffer_output{small, sizeof(small)}};
+    w.on_new_object();
+    w.key("abcdefgh");
+    w.on_value(int64_t{1});
+    w.on_object_end();
+
+    EXPECT_TRUE(w.output().overflow());
+    EXPECT_EQ(sizeof(small), w.output().size());
+}
+
+TEST_F(json_writer_test, fits_the_buffer_exactly)
+{
+    char small[7];
+    json::writer w{json::buffer_output{small, sizeof(small)}};
+    w.on_new_object();
+    w.key("a");
+    w.on_value(int64_t{1});
+    w.on_object_end();
+
+    EXPECT_FALSE(w.output().overflow());
+    EXPECT_EQ(R"({"a":1})", w.output().view());
+}
+
+TEST_F(json_writer_test, minifies_json)
+{
+    EXPECT_EQ(R"({"a":[1,2.5e3,"x y"],"b":{"c":true,"d":null}})",
+        minify(" { \"a\" : [ 1 , 2.5e3 , \"x y\" ] ,\n\t\"b\" : { \"c\" : true, \"d\" : null } } "));
+}
+
+TEST_F(json_writer_test, minify_is_idempotent)
+{
+    const auto once = minify(TEST_JSON);
+    EXPECT_LE(once.size(), std::string_view(TEST_JSON).size());
+    EXPECT_EQ(once, minify(once));
+    EXPECT_EQ(once, minify(minify(once, 4)));
+}
+
+TEST_F(json_writer_test, reformatted_json_parses_into_the_same_document)
+{
+    json::tape original;
+    json::tape pretty;
+    ASSERT_TRUE(original.parse(TEST_JSON));
+    ASSERT_TRUE(pretty.parse(minify(TEST_JSON, 3)));
+
+    EXPECT_EQ(original.size(), pretty.size());
+    EXPECT_EQ(original.root().count(), pretty.root().count());
+}
+
+TEST_F(json_writer_test, decodes_and_escapes_again)
+{
+    haisu::zbuf out;
+    json::zbuf_output zout{out};
+    json::writer w{zout};
+    json::pipe<decltype(w), json::unescape_strings> p{w};
+    p.parse(R"({"a\/b":"é\t"})");
+
+    EXPECT_FALSE(p.failed());
+    EXPECT_EQ("{\"a/b\":\"\xc3\xa9\\t\"}", zout.view());
+}
+
+TEST_F(json_writer_test, reports_malformed_json)
+{
+    haisu::zbuf out;
+    json::zbuf_output zout{out};
+    EXPECT_FALSE(json::reformat(R"({"a":[1,2})", zout));
+}
+
+TEST_F(json_writer_test, reformat_rejects_what_the_strict_grammar_does)
+{
+    for (const char* in : {R"({"a":1,})", "[1 2]", "[01]", R"({'a':1})", "\"str\" 1", "tru", ""})
+    {
+        haisu::zbuf out;
+        json::zbuf_output zout{out};
+        EXPECT_FALSE(json::reformat(in, zout)) << in;
+    }
+}
+
+TEST_F(json_writer_test, reformats_top_level_scalars)
+{
+    EXPECT_EQ(R"("str\n")", minify(R"( "str\n" )"));
+    EXPECT_EQ("-1.5e3", minify("\n-1.5e3\n", 2));
+    EXPECT_EQ("true", minify("true"));
+    EXPECT_EQ("false", minify("false "));
+    EXPECT_EQ("null", minify("\tnull"));
+}
+
+TEST_F(json_writer_test, validating_pipe_rejects_what_the_lenient_one_lets_through)
+{
+    haisu::zbuf out;
+    json::zbuf_output zout{out};
+    json::writer w{zout};
+    json::pipe<decltype(w), json::validating> p{w};
+    p.parse(R"({"a":[1,2,]})");
+
+    EXPECT_TRUE(p.failed());
+    EXPECT_EQ(json::error_code::malformed_json, p.last_error().err);
+}
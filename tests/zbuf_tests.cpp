@@ -23,7 +23,10 @@ ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
 OTHER DEALINGS IN THE SOFTWARE.
 */
 #include <gtest/gtest.h>
+#include <cstdio>
+#include <string>
 
+#include "haisu/memory.h"
 #include "haisu/zbuf.h"
 
 struct zbuf_test: ::testing::Test
@@ -249,3 +252,340 @@ TEST_F(zbuf_test, inserts_string_in_the_middle)
     EXPECT_STREQ("world", z.ptr(10));
 }
 
+
+TEST_F(zbuf_test, appends_raw_bytes)
+{
+    z.append("abc", 3);
+    z.append("de", 3);
+
+    EXPECT_EQ(6u, z.size());
+    EXPECT_STREQ("abcde", z.ptr(0));
+}
+
+TEST_F(zbuf_test, keeps_small_buffer_inline)
+{
+    EXPECT_EQ(0u, z.capacity());
+    z.append(int{1});
+
+    EXPECT_EQ(haisu::zbuf::inline_capacity, z.capacity());
+    EXPECT_GE(z.ptr(0), reinterpret_cast<const char*>(&z));
+    EXPECT_LT(z.ptr(0), reinterpret_cast<const char*>(&z + 1));
+}
+
+TEST_F(zbuf_test, moves_to_heap_when_outgrows_inline_buffer)
+{
+    for (int i = 0; i < 1000; ++i)
+    {
+        z.append(i);
+    }
+
+    EXPECT_EQ(1000 * sizeof(int), z.size());
+    EXPECT_GE(z.capacity(), z.size());
+    EXPECT_LT(z.capacity(), 2 * z.size());
+    EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(z.ptr(0)) % alignof(std::max_align_t));
+    for (int i = 0; i < 1000; ++i)
+    {
+        ASSERT_EQ(i, z.at<int>(i));
+    }
+}
+
+TEST_F(zbuf_test, grows_geometrically)
+{
+    size_t reallocations = 0;
+    auto capacity = z.capacity();
+    for (int i = 0; i < 100000; ++i)
+    {
+        z.grow(1);
+        z.append(char(i));
+        if (z.capacity() != capacity)
+        {
+            ++reallocations;
+            capacity = z.capacity();
+        }
+    }
+
+    EXPECT_LT(reallocations, 20u);
+}
+
+TEST_F(zbuf_test, appends_uninitialized_values)
+{
+    z.append(int{-1});
+    auto ints = z.append_n<int>(100);
+    for (int i = 0; i < 100; ++i)
+    {
+        ints[i] = i;
+    }
+
+    EXPECT_EQ(101 * sizeof(int), z.size());
+    EXPECT_EQ(-1, z.at<int>(0));
+    EXPECT_EQ(99, z.at<int>(100));
+}
+
+TEST_F(zbuf_test, zero_fills_appended_value)
+{
+    for (int i = 0; i < 100; ++i)
+    {
+        z.append(-1);
+    }
+    z.clear();
+
+    EXPECT_EQ(0, z.append<int>());
+}
+
+TEST_F(zbuf_test, resizes_buffer)
+{
+    z.append("hello");
+    z.resize(1000);
+    EXPECT_EQ(1000u, z.size());
+    EXPECT_STREQ("hello", z.ptr(0));
+
+    z.resize(2);
+    EXPECT_EQ(2u, z.size());
+    EXPECT_EQ('e', z.at<char>(1));
+}
+
+TEST_F(zbuf_test, copies_buffer)
+{
+    for (auto count : {1, 1000})
+    {
+        haisu::zbuf a;
+        for (int i = 0; i < count; ++i)
+        {
+            a.append(i);
+        }
+
+        haisu::zbuf b(a);
+        a.at<int>(0) = -1;
+        ASSERT_EQ(a.size(), b.size());
+        EXPECT_EQ(0, b.at<int>(0));
+        EXPECT_EQ(count - 1, b.at<int>(count - 1));
+
+        z = b;
+        EXPECT_EQ(b.size(), z.size());
+        EXPECT_EQ(count - 1, z.at<int>(count - 1));
+    }
+}
+
+TEST_F(zbuf_test, moves_buffer)
+{
+    for (auto count : {1, 1000})
+    {
+        haisu::zbuf a;
+        for (int i = 0; i < count; ++i)
+        {
+            a.append(i);
+        }
+
+        haisu::zbuf b(std::move(a));
+        EXPECT_TRUE(a.empty());
+        ASSERT_EQ(count * sizeof(int), b.size());
+        EXPECT_EQ(count - 1, b.at<int>(count - 1));
+
+        z.append("some");
+        z = std::move(b);
+        EXPECT_TRUE(b.empty());
+        ASSERT_EQ(count * sizeof(int), z.size());
+        EXPECT_EQ(count - 1, z.at<int>(count - 1));
+
+        b.append(1);
+        EXPECT_EQ(1, b.at<int>(0));
+    }
+}
+
+TEST_F(zbuf_test, allocates_from_arena)
+{
+    haisu::growbump arena;
+    haisu::zbuf a(arena);
+    for (int i = 0; i < 10000; ++i)
+    {
+        a.append(i);
+    }
+
+    EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(a.ptr(0)) % alignof(std::max_align_t));
+    for (int i = 0; i < 10000; ++i)
+    {
+        ASSERT_EQ(i, a.at<int>(i));
+    }
+
+    haisu::zbuf b(std::move(a));
+    EXPECT_EQ(9999, b.at<int>(9999));
+}
+
+TEST_F(zbuf_test, pads_buffer_to_alignment)
+{
+    z.append(char{1});
+    EXPECT_EQ(8u, z.align(8));
+    EXPECT_EQ(8u, z.align(8));
+    EXPECT_EQ(0, z.at<char>(7));
+    EXPECT_EQ(16u, z.align(16));
+}
+
+TEST_F(zbuf_test, appends_aligned_records)
+{
+    std::vector<size_t> offsets;
+    for (int i = 0; i < 1000; ++i)
+    {
+        z.append(char(i));
+        offsets.push_back(z.append_aligned(uint64_t(i)));
+        z.append(short(i));
+        z.append_aligned(double(i));
+    }
+
+    for (size_t i = 0; i < offsets.size(); ++i)
+    {
+        ASSERT_EQ(0u, offsets[i] % alignof(uint64_t));
+        ASSERT_EQ(0u, reinterpret_cast<uintptr_t>(&z.at_offset<uint64_t>(offsets[i])) % alignof(uint64_t));
+        ASSERT_EQ(i, z.at_offset<uint64_t>(offsets[i]));
+        ASSERT_EQ(double(i), z.at_offset<double>(offsets[i] + 16));
+    }
+}
+
+TEST_F(zbuf_test, loads_and_stores_packed_records)
+{
+    z.append(char{1});
+    z.append(uint64_t{0x0102030405060708});
+    z.append(char{2});
+
+    EXPECT_EQ(9u + 1, z.size());
+    EXPECT_EQ(0x0102030405060708u, z.load<uint64_t>(1));
+
+    z.store(1, uint64_t{42});
+    EXPECT_EQ(42u, z.load<uint64_t>(1));
+    EXPECT_EQ(1, z.load<char>(0));
+    EXPECT_EQ(2, z.load<char>(9));
+}
+
+struct zbuf_file_test : zbuf_test
+{
+    ~zbuf_file_test()
+    {
+        std::remove(path.c_str());
+    }
+
+    std::string path = testing::TempDir() + "zbuf_file_test_" + std::to_string(getpid());
+};
+
+TEST_F(zbuf_file_test, keeps_buffer_in_file)
+{
+    ASSERT_TRUE(z.open_file(path.c_str()));
+    EXPECT_TRUE(z.file_backed());
+    EXPECT_TRUE(z.empty());
+
+    for (int i = 0; i < 100000; ++i)
+    {
+        z.append(i);
+    }
+    EXPECT_TRUE(z.checkpoint());
+
+    for (int i = 0; i < 100000; ++i)
+    {
+        ASSERT_EQ(i, z.at<int>(i));
+    }
+
+    struct stat st;
+    ASSERT_EQ(0, stat(path.c_str(), &st));
+    EXPECT_GE(size_t(st.st_size), z.size());
+}
+
+TEST_F(zbuf_file_test, reopens_file)
+{
+    {
+        haisu::zbuf a;
+        ASSERT_TRUE(a.open_file(path.c_str()));
+        a.append("hello");
+        a.append_aligned(uint64_t{42});
+    }
+
+    ASSERT_TRUE(z.open_file(path.c_str()));
+    ASSERT_EQ(16u, z.size());
+    EXPECT_STREQ("hello", z.ptr(0));
+    EXPECT_EQ(42u, z.at_offset<uint64_t>(8));
+
+    z.append("world");
+    z.close_file();
+    EXPECT_FALSE(z.file_backed());
+    EXPECT_TRUE(z.empty());
+
+    ASSERT_TRUE(z.open_file(path.c_str()));
+    EXPECT_STREQ("world", z.ptr(16));
+}
+
+TEST_F(zbuf_file_test, moves_contents_to_fresh_file)
+{
+    for (int i = 0; i < 5000; ++i)
+    {
+        z.append(i);
+    }
+
+    ASSERT_TRUE(z.open_file(path.c_str()));
+    ASSERT_EQ(5000 * sizeof(int), z.size());
+    for (int i = 0; i < 5000; ++i)
+    {
+        ASSERT_EQ(i, z.at<int>(i));
+    }
+    z.close_file();
+
+    ASSERT_TRUE(z.open_file(path.c_str()));
+    ASSERT_EQ(5000 * sizeof(int), z.size());
+    EXPECT_EQ(4999, z.at<int>(4999));
+}
+
+TEST_F(zbuf_file_test, replaces_contents_with_existing_file)
+{
+    {
+        haisu::zbuf a;
+        ASSERT_TRUE(a.open_file(path.c_str()));
+        a.append(int{7});
+    }
+
+    z.append(int{1});
+    z.append(int{2});
+    ASSERT_TRUE(z.open_file(path.c_str()));
+    ASSERT_EQ(sizeof(int), z.size());
+    EXPECT_EQ(7, z.at<int>(0));
+}
+
+TEST_F(zbuf_file_test, shares_file_contents)
+{
+    ASSERT_TRUE(z.open_file(path.c_str()));
+    z.append(int{7});
+    ASSERT_TRUE(z.checkpoint());
+
+    haisu::zbuf other;
+    ASSERT_TRUE(other.open_file(path.c_str()));
+    ASSERT_EQ(sizeof(int), other.size());
+    EXPECT_EQ(7, other.at<int>(0));
+
+    z.at<int>(0) = 8; // the same pages
+    EXPECT_EQ(8, other.at<int>(0));
+}
+
+TEST_F(zbuf_file_test, moves_file_backed_buffer)
+{
+    ASSERT_TRUE(z.open_file(path.c_str()));
+    z.append(int{1});
+
+    haisu::zbuf other(std::move(z));
+    EXPECT_TRUE(other.file_backed());
+    EXPECT_FALSE(z.file_backed());
+    other.append(int{2});
+
+    haisu::zbuf copy(other);
+    EXPECT_FALSE(copy.file_backed());
+    EXPECT_EQ(2, copy.at<int>(1));
+}
+
+TEST_F(zbuf_file_test, rejects_foreign_file)
+{
+    FILE* file = std::fopen(path.c_str(), "w");
+    ASSERT_NE(nullptr, file);
+    std::fputs("definitely not a zbuf, but a long enough text file to have the header read out of it", file);
+    std::fclose(file);
+
+    z.append(int{1});
+    EXPECT_FALSE(z.open_file(path.c_str()));
+    EXPECT_FALSE(z.file_backed());
+    EXPECT_EQ(1, z.at<int>(0));
+
+    EXPECT_FALSE(z.open_file("/nonexistent/dir/zbuf"));
+}
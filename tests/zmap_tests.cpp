@@ -23,8 +23,14 @@ ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
 OTHER DEALINGS IN THE SOFTWARE.
 */
 #include <gtest/gtest.h>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
 
 #include "haisu/zset.h"
+#include "haisu/zmap.h"
 
 struct zset_test: ::testing::Test
 {
@@ -344,3 +350,457 @@ TEST_F(zset_test, sorts_data_when_constructing_from_initializer_list)
     EXPECT_STREQ("world", z.at(1));
 }
 
+
+TEST_F(zset_test, reopens_set_from_file)
+{
+    const auto path = testing::TempDir() + "zset_test_" + std::to_string(getpid());
+    {
+        haisu::zset a;
+        ASSERT_TRUE(a.open_file(path.c_str()));
+        a.insert("world");
+        a.insert("hello");
+        a.insert("abc");
+    }
+
+    ASSERT_TRUE(z.open_file(path.c_str()));
+    ASSERT_EQ(3u, z.size());
+    EXPECT_STREQ("abc", z.at(0));
+    EXPECT_STREQ("hello", z.at(1));
+    EXPECT_STREQ("world", z.at(2));
+    EXPECT_EQ(1u, z.count("hello"));
+
+    z.insert("zzz");
+    z.close_file();
+    EXPECT_TRUE(z.empty());
+
+    ASSERT_TRUE(z.open_file(path.c_str()));
+    EXPECT_EQ(4u, z.size());
+    z.close_file();
+    std::remove(path.c_str());
+}
+
+TEST_F(zset_test, moves_set_to_fresh_file)
+{
+    const auto path = testing::TempDir() + "zset_test_fresh_" + std::to_string(getpid());
+    z = {"a", "b", "c"};
+
+    ASSERT_TRUE(z.open_file(path.c_str()));
+    ASSERT_EQ(3u, z.size());
+    EXPECT_STREQ("b", z.at(1));
+    z.insert("d");
+    z.close_file();
+
+    ASSERT_TRUE(z.open_file(path.c_str()));
+    ASSERT_EQ(4u, z.size());
+    EXPECT_EQ(1u, z.count("a"));
+    EXPECT_EQ(1u, z.count("d"));
+    z.close_file();
+    std::remove(path.c_str());
+}
+
+TEST_F(zset_test, builds_set_from_range)
+{
+    const std::vector<std::string> keys{"world", "hello", "abc", "hello", "", "ab", "world"};
+    z.assign(keys.begin(), keys.end());
+
+    ASSERT_EQ(5u, z.size());
+    EXPECT_STREQ("", z.at(0));
+    EXPECT_STREQ("ab", z.at(1));
+    EXPECT_STREQ("abc", z.at(2));
+    EXPECT_STREQ("hello", z.at(3));
+    EXPECT_STREQ("world", z.at(4));
+    EXPECT_EQ(1u, z.count("abc"));
+    EXPECT_EQ(0u, z.count("a"));
+
+    z.insert("b");
+    EXPECT_EQ(6u, z.size());
+    EXPECT_STREQ("b", z.at(3));
+}
+
+TEST_F(zset_test, builds_set_from_sorted_range)
+{
+    const char* keys[] = {"a", "b", "b", "c"};
+    z.insert("x");
+    z.assign_sorted(std::begin(keys), std::end(keys));
+
+    ASSERT_EQ(3u, z.size());
+    EXPECT_STREQ("a", z.at(0));
+    EXPECT_STREQ("c", z.at(2));
+    EXPECT_EQ(0u, z.count("x"));
+}
+
+TEST_F(zset_test, builds_set_from_initializer_list)
+{
+    haisu::zset s{"b", "a", "b"};
+    ASSERT_EQ(2u, s.size());
+    EXPECT_STREQ("a", s.at(0));
+    EXPECT_STREQ("b", s.at(1));
+}
+
+TEST_F(zset_test, merges_range_into_set)
+{
+    z.insert("b");
+    z.insert("d");
+    z.insert("f");
+
+    const std::vector<std::string_view> keys{"g", "a", "d", "c", "c", "e"};
+    z.insert(keys.begin(), keys.end());
+
+    ASSERT_EQ(7u, z.size());
+    for (size_t i = 0; i < z.size(); ++i)
+    {
+        EXPECT_EQ(std::string(1, char('a' + i)), z.at(i));
+    }
+
+    z.insert(keys.begin(), keys.end());
+    EXPECT_EQ(7u, z.size());
+}
+
+TEST_F(zset_test, merges_own_strings)
+{
+    z.insert("abc");
+    z.insert("def");
+
+    const std::vector<const char*> keys{z.at(1), z.at(0), "b"};
+    z.insert(keys.begin(), keys.end());
+
+    ASSERT_EQ(3u, z.size());
+    EXPECT_STREQ("abc", z.at(0));
+    EXPECT_STREQ("b", z.at(1));
+    EXPECT_STREQ("def", z.at(2));
+}
+
+TEST_F(zset_test, bulk_build_matches_inserts)
+{
+    std::vector<std::string> keys;
+    for (int i = 0; i < 3000; ++i)
+    {
+        keys.push_back("key" + std::to_string(i * 7919 % 2000));
+    }
+
+    haisu::zset one_by_one;
+    for (auto& k : keys)
+    {
+        one_by_one.insert(k.c_str());
+    }
+
+    z.assign(keys.begin(), keys.begin() + 1000);
+    z.insert(keys.begin() + 1000, keys.end());
+
+    ASSERT_EQ(one_by_one.size(), z.size());
+    EXPECT_EQ(2000u, z.size());
+    for (size_t i = 0; i < z.size(); ++i)
+    {
+        ASSERT_STREQ(one_by_one.at(i), z.at(i));
+    }
+}
+
+TEST_F(zset_test, frozen_lookups_match_plain_ones)
+{
+    std::vector<std::string> keys{"", "a", "ab", "abcdefg", "abcdefgh", "abcdefghi", "abcdefgz", "http://example.com/a",
+        "http://example.com/b", "http://example.com/b/c", "z", "\xff\xfe"};
+    for (int i = 0; i < 500; ++i)
+    {
+        keys.push_back("http://example.com/" + std::to_string(i * 31 % 1000));
+    }
+    z.assign(keys.begin(), keys.end());
+
+    haisu::zset frozen = z;
+    frozen.freeze();
+    EXPECT_TRUE(frozen.frozen());
+    EXPECT_FALSE(z.frozen());
+
+    auto probes = keys;
+    for (auto& k : keys)
+    {
+        probes.push_back(k + "0");
+        probes.push_back(k.substr(0, k.size() / 2));
+    }
+    probes.push_back("abcdefg\x01");
+    probes.push_back("\xff\xff");
+
+    const auto index_of = [](const haisu::zset& s, haisu::zset::const_iterator i) {
+        return i == s.end() ? std::string("end") : std::string(*i);
+    };
+
+    for (auto& p : probes)
+    {
+        const char* key = p.c_str();
+        ASSERT_EQ(z.count(key), frozen.count(key)) << p;
+        ASSERT_EQ(index_of(z, z.find(key)), index_of(frozen, frozen.find(key))) << p;
+        ASSERT_EQ(index_of(z, z.lower_bound(key)), index_of(frozen, frozen.lower_bound(key))) << p;
+        ASSERT_EQ(index_of(z, z.upper_bound(key)), index_of(frozen, frozen.upper_bound(key))) << p;
+        ASSERT_EQ(index_of(z, z.equal_range(key).second), index_of(frozen, frozen.equal_range(key).second)) << p;
+    }
+}
+
+TEST_F(zset_test, freezes_empty_set)
+{
+    z.freeze();
+    EXPECT_TRUE(z.frozen());
+    EXPECT_EQ(0u, z.count("a"));
+    EXPECT_EQ(z.end(), z.lower_bound("a"));
+    EXPECT_EQ(z.end(), z.upper_bound(""));
+}
+
+TEST_F(zset_test, modification_thaws_set)
+{
+    z = {"b", "d"};
+    z.freeze();
+
+    z.insert("d");
+    EXPECT_TRUE(z.frozen());
+
+    z.insert("c");
+    EXPECT_FALSE(z.frozen());
+    EXPECT_EQ(1u, z.count("c"));
+
+    z.freeze();
+    z.erase("b");
+    EXPECT_FALSE(z.frozen());
+    EXPECT_EQ(0u, z.count("b"));
+
+    z.freeze();
+    z.clear();
+    EXPECT_FALSE(z.frozen());
+}
+
+struct zmap_test: ::testing::Test
+{
+    haisu::zmap<int> m;
+};
+
+TEST_F(zmap_test, newly_created_map_is_empty)
+{
+    EXPECT_TRUE(m.empty());
+    EXPECT_EQ(0u, m.size());
+    EXPECT_EQ(m.end(), m.begin());
+    EXPECT_EQ(0u, m.count("a"));
+}
+
+TEST_F(zmap_test, inserts_key_with_value)
+{
+    auto res = m.insert("hello", 42);
+
+    EXPECT_TRUE(res.second);
+    EXPECT_STREQ("hello", res.first.key());
+    EXPECT_EQ(42, res.first.value());
+    EXPECT_EQ(1u, m.size());
+    EXPECT_EQ(42, m.get("hello"));
+}
+
+TEST_F(zmap_test, does_not_overwrite_value_on_insert)
+{
+    m.insert("a", 1);
+    auto res = m.insert("a", 2);
+
+    EXPECT_FALSE(res.second);
+    EXPECT_EQ(1, res.first.value());
+    EXPECT_EQ(1u, m.size());
+}
+
+TEST_F(zmap_test, overwrites_value_on_insert_or_assign)
+{
+    m.insert("a", 1);
+    m.insert("b", 2);
+    auto res = m.insert_or_assign("a", 3);
+
+    EXPECT_FALSE(res.second);
+    EXPECT_EQ(3, m.get("a"));
+    EXPECT_EQ(2, m.get("b"));
+
+    EXPECT_TRUE(m.insert_or_assign("c", 4).second);
+    EXPECT_EQ(4, m.get("c"));
+}
+
+TEST_F(zmap_test, returns_default_for_missing_key)
+{
+    m.insert("a", 1);
+    EXPECT_EQ(0, m.get("b"));
+    EXPECT_EQ(-1, m.get("b", -1));
+}
+
+TEST_F(zmap_test, keeps_keys_sorted)
+{
+    m.insert("c", 3);
+    m.insert("a", 1);
+    m.insert("d", 4);
+    m.insert("b", 2);
+
+    std::vector<std::pair<std::string, int>> items;
+    for (auto kv : m)
+    {
+        items.emplace_back(kv.first, kv.second);
+    }
+
+    const std::vector<std::pair<std::string, int>> expected{{"a", 1}, {"b", 2}, {"c", 3}, {"d", 4}};
+    EXPECT_EQ(expected, items);
+}
+
+TEST_F(zmap_test, erases_key)
+{
+    m = {{"a", 1}, {"b", 2}, {"c", 3}};
+
+    EXPECT_EQ(1u, m.erase("b"));
+    EXPECT_EQ(0u, m.erase("b"));
+
+    ASSERT_EQ(2u, m.size());
+    EXPECT_STREQ("a", m.key_at(0));
+    EXPECT_EQ(1, m.value_at(0));
+    EXPECT_STREQ("c", m.key_at(1));
+    EXPECT_EQ(3, m.value_at(1));
+
+    m.erase("c");
+    m.erase("a");
+    EXPECT_TRUE(m.empty());
+}
+
+TEST_F(zmap_test, finds_bounds)
+{
+    m = {{"b", 1}, {"d", 2}, {"f", 3}};
+
+    EXPECT_EQ(m.end(), m.find("c"));
+    EXPECT_EQ(2, m.find("d").value());
+
+    EXPECT_STREQ("d", m.lower_bound("c").key());
+    EXPECT_STREQ("d", m.lower_bound("d").key());
+    EXPECT_STREQ("f", m.upper_bound("d").key());
+    EXPECT_EQ(m.end(), m.upper_bound("f"));
+    EXPECT_EQ(m.begin(), m.lower_bound("a"));
+
+    auto found = m.equal_range("d");
+    EXPECT_STREQ("d", found.first.key());
+    EXPECT_STREQ("f", found.second.key());
+
+    auto missing = m.equal_range("e");
+    EXPECT_EQ(missing.first, missing.second);
+    EXPECT_STREQ("f", missing.first.key());
+}
+
+TEST_F(zmap_test, builds_map_from_range_keeping_first_value)
+{
+    const std::vector<std::pair<std::string, int>> items{{"c", 1}, {"a", 2}, {"c", 3}, {"b", 4}};
+    haisu::zmap<int> built(items.begin(), items.end());
+
+    ASSERT_EQ(3u, built.size());
+    EXPECT_EQ(2, built.get("a"));
+    EXPECT_EQ(4, built.get("b"));
+    EXPECT_EQ(1, built.get("c"));
+}
+
+TEST_F(zmap_test, builds_map_from_sorted_range)
+{
+    const std::map<std::string, int> items{{"a", 1}, {"b", 2}, {"c", 3}};
+    m.assign_sorted(items.begin(), items.end());
+
+    ASSERT_EQ(3u, m.size());
+    EXPECT_EQ(3, m.get("c"));
+}
+
+TEST_F(zmap_test, merges_range_into_map)
+{
+    m = {{"b", 1}, {"d", 2}};
+
+    const std::vector<std::pair<const char*, int>> items{{"d", 5}, {"a", 3}, {"c", 4}, {"a", 6}};
+    m.insert(items.begin(), items.end());
+
+    ASSERT_EQ(4u, m.size());
+    EXPECT_EQ(3, m.get("a"));
+    EXPECT_EQ(1, m.get("b"));
+    EXPECT_EQ(4, m.get("c"));
+    EXPECT_EQ(2, m.get("d"));
+}
+
+TEST_F(zmap_test, inserts_own_key_suffix)
+{
+    m.insert("abc", 1);
+    m.insert(m.key_at(0) + 1, 2);
+
+    ASSERT_EQ(2u, m.size());
+    EXPECT_EQ(1, m.get("abc"));
+    EXPECT_EQ(2, m.get("bc"));
+}
+
+TEST_F(zmap_test, stores_unaligned_values)
+{
+    haisu::zmap<double> d;
+    d.insert("a", 0.5);
+    d.insert("bb", 1.5);
+    d.insert("ccc", 2.5);
+    d.insert_or_assign("bb", 3.5);
+
+    EXPECT_EQ(0.5, d.get("a"));
+    EXPECT_EQ(3.5, d.get("bb"));
+    EXPECT_EQ(2.5, d.get("ccc"));
+}
+
+TEST_F(zmap_test, matches_std_map)
+{
+    std::map<std::string, int> expected;
+    for (int i = 0; i < 2000; ++i)
+    {
+        const auto key = "key" + std::to_string(i * 7919 % 1500);
+        if (i % 5 == 4)
+        {
+            EXPECT_EQ(expected.erase(key), m.erase(key.c_str()));
+        }
+        else
+        {
+            expected.insert({key, i});
+            m.insert(key.c_str(), i);
+        }
+    }
+
+    ASSERT_EQ(expected.size(), m.size());
+    auto it = m.begin();
+    for (auto& kv : expected)
+    {
+        ASSERT_EQ(kv.first, it.key());
+        ASSERT_EQ(kv.second, it.value());
+        ++it;
+    }
+
+    haisu::zmap<int> built(expected.begin(), expected.end());
+    for (auto& kv : expected)
+    {
+        ASSERT_EQ(kv.second, built.get(kv.first.c_str()));
+    }
+}
+
+TEST_F(zset_test, returns_prefix_range)
+{
+    z = {"http://a.com/", "http://a.com/x", "http://a.com/y", "http://b.com/", "ftp://a.com/", "\xff", "\xff\xff"};
+
+    auto range = z.prefix_range("http://a.com/");
+    std::vector<std::string> found;
+    for (auto i = range.first; i != range.second; ++i)
+    {
+        found.push_back(*i);
+    }
+
+    const std::vector<std::string> expected{"http://a.com/", "http://a.com/x", "http://a.com/y"};
+    EXPECT_EQ(expected, found);
+
+    range = z.prefix_range("\xff");
+    EXPECT_STREQ("\xff", *range.first);
+    EXPECT_EQ(z.end(), range.second);
+
+    range = z.prefix_range("");
+    EXPECT_EQ(z.begin(), range.first);
+    EXPECT_EQ(z.end(), range.second);
+
+    range = z.prefix_range("http://c");
+    EXPECT_EQ(range.first, range.second);
+}
+
+TEST_F(zset_test, tells_whether_some_string_starts_with_prefix)
+{
+    z = {"http://a.com/", "http://b.com/"};
+    z.freeze();
+
+    EXPECT_TRUE(z.starts_with("http://b"));
+    EXPECT_TRUE(z.starts_with("http://a.com/"));
+    EXPECT_FALSE(z.starts_with("http://a.com/x"));
+    EXPECT_FALSE(z.starts_with("https"));
+    EXPECT_TRUE(z.starts_with(""));
+}